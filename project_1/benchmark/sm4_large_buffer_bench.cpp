@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../crypto_runtime/buffer_pool.h"
+#include "../sm4_aesni_implementation/sm4_aesni.h"
+#include "../sm4_gfni_implementation/sm4_gfni.h"
+
+/**
+ * Cached vs. streaming (prefetch + non-temporal store) output for multi-GB SM4 jobs.
+ *
+ * For every kernel and store mode it reports:
+ * - SM4 throughput over the whole buffer;
+ * - the cost of a cache-sensitive "application" workload (random pointer chase over a
+ *   cache-resident working set of a quarter of the LLC, at most 8 MiB) that runs
+ *   alongside the encryption. With two or more cores the chase runs on its own thread
+ *   during the whole job and reports hops/s; on a single core it runs between
+ *   LLC-sized encryption chunks and reports ns per hop, which is what the application
+ *   sees when it touches its data between crypto calls.
+ *
+ * Usage: sm4_large_buffer_bench.elf [size_mib]   (default 512)
+ */
+
+using crypto_runtime::StoreMode;
+using Clock = std::chrono::steady_clock;
+
+static const uint8_t BENCH_KEY[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+                                      0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10};
+static const size_t CHECK_BYTES = 1024 * 1024;
+
+// One pointer per 64-byte line, linked in a random cycle so hardware prefetchers
+// cannot hide the misses.
+class PointerChase {
+public:
+    explicit PointerChase(size_t bytes) : lines(bytes / 64) {
+        std::vector<size_t> order(lines);
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+        nodes.resize(lines);
+        for (size_t i = 0; i < lines; i++) {
+            nodes[order[i]].next = &nodes[order[(i + 1) % lines]];
+        }
+        cursor = &nodes[0];
+    }
+
+    void walk(size_t hops) {
+        Node* p = cursor;
+        for (size_t i = 0; i < hops; i++) {
+            p = p->next;
+        }
+        cursor = p;
+    }
+
+    size_t size() const {
+        return lines;
+    }
+
+private:
+    struct alignas(64) Node {
+        Node* next;
+    };
+    size_t lines;
+    std::vector<Node> nodes;
+    Node* volatile cursor;
+};
+
+struct Kernel {
+    std::string name;
+    std::function<void(const uint8_t*, uint8_t*, size_t, StoreMode)> encrypt;
+};
+
+static double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void run_interleaved(const Kernel& kernel, StoreMode mode, const uint8_t* src, uint8_t* dst,
+                            size_t bytes, size_t chunk_bytes, PointerChase& victim, double baseline_ns) {
+    double crypto_seconds = 0;
+    double chase_seconds = 0;
+    size_t chase_hops = 0;
+
+    for (size_t off = 0; off < bytes; off += chunk_bytes) {
+        size_t n = std::min(chunk_bytes, bytes - off);
+        auto t0 = Clock::now();
+        kernel.encrypt(src + off, dst + off, n / 16, mode);
+        crypto_seconds += seconds_since(t0);
+
+        auto t1 = Clock::now();
+        victim.walk(victim.size());
+        chase_seconds += seconds_since(t1);
+        chase_hops += victim.size();
+    }
+
+    double ns_per_hop = chase_seconds * 1e9 / chase_hops;
+    std::cout << "  " << std::left << std::setw(10) << (mode == StoreMode::Streaming ? "streaming" : "cached")
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(8) << bytes / crypto_seconds / 1e9 << " GB/s   victim "
+              << std::setw(6) << ns_per_hop << " ns/hop (" << std::setprecision(2)
+              << ns_per_hop / baseline_ns << "x alone)" << std::endl;
+}
+
+static void run_corunning(const Kernel& kernel, StoreMode mode, const uint8_t* src, uint8_t* dst,
+                          size_t bytes, PointerChase& victim, double baseline_hops_per_s) {
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> hops{0};
+    std::thread chaser([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            victim.walk(4096);
+            hops.fetch_add(4096, std::memory_order_relaxed);
+        }
+    });
+
+    auto t0 = Clock::now();
+    kernel.encrypt(src, dst, bytes / 16, mode);
+    double crypto_seconds = seconds_since(t0);
+    stop = true;
+    chaser.join();
+
+    double hops_per_s = hops.load() / crypto_seconds;
+    std::cout << "  " << std::left << std::setw(10) << (mode == StoreMode::Streaming ? "streaming" : "cached")
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(8) << bytes / crypto_seconds / 1e9 << " GB/s   victim "
+              << std::setw(8) << hops_per_s / 1e6 << " Mhops/s (" << std::setprecision(2)
+              << hops_per_s / baseline_hops_per_s << "x alone)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t size_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512;
+    size_t bytes = std::max<size_t>(size_mib, 8) * 1024 * 1024;
+
+    auto& pool = crypto_runtime::BufferPool::shared();
+    auto src_buf = pool.acquire(bytes);
+    auto dst_buf = pool.acquire(bytes);
+    uint8_t* src = src_buf.data();
+    uint8_t* dst = dst_buf.data();
+    for (size_t i = 0; i < bytes; i++) {
+        src[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+    std::fill(dst, dst + bytes, 0);
+
+    std::vector<Kernel> kernels;
+    uint32_t rk[32];
+    SM4_AESNI::expand_key(BENCH_KEY, rk);
+    kernels.push_back({"AES-NI", [&rk](const uint8_t* in, uint8_t* out, size_t blocks, StoreMode mode) {
+        SM4_AESNI::encrypt_blocks(rk, in, out, blocks, mode);
+    }});
+    if (SM4_GFNI::is_supported()) {
+        kernels.push_back({"GFNI", [](const uint8_t* in, uint8_t* out, size_t blocks, StoreMode mode) {
+            SM4_GFNI::encrypt_buffer(BENCH_KEY, in, out, blocks, mode);
+        }});
+    }
+
+    // Both modes and both kernels must agree before anything is timed.
+    {
+        std::vector<uint8_t> reference(CHECK_BYTES);
+        kernels[0].encrypt(src, reference.data(), CHECK_BYTES / 16, StoreMode::Cached);
+        for (const auto& kernel : kernels) {
+            for (StoreMode mode : {StoreMode::Cached, StoreMode::Streaming}) {
+                kernel.encrypt(src, dst, CHECK_BYTES / 16, mode);
+                if (!std::equal(reference.begin(), reference.end(), dst)) {
+                    std::cout << "✗ " << kernel.name << " output differs between store modes" << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    size_t llc = crypto_runtime::llc_bytes();
+    size_t victim_bytes = std::min<size_t>(llc / 4, 8 * 1024 * 1024);
+    size_t chunk_bytes = std::max<size_t>(llc, 8 * 1024 * 1024) & ~size_t(63);
+    PointerChase victim(victim_bytes);
+    bool corun = std::thread::hardware_concurrency() >= 2;
+
+    std::cout << "Buffer: " << bytes / (1024 * 1024) << " MiB, LLC: " << llc / 1024 << " KiB, victim working set: "
+              << victim_bytes / 1024 << " KiB, auto threshold: " << crypto_runtime::large_buffer_threshold() / 1024
+              << " KiB" << std::endl;
+    std::cout << "Victim runs " << (corun ? "on a second thread during the job" : "between LLC-sized chunks (single core)")
+              << std::endl;
+
+    victim.walk(victim.size());
+    auto t0 = Clock::now();
+    const size_t baseline_rounds = 16;
+    for (size_t i = 0; i < baseline_rounds; i++) {
+        victim.walk(victim.size());
+    }
+    double alone = seconds_since(t0);
+    double baseline_ns = alone * 1e9 / (baseline_rounds * victim.size());
+    double baseline_hops_per_s = baseline_rounds * victim.size() / alone;
+    std::cout << "Victim alone: " << std::fixed << std::setprecision(2) << baseline_ns << " ns/hop" << std::endl;
+
+    for (const auto& kernel : kernels) {
+        std::cout << kernel.name << ":" << std::endl;
+        for (StoreMode mode : {StoreMode::Cached, StoreMode::Streaming}) {
+            if (corun) {
+                run_corunning(kernel, mode, src, dst, bytes, victim, baseline_hops_per_s);
+            } else {
+                run_interleaved(kernel, mode, src, dst, bytes, chunk_bytes, victim, baseline_ns);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -19,6 +19,26 @@ g++ -O2 -o sm4_t_table.elf sm4_t_table_implementation/sm4_t_table.cpp
 echo "4. Building GFNI SM4..."
 g++ -O2 -mavx2 -mgfni -o sm4_gfni.elf sm4_gfni_implementation/sm4_gfni.cpp
 
+# Build the coroutine async front end (C++20)
+echo "5. Building async SM4..."
+g++ -O2 -std=c++20 -msse4.2 -mavx2 -maes -pthread -o sm4_async.elf sm4_async_implementation/sm4_async.cpp
+
+# Build the large-buffer (prefetch + non-temporal store) benchmark
+echo "6. Building large-buffer benchmark..."
+g++ -O2 -msse4.2 -mavx2 -maes -mgfni -pthread -o sm4_large_buffer_bench.elf benchmark/sm4_large_buffer_bench.cpp
+
+# Build the compile-time specialized engine (S-box strategy x block width)
+echo "7. Building SM4 engine..."
+g++ -O2 -msse4.2 -mavx2 -maes -mgfni -o sm4_engine.elf sm4_engine_implementation/sm4_engine.cpp
+
+# Build the SM4 CTR_DRBG random generator
+echo "8. Building SM4 CTR_DRBG..."
+g++ -O2 -msse4.2 -mavx2 -maes -mgfni -o sm4_drbg.elf sm4_drbg_implementation/sm4_drbg.cpp
+
+# Build the buffer pool self-test
+echo "9. Building buffer pool self-test..."
+g++ -O2 -pthread -o buffer_pool.elf crypto_runtime/buffer_pool.cpp
+
 echo ""
 echo "Running tests..."
 
@@ -50,5 +70,25 @@ echo " encrypt
 0123456789abcdeffedcba9876543210
 0123456789abcdeffedcba9876543210" | ./sm4_gfni.elf
 
+echo ""
+echo "Testing async SM4..."
+./sm4_async.elf
+
+echo ""
+echo "Testing SM4 engine instantiations..."
+./sm4_engine.elf
+
+echo ""
+echo "Testing SM4 CTR_DRBG..."
+./sm4_drbg.elf
+
+echo ""
+echo "Testing buffer pool..."
+./buffer_pool.elf
+
+echo ""
+echo "Running large-buffer benchmark (64 MiB; pass a larger size in MiB for multi-GB runs)..."
+./sm4_large_buffer_bench.elf 64
+
 echo ""
 echo "Build and test complete!"
\ No newline at end of file
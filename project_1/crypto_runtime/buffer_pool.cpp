@@ -0,0 +1,154 @@
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool.h"
+
+/**
+ * BufferPool self-test:
+ * - a buffer released on the shared pool comes back from the thread cache without a new
+ *   OS allocation, and a thread's cache is handed to the shared free list when it exits;
+ * - every size class is 64-byte aligned, and classes of 2 MiB and above are 2 MiB
+ *   aligned and writable whichever of MAP_HUGETLB or the THP fallback backed them;
+ * - without reserved hugetlbfs pages the fallback is taken, and huge_pages = false skips
+ *   both;
+ * - requests above 1 GiB are rejected with std::bad_alloc, and buffers beyond the cache
+ *   limits go back to the OS.
+ * Prints the shared pool's statistics at the end.
+ */
+
+using crypto_runtime::BufferPool;
+
+static bool check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+// HugePages_Free from /proc/meminfo; 0 when none are reserved or it cannot be read.
+static size_t free_hugetlb_pages() {
+    std::ifstream in("/proc/meminfo");
+    std::string key;
+    size_t value = 0;
+    while (in >> key >> value) {
+        if (key == "HugePages_Free:") {
+            return value;
+        }
+        in.ignore(256, '\n');
+    }
+    return 0;
+}
+
+static bool reuse() {
+    BufferPool& pool = BufferPool::shared();
+    const auto& stats = pool.get_stats();
+    uint8_t* first;
+    {
+        auto buffer = pool.acquire(1 << 20);
+        first = buffer.data();
+    }
+    size_t allocations = stats.os_allocations, hits = stats.thread_cache_hits;
+    bool ok = true;
+    for (int i = 0; i < 100; i++) {
+        auto buffer = pool.acquire(1 << 20);
+        ok = ok && buffer.data() == first;
+    }
+    ok = ok && stats.os_allocations == allocations && stats.thread_cache_hits == hits + 100;
+
+    // A class this thread has never used: the worker's cached buffer must reach it.
+    uint8_t* from_thread = nullptr;
+    std::thread([&] { from_thread = pool.acquire(256 * 1024).data(); }).join();
+    size_t shared_hits = stats.shared_cache_hits;
+    auto buffer = pool.acquire(256 * 1024);
+    ok = ok && buffer.data() == from_thread && stats.shared_cache_hits == shared_hits + 1;
+    return check(ok, "Released buffers are reused from the thread cache and survive thread exit");
+}
+
+static bool alignment() {
+    BufferPool pool;
+    bool ok = true;
+    for (size_t bytes : {size_t(1), size_t(1000), size_t(64 * 1024), size_t(64 * 1024 + 1), size_t(1 << 20),
+                         size_t(2 << 20), size_t(3 << 20), size_t(16 << 20)}) {
+        auto buffer = pool.acquire(bytes);
+        uintptr_t address = reinterpret_cast<uintptr_t>(buffer.data());
+        size_t expected = 64 * 1024;
+        while (expected < bytes) {
+            expected *= 2;
+        }
+        ok = ok && address % BufferPool::ALIGNMENT == 0 && buffer.size() == expected;
+        if (buffer.size() >= BufferPool::HUGE_PAGE_SIZE) {
+            ok = ok && address % BufferPool::HUGE_PAGE_SIZE == 0;
+        }
+        std::memset(buffer.data(), 0xa5, buffer.size());
+    }
+    return check(ok, "Every size class is 64-byte aligned, 2 MiB and above 2 MiB aligned");
+}
+
+static bool huge_page_fallback() {
+    const size_t big = 4 << 20;
+    BufferPool::Config plain_config;
+    plain_config.huge_pages = false;
+    BufferPool huge, plain(plain_config);
+    auto a = huge.acquire(big);
+    auto b = plain.acquire(big);
+    std::memset(a.data(), 1, a.size());
+    std::memset(b.data(), 2, b.size());
+
+    const auto& hs = huge.get_stats();
+    const auto& ps = plain.get_stats();
+    bool ok = hs.hugetlb_mappings + hs.thp_mappings <= 1 && ps.hugetlb_mappings == 0 && ps.thp_mappings == 0 &&
+              a.data()[big - 1] == 1 && b.data()[big - 1] == 2;
+    if (free_hugetlb_pages() < big / BufferPool::HUGE_PAGE_SIZE) {
+        // MAP_HUGETLB cannot succeed, so the mapping must be the THP fallback, advised
+        // whenever the kernel has THP at all.
+        bool thp = access("/sys/kernel/mm/transparent_hugepage", F_OK) == 0;
+        ok = ok && hs.hugetlb_mappings == 0 && hs.thp_mappings == (thp ? 1u : 0u);
+    }
+    const char* backing = hs.hugetlb_mappings ? "MAP_HUGETLB" : hs.thp_mappings ? "THP (madvise)" : "normal pages";
+    std::cout << "  4 MiB buffer backed by " << backing << std::endl;
+    return check(ok, "MAP_HUGETLB falls back to THP; huge_pages = false uses neither");
+}
+
+static bool limits() {
+    BufferPool::Config config;
+    config.thread_cache_per_class = 0;
+    config.shared_cache_per_class = 1;
+    BufferPool pool(config);
+    bool rejected = false;
+    try {
+        pool.acquire((size_t(1) << BufferPool::MAX_CLASS_SHIFT) + 1);
+    } catch (const std::bad_alloc&) {
+        rejected = true;
+    }
+    {
+        std::vector<BufferPool::Buffer> held;
+        for (int i = 0; i < 3; i++) {
+            held.push_back(pool.acquire(64 * 1024));
+        }
+    }
+    const auto& stats = pool.get_stats();
+    bool ok = rejected && stats.os_allocations == 3 && stats.os_releases == 2;
+    auto again = pool.acquire(64 * 1024);
+    ok = ok && stats.shared_cache_hits == 1 && stats.os_allocations == 3;
+    return check(ok, "Requests above 1 GiB are rejected; buffers beyond the cache limits go back to the OS");
+}
+
+int main() {
+    bool ok = reuse();
+    ok = alignment() && ok;
+    ok = huge_page_fallback() && ok;
+    ok = limits() && ok;
+
+    const auto& stats = BufferPool::shared().get_stats();
+    std::cout << "Shared pool: " << stats.os_allocations << " OS allocations, " << stats.os_releases
+              << " releases, " << stats.thread_cache_hits << " thread-cache hits, " << stats.shared_cache_hits
+              << " shared-cache hits, " << stats.hugetlb_mappings << " hugetlb / " << stats.thp_mappings
+              << " THP mappings" << std::endl;
+    return ok ? 0 : 1;
+}
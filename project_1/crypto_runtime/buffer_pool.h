@@ -0,0 +1,272 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Reusable pool of 64-byte aligned I/O buffers for the bulk SM4/SM3 paths.
+ *
+ * Requests are rounded up to a power-of-two size class (64 KiB .. 1 GiB). Classes of
+ * 2 MiB and above are mmap-backed and 2 MiB aligned: MAP_HUGETLB is tried first, and
+ * if no hugetlbfs pages are reserved the mapping falls back to normal pages with
+ * MADV_HUGEPAGE so transparent huge pages can back it. Smaller classes come from
+ * aligned_alloc.
+ *
+ * Released buffers go to a small per-thread cache first, then to a shared per-class
+ * free list, and are only returned to the OS when both are full. A streaming loop that
+ * acquires one buffer per call therefore only allocates on its first call.
+ */
+namespace crypto_runtime {
+
+class BufferPool {
+public:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    static constexpr int MIN_CLASS_SHIFT = 16;  // 64 KiB
+    static constexpr int MAX_CLASS_SHIFT = 30;  // 1 GiB
+    static constexpr int NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+
+    struct Config {
+        bool huge_pages = true;
+        size_t thread_cache_per_class = 4;
+        size_t shared_cache_per_class = 32;
+    };
+
+    struct Stats {
+        std::atomic<size_t> os_allocations{0};
+        std::atomic<size_t> os_releases{0};
+        std::atomic<size_t> thread_cache_hits{0};
+        std::atomic<size_t> shared_cache_hits{0};
+        std::atomic<size_t> hugetlb_mappings{0};
+        std::atomic<size_t> thp_mappings{0};
+    };
+
+    // Move-only handle; the memory goes back to the pool when the handle dies.
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& other) noexcept
+            : pool(std::exchange(other.pool, nullptr)), ptr(std::exchange(other.ptr, nullptr)),
+              len(std::exchange(other.len, 0)), cls(other.cls) {}
+        Buffer& operator=(Buffer&& other) noexcept {
+            if (this != &other) {
+                reset();
+                pool = std::exchange(other.pool, nullptr);
+                ptr = std::exchange(other.ptr, nullptr);
+                len = std::exchange(other.len, 0);
+                cls = other.cls;
+            }
+            return *this;
+        }
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        ~Buffer() {
+            reset();
+        }
+
+        uint8_t* data() const {
+            return ptr;
+        }
+
+        // Usable capacity: the full size class, not just the requested length.
+        size_t size() const {
+            return len;
+        }
+
+        void reset() {
+            if (pool) {
+                pool->release(ptr, cls);
+                pool = nullptr;
+                ptr = nullptr;
+                len = 0;
+            }
+        }
+
+    private:
+        friend class BufferPool;
+        Buffer(BufferPool* pool, uint8_t* ptr, size_t len, int cls) : pool(pool), ptr(ptr), len(len), cls(cls) {}
+
+        BufferPool* pool = nullptr;
+        uint8_t* ptr = nullptr;
+        size_t len = 0;
+        int cls = 0;
+    };
+
+    BufferPool() : BufferPool(Config()) {}
+    explicit BufferPool(Config config) : config(config) {}
+
+    ~BufferPool() {
+        for (int cls = 0; cls < NUM_CLASSES; cls++) {
+            for (uint8_t* p : shared_free[cls]) {
+                free_to_os(p, cls);
+            }
+        }
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    static BufferPool& shared() {
+        static BufferPool pool;
+        return pool;
+    }
+
+    Buffer acquire(size_t min_bytes) {
+        int cls = size_class(min_bytes);
+        if (cls < 0) {
+            throw std::bad_alloc();
+        }
+
+        ThreadCache& tc = thread_cache();
+        if (tc.owner == this && !tc.free[cls].empty()) {
+            uint8_t* p = tc.free[cls].back();
+            tc.free[cls].pop_back();
+            stats.thread_cache_hits++;
+            return Buffer(this, p, class_bytes(cls), cls);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!shared_free[cls].empty()) {
+                uint8_t* p = shared_free[cls].back();
+                shared_free[cls].pop_back();
+                stats.shared_cache_hits++;
+                return Buffer(this, p, class_bytes(cls), cls);
+            }
+        }
+
+        return Buffer(this, alloc_from_os(cls), class_bytes(cls), cls);
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    static size_t class_bytes(int cls) {
+        return size_t(1) << (cls + MIN_CLASS_SHIFT);
+    }
+
+private:
+    // Only the shared pool uses the thread caches; other instances go straight to the
+    // shared free lists so a cache never holds memory of a pool that no longer exists.
+    struct ThreadCache {
+        BufferPool* owner = nullptr;
+        std::array<std::vector<uint8_t*>, NUM_CLASSES> free;
+
+        ~ThreadCache() {
+            if (!owner) {
+                return;
+            }
+            for (int cls = 0; cls < NUM_CLASSES; cls++) {
+                for (uint8_t* p : free[cls]) {
+                    owner->release_shared(p, cls);
+                }
+            }
+        }
+    };
+
+    static ThreadCache& thread_cache() {
+        thread_local ThreadCache tc;
+        if (!tc.owner) {
+            tc.owner = &shared();
+        }
+        return tc;
+    }
+
+    static int size_class(size_t bytes) {
+        int cls = 0;
+        while (cls < NUM_CLASSES && class_bytes(cls) < bytes) {
+            cls++;
+        }
+        return cls < NUM_CLASSES ? cls : -1;
+    }
+
+    void release(uint8_t* p, int cls) {
+        ThreadCache& tc = thread_cache();
+        if (tc.owner == this && tc.free[cls].size() < config.thread_cache_per_class) {
+            tc.free[cls].push_back(p);
+            return;
+        }
+        release_shared(p, cls);
+    }
+
+    void release_shared(uint8_t* p, int cls) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (shared_free[cls].size() < config.shared_cache_per_class) {
+                shared_free[cls].push_back(p);
+                return;
+            }
+        }
+        free_to_os(p, cls);
+    }
+
+    uint8_t* alloc_from_os(int cls) {
+        size_t bytes = class_bytes(cls);
+        stats.os_allocations++;
+
+        if (bytes < HUGE_PAGE_SIZE) {
+            void* p = std::aligned_alloc(ALIGNMENT, bytes);
+            if (!p) {
+                throw std::bad_alloc();
+            }
+            return static_cast<uint8_t*>(p);
+        }
+
+        if (config.huge_pages) {
+            void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                stats.hugetlb_mappings++;
+                return static_cast<uint8_t*>(p);
+            }
+        }
+
+        // Over-map by one huge page and trim both ends so the region is 2 MiB aligned,
+        // which THP needs before it can back the range with huge pages.
+        size_t span = bytes + HUGE_PAGE_SIZE;
+        void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+        if (aligned > start) {
+            munmap(raw, aligned - start);
+        }
+        size_t tail = (start + span) - (aligned + bytes);
+        if (tail > 0) {
+            munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+        }
+        if (config.huge_pages && madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE) == 0) {
+            stats.thp_mappings++;
+        }
+        return reinterpret_cast<uint8_t*>(aligned);
+    }
+
+    void free_to_os(uint8_t* p, int cls) {
+        size_t bytes = class_bytes(cls);
+        stats.os_releases++;
+        if (bytes < HUGE_PAGE_SIZE) {
+            std::free(p);
+        } else {
+            munmap(p, bytes);
+        }
+    }
+
+    Config config;
+    Stats stats;
+    std::mutex mutex;
+    std::array<std::vector<uint8_t*>, NUM_CLASSES> shared_free;
+};
+
+}  // namespace crypto_runtime
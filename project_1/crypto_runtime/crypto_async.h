@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Coroutine plumbing shared by the async SM4 (project_1) and SM3 (project_4) front ends.
+ *
+ * - EventLoop: single-threaded loop that owns the coroutines. Offloaded jobs post their
+ *   continuation back here, so user code never resumes on a worker thread.
+ * - WorkerPool: one process-wide pool that runs the large jobs.
+ * - Batcher: collects small jobs submitted during one loop tick and hands them to a
+ *   multi-lane kernel in a single call at the end of the tick.
+ * - Task<T>: lazily started coroutine type used by callers and by the demos.
+ */
+namespace crypto_async {
+
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        cv.notify_one();
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    static WorkerPool& shared() {
+        static WorkerPool pool;
+        return pool;
+    }
+
+private:
+    void worker_loop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
+
+class EventLoop {
+public:
+    // Thread-safe: workers use this to hand a finished job back to the loop.
+    void post(std::coroutine_handle<> h) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(h);
+        }
+        cv.notify_one();
+    }
+
+    using TickHookId = uint64_t;
+
+    // Hooks run once per tick after all ready coroutines have been resumed; batchers
+    // register here to flush whatever was queued during the tick. The returned id
+    // removes the hook again, which its owner must do before it is destroyed.
+    TickHookId add_tick_hook(std::function<void()> hook) {
+        tick_hooks.emplace_back(next_hook_id, std::move(hook));
+        return next_hook_id++;
+    }
+
+    void remove_tick_hook(TickHookId id) {
+        std::erase_if(tick_hooks, [id](const auto& entry) { return entry.first == id; });
+    }
+
+    size_t tick_hook_count() const {
+        return tick_hooks.size();
+    }
+
+    // True when nothing else is waiting to run in this tick, i.e. a small job cannot be
+    // batched with anything and might as well run inline.
+    bool idle() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return remaining_in_tick == 0 && ready.empty();
+    }
+
+    void begin_offload() {
+        outstanding.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void end_offload(std::coroutine_handle<> h) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(h);
+            outstanding.fetch_sub(1, std::memory_order_relaxed);
+        }
+        cv.notify_one();
+    }
+
+    // Runs until no coroutine is ready, no batch is pending and no offloaded job is in flight.
+    void run() {
+        for (;;) {
+            std::deque<std::coroutine_handle<>> tick;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (ready.empty() && outstanding.load(std::memory_order_relaxed) > 0) {
+                    cv.wait(lock, [this] { return !ready.empty(); });
+                }
+                tick.swap(ready);
+            }
+
+            while (!tick.empty()) {
+                auto h = tick.front();
+                tick.pop_front();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    remaining_in_tick = tick.size();
+                }
+                h.resume();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                remaining_in_tick = 0;
+            }
+
+            for (auto& entry : tick_hooks) {
+                entry.second();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ready.empty() && outstanding.load(std::memory_order_relaxed) == 0) {
+                break;
+            }
+        }
+        reap_spawned();
+    }
+
+    template <typename TaskT>
+    void spawn(TaskT task) {
+        auto h = task.release();
+        spawned.push_back(h);
+        post(h);
+    }
+
+private:
+    void reap_spawned() {
+        for (auto it = spawned.begin(); it != spawned.end();) {
+            if (it->done()) {
+                it->destroy();
+                it = spawned.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<std::pair<TickHookId, std::function<void()>>> tick_hooks;
+    TickHookId next_hook_id = 0;
+    std::list<std::coroutine_handle<>> spawned;
+    std::atomic<size_t> outstanding{0};
+    size_t remaining_in_tick = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+struct AsyncConfig {
+    // Jobs at or above this many bytes go to the worker pool.
+    size_t offload_threshold = 256 * 1024;
+    // A batch is flushed early, from inside the submitting coroutine, once this many
+    // kernel units (SM4 blocks, SM3 messages) are queued.
+    size_t max_batch_units = 256;
+};
+
+struct AsyncStats {
+    size_t inline_jobs = 0;
+    size_t batched_jobs = 0;
+    size_t batches = 0;
+    size_t offloaded_jobs = 0;
+};
+
+template <typename Job>
+class Batcher {
+public:
+    using Kernel = std::function<void(std::vector<Job>&)>;
+
+    // The loop must outlive the batcher; the tick hook is removed on destruction.
+    Batcher(EventLoop& loop, Kernel kernel, size_t max_units, AsyncStats& stats)
+        : loop(loop), kernel(std::move(kernel)), max_units(max_units), stats(stats) {
+        hook = loop.add_tick_hook([this] { flush(); });
+    }
+
+    ~Batcher() {
+        loop.remove_tick_hook(hook);
+    }
+
+    Batcher(const Batcher&) = delete;
+    Batcher& operator=(const Batcher&) = delete;
+
+    bool empty() const {
+        return jobs.empty();
+    }
+
+    // If the kernel throws, every job of that batch gets the exception in *error and is
+    // resumed all the same, so the awaiting coroutine can rethrow it.
+    void enqueue(Job job, size_t units, std::coroutine_handle<> h, std::exception_ptr* error) {
+        jobs.push_back(std::move(job));
+        waiters.push_back(Waiter{h, error});
+        queued_units += units;
+        stats.batched_jobs++;
+        if (queued_units >= max_units) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (jobs.empty()) {
+            return;
+        }
+        std::vector<Job> batch;
+        std::vector<Waiter> to_resume;
+        batch.swap(jobs);
+        to_resume.swap(waiters);
+        queued_units = 0;
+
+        std::exception_ptr failure;
+        try {
+            kernel(batch);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        stats.batches++;
+
+        for (const Waiter& w : to_resume) {
+            *w.error = failure;
+            loop.post(w.handle);
+        }
+    }
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        std::exception_ptr* error;
+    };
+
+    EventLoop& loop;
+    Kernel kernel;
+    size_t max_units;
+    AsyncStats& stats;
+    std::vector<Job> jobs;
+    std::vector<Waiter> waiters;
+    size_t queued_units = 0;
+    EventLoop::TickHookId hook;
+};
+
+// Runs work() on the shared pool and resumes the awaiting coroutine on the loop.
+class OffloadAwaiter {
+public:
+    OffloadAwaiter(EventLoop& loop, WorkerPool& pool, std::function<void()> work)
+        : loop(loop), pool(pool), work(std::move(work)) {}
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        loop.begin_offload();
+        pool.submit([this, h] {
+            try {
+                work();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            loop.end_offload(h);
+        });
+    }
+
+    void await_resume() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    EventLoop& loop;
+    WorkerPool& pool;
+    std::function<void()> work;
+    std::exception_ptr error;
+};
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+            auto next = h.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        error = std::current_exception();
+    }
+};
+
+}  // namespace detail
+
+template <typename T>
+class Task {
+public:
+    struct promise_type : detail::PromiseBase {
+        std::optional<T> value;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_value(T v) {
+            value = std::move(v);
+        }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task(const Task&) = delete;
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().error) {
+            std::rethrow_exception(handle.promise().error);
+        }
+        return std::move(*handle.promise().value);
+    }
+
+    std::coroutine_handle<promise_type> release() {
+        return std::exchange(handle, {});
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : detail::PromiseBase {
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_void() {}
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task(const Task&) = delete;
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    void await_resume() {
+        if (handle.promise().error) {
+            std::rethrow_exception(handle.promise().error);
+        }
+    }
+
+    std::coroutine_handle<promise_type> release() {
+        return std::exchange(handle, {});
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+}  // namespace crypto_async
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * Large-buffer policy shared by the bulk SM4 paths.
+ *
+ * Once a job is bigger than the last-level cache, writing its output through the cache
+ * only evicts the caller's working set: the output will not be read again before it is
+ * pushed out anyway. Above the threshold the kernels prefetch the input ahead of the
+ * stream and write the output with non-temporal stores, followed by one sfence.
+ */
+namespace crypto_runtime {
+
+enum class StoreMode {
+    Auto,       // streaming above large_buffer_threshold(), cached below
+    Cached,     // regular stores
+    Streaming,  // prefetch + non-temporal stores regardless of size
+};
+
+// How far ahead of the current block the input is prefetched.
+constexpr size_t PREFETCH_DISTANCE = 1024;
+
+inline size_t llc_bytes() {
+    static const size_t bytes = [] {
+        long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (l3 > 0) {
+            return static_cast<size_t>(l3);
+        }
+        long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (l2 > 0) {
+            return static_cast<size_t>(l2);
+        }
+        return static_cast<size_t>(8 * 1024 * 1024);
+    }();
+    return bytes;
+}
+
+// SM4_NT_THRESHOLD (bytes) overrides the default of one LLC worth of data.
+inline size_t large_buffer_threshold() {
+    static const size_t threshold = [] {
+        if (const char* env = std::getenv("SM4_NT_THRESHOLD")) {
+            return static_cast<size_t>(std::strtoull(env, nullptr, 10));
+        }
+        return llc_bytes();
+    }();
+    return threshold;
+}
+
+// Non-temporal 128-bit stores need a 16-byte aligned destination; blocks are 16 bytes,
+// so a misaligned destination stays misaligned and keeps the cached path.
+inline bool use_streaming_stores(StoreMode mode, size_t bytes, const void* dst) {
+    if ((reinterpret_cast<uintptr_t>(dst) & 15) != 0) {
+        return false;
+    }
+    switch (mode) {
+        case StoreMode::Cached:
+            return false;
+        case StoreMode::Streaming:
+            return true;
+        case StoreMode::Auto:
+        default:
+            return bytes >= large_buffer_threshold();
+    }
+}
+
+}  // namespace crypto_runtime
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fork-join pool for index-parallel loops whose iterations have very uneven cost, such as
+ * hashing a directory where a few files are gigabytes and the rest are tiny.
+ *
+ *     pool.parallel_for(files.size(), [&](size_t i, unsigned worker) { ... });
+ *
+ * The index range starts out split into one contiguous slice per worker. Each worker
+ * takes indices from the front of its own slice; a worker whose slice is empty steals
+ * the back half of the largest remaining slice. Nearby indices therefore tend to run on
+ * the same worker, and a long-running iteration only holds up the indices that nobody
+ * has stolen yet.
+ *
+ * The calling thread is worker 0, so a pool of size 1 starts no threads and runs the
+ * loop inline.
+ */
+namespace crypto_runtime {
+
+class WorkStealingPool {
+public:
+    struct Stats {
+        std::atomic<uint64_t> loops{0};
+        std::atomic<uint64_t> iterations{0};
+        std::atomic<uint64_t> steals{0};
+    };
+
+    explicit WorkStealingPool(unsigned workers = std::max(1u, std::thread::hardware_concurrency()))
+        : slots(new Slot[std::max(1u, workers)]), num_workers(std::max(1u, workers)) {
+        for (unsigned id = 1; id < num_workers; id++) {
+            threads.emplace_back([this, id] { worker_loop(id); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const {
+        return num_workers;
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    static WorkStealingPool& shared() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    /**
+     * Runs fn(i, worker) for every i in [0, n) and returns when all calls have finished.
+     * worker is in [0, size()) and identifies the calling thread, for per-worker scratch
+     * state. The first exception thrown by fn is rethrown here after the loop drains.
+     * Not reentrant: fn must not call parallel_for on the same pool.
+     */
+    void parallel_for(size_t n, const std::function<void(size_t, unsigned)>& fn) {
+        if (n == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> loop_lock(loop_mutex);
+        stats.loops++;
+        for (unsigned id = 0; id < num_workers; id++) {
+            std::lock_guard<std::mutex> lock(slots[id].mutex);
+            slots[id].begin = n * id / num_workers;
+            slots[id].end = n * (id + 1) / num_workers;
+        }
+        error = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            body = &fn;
+            running = num_workers - 1;
+            generation++;
+        }
+        start_cv.notify_all();
+
+        run_slices(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return running == 0; });
+        body = nullptr;
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    void worker_loop(unsigned id) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_cv.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            run_slices(id);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running--;
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    void run_slices(unsigned id) {
+        size_t i;
+        while (take(id, i) || (steal(id) && take(id, i))) {
+            try {
+                (*body)(i, id);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            stats.iterations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool take(unsigned id, size_t& i) {
+        Slot& slot = slots[id];
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (slot.begin == slot.end) {
+            return false;
+        }
+        i = slot.begin++;
+        return true;
+    }
+
+    // Moves the back half of the largest other slice into this worker's empty slice.
+    // Returns false once every slice is empty.
+    bool steal(unsigned id) {
+        while (true) {
+            unsigned victim = id;
+            size_t most = 0;
+            for (unsigned v = 0; v < num_workers; v++) {
+                if (v == id) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(slots[v].mutex);
+                size_t left = slots[v].end - slots[v].begin;
+                if (left > most) {
+                    most = left;
+                    victim = v;
+                }
+            }
+            if (victim == id) {
+                return false;
+            }
+
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(slots[victim].mutex);
+                size_t left = slots[victim].end - slots[victim].begin;
+                if (left == 0) {
+                    continue;  // emptied since the scan; look again
+                }
+                end = slots[victim].end;
+                begin = end - (left + 1) / 2;
+                slots[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> lock(slots[id].mutex);
+            slots[id].begin = begin;
+            slots[id].end = end;
+            stats.steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    unsigned num_workers;
+    std::vector<std::thread> threads;
+
+    std::mutex loop_mutex;  // one parallel_for at a time
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(size_t, unsigned)>* body = nullptr;
+    uint64_t generation = 0;
+    unsigned running = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    Stats stats;
+};
+
+}  // namespace crypto_runtime
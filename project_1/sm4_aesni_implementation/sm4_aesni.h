@@ -0,0 +1,177 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <immintrin.h>
+
+#include "../crypto_runtime/buffer_pool.h"
+#include "../crypto_runtime/large_buffer.h"
+#include "../sm4_engine_implementation/sm4_engine.h"
+
+/**
+ * SM4 with the S-box through AES-NI: the engine's AesniSBox strategy. Bulk ECB runs
+ * SM4Engine<AesniSBox, 16>, four interleaved groups of four blocks, and whatever is
+ * left over runs the four-block instantiation, which also serves the per-lane-key
+ * batches of the async front end.
+ */
+class SM4_AESNI {
+private:
+    using Bulk = sm4_engine::SM4Engine<sm4_engine::AesniSBox, 16>;
+    using Quad = sm4_engine::SM4Engine<sm4_engine::AesniSBox, 4>;
+
+    static std::vector<uint8_t> hex_to_bytes(const std::string& hex) {
+        std::vector<uint8_t> bytes;
+        for (size_t i = 0; i < hex.length(); i += 2) {
+            uint8_t byte = static_cast<uint8_t>(std::stoul(hex.substr(i, 2), nullptr, 16));
+            bytes.push_back(byte);
+        }
+        return bytes;
+    }
+    
+    static std::string bytes_to_hex(const std::vector<uint8_t>& bytes) {
+        std::stringstream ss;
+        for (uint8_t byte : bytes) {
+            ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+        }
+        return ss.str();
+    }
+    
+    static std::vector<uint8_t> encrypt_block(const std::vector<uint8_t>& plaintext, const uint32_t rk[32]) {
+        std::vector<uint8_t> ciphertext(16);
+        Quad::crypt_blocks(rk, plaintext.data(), ciphertext.data(), 1);
+        return ciphertext;
+    }
+
+    static sm4_engine::SM4Key key_schedule(const std::vector<uint8_t>& key) {
+        sm4_engine::SM4Key round_keys;
+        sm4_engine::expand_key(key.data(), round_keys);
+        return round_keys;
+    }
+
+public:
+    static void expand_key(const uint8_t key[16], uint32_t rk[32]) {
+        sm4_engine::SM4Key round_keys;
+        sm4_engine::expand_key(key, round_keys);
+        std::memcpy(rk, round_keys.enc, sizeof(round_keys.enc));
+    }
+
+    // ECB over num_blocks 16-byte blocks; src and dst may alias. Decryption is the same
+    // call with the round keys reversed. Jobs above the large-buffer threshold prefetch
+    // ahead of src and write dst with non-temporal stores (see large_buffer.h).
+    static void encrypt_blocks(const uint32_t rk[32], const uint8_t* src, uint8_t* dst, size_t num_blocks,
+                               crypto_runtime::StoreMode mode = crypto_runtime::StoreMode::Auto) {
+        size_t i = 0;
+        if (crypto_runtime::use_streaming_stores(mode, num_blocks * 16, dst)) {
+            for (; i + Bulk::WIDTH <= num_blocks; i += Bulk::WIDTH) {
+                _mm_prefetch((const char*)(src + i * 16 + crypto_runtime::PREFETCH_DISTANCE), _MM_HINT_NTA);
+                Bulk::crypt_step<true>(rk, src + i * 16, dst + i * 16);
+            }
+            _mm_sfence();
+        } else {
+            for (; i + Bulk::WIDTH <= num_blocks; i += Bulk::WIDTH) {
+                Bulk::crypt_step(rk, src + i * 16, dst + i * 16);
+            }
+        }
+        Quad::crypt_blocks(rk, src + i * 16, dst + i * 16, num_blocks - i);
+    }
+
+    // One block per lane, each lane with its own round keys. Used to batch small
+    // requests that arrive under different keys into a single kernel call.
+    static void encrypt_4blocks_lanes(const uint32_t* const rk[4], const uint8_t src[64], uint8_t dst[64]) {
+        Quad::crypt_lanes(rk, src, dst);
+    }
+
+    static std::string encrypt_block_hex(const std::string& plain_hex, const std::string& key_hex) {
+        assert(plain_hex.length() == 32);
+        assert(key_hex.length() == 32);
+        
+        auto plaintext = hex_to_bytes(plain_hex);
+        auto key = hex_to_bytes(key_hex);
+        auto round_keys = key_schedule(key);
+        auto ciphertext = encrypt_block(plaintext, round_keys.enc);
+        
+        return bytes_to_hex(ciphertext);
+    }
+    
+    static std::string decrypt_block_hex(const std::string& cipher_hex, const std::string& key_hex) {
+        assert(cipher_hex.length() == 32);
+        assert(key_hex.length() == 32);
+        
+        auto ciphertext = hex_to_bytes(cipher_hex);
+        auto key = hex_to_bytes(key_hex);
+        auto round_keys = key_schedule(key);
+        auto plaintext = encrypt_block(ciphertext, round_keys.dec);
+        
+        return bytes_to_hex(plaintext);
+    }
+    
+    static std::string encrypt_hex(const std::string& plain_hex, const std::string& key_hex) {
+        assert(plain_hex.length() % 32 == 0);
+        assert(key_hex.length() == 32);
+        
+        auto key = hex_to_bytes(key_hex);
+        auto round_keys = key_schedule(key);
+        
+        return crypt_hex_stream(plain_hex, round_keys.enc);
+    }
+    
+    static std::string decrypt_hex(const std::string& cipher_hex, const std::string& key_hex) {
+        assert(cipher_hex.length() % 32 == 0);
+        assert(key_hex.length() == 32);
+        
+        auto key = hex_to_bytes(key_hex);
+        auto round_keys = key_schedule(key);
+        
+        return crypt_hex_stream(cipher_hex, round_keys.dec);
+    }
+
+private:
+    static constexpr size_t STREAM_CHUNK_BYTES = 64 * 1024;
+
+    static uint8_t hex_nibble(char c) {
+        if (c >= '0' && c <= '9') return static_cast<uint8_t>(c - '0');
+        if (c >= 'a' && c <= 'f') return static_cast<uint8_t>(c - 'a' + 10);
+        if (c >= 'A' && c <= 'F') return static_cast<uint8_t>(c - 'A' + 10);
+        throw std::invalid_argument("invalid hex digit");
+    }
+
+    // Decodes, encrypts and re-encodes the input one pooled chunk at a time, so a long
+    // input costs one buffer acquisition instead of a vector per block.
+    static std::string crypt_hex_stream(const std::string& in_hex, const uint32_t rk[32]) {
+        static const char digits[] = "0123456789abcdef";
+        size_t total = in_hex.length() / 2;
+        std::string result(in_hex.length(), '\0');
+        if (total == 0) {
+            return result;
+        }
+
+        auto chunk = crypto_runtime::BufferPool::shared().acquire(std::min(total, STREAM_CHUNK_BYTES));
+        uint8_t* buf = chunk.data();
+
+        for (size_t off = 0; off < total; off += STREAM_CHUNK_BYTES) {
+            size_t n = std::min(STREAM_CHUNK_BYTES, total - off);
+            const char* in = in_hex.data() + off * 2;
+            for (size_t i = 0; i < n; i++) {
+                buf[i] = static_cast<uint8_t>((hex_nibble(in[2 * i]) << 4) | hex_nibble(in[2 * i + 1]));
+            }
+
+            encrypt_blocks(rk, buf, buf, n / 16);
+
+            char* out = &result[off * 2];
+            for (size_t i = 0; i < n; i++) {
+                out[2 * i] = digits[buf[i] >> 4];
+                out[2 * i + 1] = digits[buf[i] & 0x0F];
+            }
+        }
+
+        return result;
+    }
+};
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "sm4_async.h"
+
+/**
+ * Drives SM4Async from a single-threaded event loop: a burst of small concurrent
+ * requests under several keys (batched into lane kernel calls), one idle-loop request
+ * (inline) and one large buffer (worker pool). Every result is checked against the
+ * synchronous SM4_AESNI::encrypt_blocks and the standard test vector. A second front
+ * end destroyed before the loop runs again must take its batch flush hook with it, and a
+ * batch kernel that throws must resume every waiter of the batch with the exception.
+ */
+
+using crypto_async::EventLoop;
+using crypto_async::Task;
+
+static std::string to_hex(const uint8_t* data, size_t len) {
+    std::stringstream ss;
+    for (size_t i = 0; i < len; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(data[i]);
+    }
+    return ss.str();
+}
+
+static Task<void> roundtrip(SM4Async& sm4, const SM4Async::Context& ctx, std::vector<uint8_t>& buf,
+                            const std::vector<uint8_t>& expected, bool& ok) {
+    std::vector<uint8_t> original = buf;
+    co_await sm4.encrypt_async(ctx, buf);
+    ok = ok && buf == expected;
+    co_await sm4.decrypt_async(ctx, buf);
+    ok = ok && buf == original;
+}
+
+// Queues one job on a batcher and rethrows the batch's error, as the front ends do.
+struct BatchedJob {
+    crypto_async::Batcher<int>& batcher;
+    std::exception_ptr error;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        batcher.enqueue(0, 1, h, &error);
+    }
+
+    void await_resume() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+static Task<void> expect_kernel_error(crypto_async::Batcher<int>& batcher, int& caught, int& finished) {
+    try {
+        co_await BatchedJob{batcher};
+    } catch (const std::runtime_error&) {
+        caught++;
+    }
+    finished++;
+}
+
+static bool kernel_errors_reach_waiters() {
+    EventLoop loop;
+    crypto_async::AsyncStats stats;
+    // The first two jobs are flushed from inside enqueue(), the third at the end of the tick.
+    crypto_async::Batcher<int> batcher(
+        loop, [](std::vector<int>&) { throw std::runtime_error("kernel failed"); }, 2, stats);
+    int caught = 0, finished = 0;
+    for (int i = 0; i < 3; i++) {
+        loop.spawn(expect_kernel_error(batcher, caught, finished));
+    }
+    loop.run();
+    bool ok = caught == 3 && finished == 3 && stats.batches == 2;
+    std::cout << (ok ? "✓ " : "✗ ") << "A throwing batch kernel resumes every waiter with the exception"
+              << std::endl;
+    return ok;
+}
+
+int main() {
+    const uint8_t test_key[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+                                  0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10};
+    EventLoop loop;
+    SM4Async sm4(loop);
+
+    bool ok = true;
+
+    // Single request on an idle loop: runs inline.
+    auto test_ctx = SM4Async::make_context(test_key);
+    std::vector<uint8_t> vector_block(test_key, test_key + 16);
+    loop.spawn([](SM4Async& sm4, const SM4Async::Context& ctx, std::vector<uint8_t>& buf) -> Task<void> {
+        co_await sm4.encrypt_async(ctx, buf);
+    }(sm4, test_ctx, vector_block));
+    loop.run();
+    std::string vector_hex = to_hex(vector_block.data(), 16);
+    std::cout << "Test vector: " << vector_hex << std::endl;
+    ok = ok && vector_hex == "681edf34d206965e86b3e94f536e4246";
+
+    // Burst of small requests under 8 different keys, plus one large job.
+    const int num_small = 64;
+    const size_t large_size = 4 * 1024 * 1024;
+    std::vector<SM4Async::Context> contexts;
+    for (int k = 0; k < 8; k++) {
+        uint8_t key[16];
+        for (int i = 0; i < 16; i++) {
+            key[i] = static_cast<uint8_t>(k * 31 + i * 7);
+        }
+        contexts.push_back(SM4Async::make_context(key));
+    }
+
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<std::vector<uint8_t>> expected;
+    for (int j = 0; j <= num_small; j++) {
+        size_t size = (j == num_small) ? large_size : 16 * (1 + j % 3);
+        std::vector<uint8_t> buf(size);
+        for (size_t i = 0; i < size; i++) {
+            buf[i] = static_cast<uint8_t>(i * 13 + j);
+        }
+        std::vector<uint8_t> enc(size);
+        SM4_AESNI::encrypt_blocks(contexts[j % 8].rk_enc, buf.data(), enc.data(), size / 16);
+        buffers.push_back(std::move(buf));
+        expected.push_back(std::move(enc));
+    }
+
+    for (int j = 0; j <= num_small; j++) {
+        loop.spawn(roundtrip(sm4, contexts[j % 8], buffers[j], expected[j], ok));
+    }
+    loop.run();
+
+    // A front end that goes away before the loop: its tick hook must not outlive it.
+    auto scoped = std::make_unique<SM4Async>(loop);
+    std::vector<uint8_t> scoped_block(test_key, test_key + 16);
+    loop.spawn([](SM4Async& sm4, const SM4Async::Context& ctx, std::vector<uint8_t>& buf) -> Task<void> {
+        co_await sm4.encrypt_async(ctx, buf);
+    }(*scoped, test_ctx, scoped_block));
+    loop.run();
+    bool hooks_ok = loop.tick_hook_count() == 2;
+    scoped.reset();
+    hooks_ok = hooks_ok && loop.tick_hook_count() == 1;
+    std::vector<uint8_t> after_block(test_key, test_key + 16);
+    loop.spawn([](SM4Async& sm4, const SM4Async::Context& ctx, std::vector<uint8_t>& buf) -> Task<void> {
+        co_await sm4.encrypt_async(ctx, buf);
+    }(sm4, test_ctx, after_block));
+    loop.run();
+    hooks_ok = hooks_ok && to_hex(scoped_block.data(), 16) == vector_hex && after_block == scoped_block;
+    std::cout << (hooks_ok ? "✓ " : "✗ ") << "Destroyed front end removes its tick hook from the loop"
+              << std::endl;
+    ok = ok && hooks_ok;
+
+    ok = kernel_errors_reach_waiters() && ok;
+
+    const auto& stats = sm4.get_stats();
+    std::cout << "Inline jobs:    " << stats.inline_jobs << std::endl;
+    std::cout << "Batched jobs:   " << stats.batched_jobs << " in " << stats.batches << " batches" << std::endl;
+    std::cout << "Offloaded jobs: " << stats.offloaded_jobs << std::endl;
+
+    if (ok) {
+        std::cout << "✓ Async results match synchronous SM4" << std::endl;
+        return 0;
+    }
+    std::cout << "✗ Async results differ from synchronous SM4" << std::endl;
+    return 1;
+}
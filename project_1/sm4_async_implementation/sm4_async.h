@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "../crypto_runtime/crypto_async.h"
+#include "../sm4_aesni_implementation/sm4_aesni.h"
+
+/**
+ * Awaitable SM4-ECB front end for coroutine services.
+ *
+ *     SM4Async sm4(loop);
+ *     auto ctx = SM4Async::make_context(key);
+ *     co_await sm4.encrypt_async(ctx, span);   // in place, span.size() % 16 == 0
+ *
+ * Jobs are routed by size:
+ * - below AsyncConfig::offload_threshold with nothing else runnable: run inline;
+ * - below the threshold under load: queued and flushed at the end of the loop tick as
+ *   one call to the 4-lane AES-NI kernel, one block per lane, each lane keyed by its
+ *   own job so requests under different keys still share a kernel call;
+ * - at or above the threshold: encrypted on the shared worker pool.
+ */
+class SM4Async {
+public:
+    struct Context {
+        uint32_t rk_enc[32];
+        uint32_t rk_dec[32];
+    };
+
+    static Context make_context(const uint8_t key[16]) {
+        Context ctx;
+        SM4_AESNI::expand_key(key, ctx.rk_enc);
+        for (int i = 0; i < 32; i++) {
+            ctx.rk_dec[i] = ctx.rk_enc[31 - i];
+        }
+        return ctx;
+    }
+
+    class Awaiter {
+    public:
+        Awaiter(SM4Async& owner, const uint32_t* rk, std::span<uint8_t> data)
+            : owner(owner), rk(rk), data(data) {}
+
+        bool await_ready() {
+            if (data.size() >= owner.config.offload_threshold) {
+                return false;
+            }
+            if (owner.loop.idle() && owner.batcher.empty()) {
+                SM4_AESNI::encrypt_blocks(rk, data.data(), data.data(), data.size() / 16);
+                owner.stats.inline_jobs++;
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            if (data.size() >= owner.config.offload_threshold) {
+                owner.stats.offloaded_jobs++;
+                offload.emplace(owner.loop, crypto_async::WorkerPool::shared(), [rk = rk, data = data] {
+                    SM4_AESNI::encrypt_blocks(rk, data.data(), data.data(), data.size() / 16);
+                });
+                offload->await_suspend(h);
+                return;
+            }
+            owner.batcher.enqueue(Job{rk, data}, data.size() / 16, h, &batch_error);
+        }
+
+        void await_resume() {
+            if (offload) {
+                offload->await_resume();
+            }
+            if (batch_error) {
+                std::rethrow_exception(batch_error);
+            }
+        }
+
+    private:
+        SM4Async& owner;
+        const uint32_t* rk;
+        std::span<uint8_t> data;
+        std::optional<crypto_async::OffloadAwaiter> offload;
+        std::exception_ptr batch_error;
+    };
+
+    explicit SM4Async(crypto_async::EventLoop& loop, crypto_async::AsyncConfig config = {})
+        : loop(loop), config(config),
+          batcher(loop, [](std::vector<Job>& jobs) { run_lanes(jobs); }, config.max_batch_units, stats) {}
+
+    Awaiter encrypt_async(const Context& ctx, std::span<uint8_t> data) {
+        assert(data.size() % 16 == 0);
+        return Awaiter(*this, ctx.rk_enc, data);
+    }
+
+    Awaiter decrypt_async(const Context& ctx, std::span<uint8_t> data) {
+        assert(data.size() % 16 == 0);
+        return Awaiter(*this, ctx.rk_dec, data);
+    }
+
+    const crypto_async::AsyncStats& get_stats() const {
+        return stats;
+    }
+
+private:
+    struct Job {
+        const uint32_t* rk;
+        std::span<uint8_t> data;
+    };
+
+    // Walks every block of every queued job and feeds them four at a time to the
+    // per-lane-key kernel, so a batch of 1-block requests costs one kernel call per
+    // four requests instead of one each.
+    static void run_lanes(std::vector<Job>& jobs) {
+        alignas(16) uint8_t src[64] = {0};
+        alignas(16) uint8_t dst[64];
+        const uint32_t* lane_rk[4];
+        uint8_t* lane_out[4];
+        int lanes = 0;
+
+        auto drain = [&] {
+            for (int l = lanes; l < 4; l++) {
+                lane_rk[l] = lane_rk[0];
+            }
+            SM4_AESNI::encrypt_4blocks_lanes(lane_rk, src, dst);
+            for (int l = 0; l < lanes; l++) {
+                std::memcpy(lane_out[l], dst + l * 16, 16);
+            }
+            lanes = 0;
+        };
+
+        for (auto& job : jobs) {
+            for (size_t off = 0; off < job.data.size(); off += 16) {
+                std::memcpy(src + lanes * 16, job.data.data() + off, 16);
+                lane_rk[lanes] = job.rk;
+                lane_out[lanes] = job.data.data() + off;
+                if (++lanes == 4) {
+                    drain();
+                }
+            }
+        }
+        if (lanes > 0) {
+            drain();
+        }
+    }
+
+    crypto_async::EventLoop& loop;
+    crypto_async::AsyncConfig config;
+    crypto_async::AsyncStats stats;
+    crypto_async::Batcher<Job> batcher;
+};
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <pthread.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "../crypto_runtime/buffer_pool.h"
+#include "../sm4_engine_implementation/sm4_engine.h"
+
+/**
+ * SM4-based CTR_DRBG (NIST SP 800-90A, block cipher SM4, no derivation function) and a
+ * per-thread buffered front end for small random requests.
+ *
+ *     sm4_drbg::random_bytes(nonce, 12);
+ *
+ * SM4CtrDrbg implements instantiate / reseed / generate with seedlen = key (16) + V (16)
+ * bytes. Generate lays out the counter blocks V+1, V+2, ... in the output buffer and
+ * encrypts them in place with the widest SM4Engine instantiation the CPU supports, so a
+ * 64 KiB request is one multi-block kernel call.
+ *
+ * random_bytes() serves requests from a 64 KiB per-thread ring that is refilled with one
+ * maximum-size generate call when it runs dry; an 8-32 byte request is a memcpy. Served
+ * bytes are wiped from the ring. The generator reseeds from getrandom() after
+ * reseed_interval generate calls and after fork().
+ */
+namespace sm4_drbg {
+
+class SM4CtrDrbg {
+public:
+    static constexpr size_t KEY_BYTES = 16;
+    static constexpr size_t BLOCK_BYTES = 16;
+    static constexpr size_t SEED_BYTES = KEY_BYTES + BLOCK_BYTES;
+    // 2^19 bits, the SP 800-90A limit for one generate call.
+    static constexpr size_t MAX_REQUEST_BYTES = 64 * 1024;
+
+    struct Config {
+        uint64_t reseed_interval = uint64_t(1) << 16;  // generate calls between reseeds
+    };
+
+    struct Stats {
+        uint64_t generate_calls = 0;
+        uint64_t reseeds = 0;
+        uint64_t bytes_generated = 0;
+    };
+
+    using Kernel = void (*)(const uint32_t rk[32], const uint8_t* src, uint8_t* dst, size_t num_blocks);
+
+    SM4CtrDrbg() : SM4CtrDrbg(Config()) {}
+    explicit SM4CtrDrbg(Config config) : config(config), kernel(select_kernel()) {}
+
+    ~SM4CtrDrbg() {
+        wipe();
+    }
+
+    SM4CtrDrbg(const SM4CtrDrbg&) = delete;
+    SM4CtrDrbg& operator=(const SM4CtrDrbg&) = delete;
+
+    // entropy must hold SEED_BYTES of full-entropy input; personalization is optional
+    // and at most SEED_BYTES long.
+    void instantiate(const uint8_t entropy[SEED_BYTES], const uint8_t* personalization = nullptr,
+                     size_t personalization_len = 0) {
+        uint8_t seed[SEED_BYTES];
+        combine(seed, entropy, personalization, personalization_len);
+        std::memset(key, 0, sizeof(key));
+        std::memset(v, 0, sizeof(v));
+        sm4_engine::expand_key(key, round_keys);
+        update(seed);
+        std::memset(seed, 0, sizeof(seed));
+        reseed_counter = 1;
+        instantiated = true;
+    }
+
+    // Instantiates from the operating system's entropy source.
+    void instantiate_from_os(const uint8_t* personalization = nullptr, size_t personalization_len = 0) {
+        uint8_t entropy[SEED_BYTES];
+        os_entropy(entropy, sizeof(entropy));
+        instantiate(entropy, personalization, personalization_len);
+        std::memset(entropy, 0, sizeof(entropy));
+    }
+
+    void reseed(const uint8_t entropy[SEED_BYTES], const uint8_t* additional = nullptr, size_t additional_len = 0) {
+        uint8_t seed[SEED_BYTES];
+        combine(seed, entropy, additional, additional_len);
+        update(seed);
+        std::memset(seed, 0, sizeof(seed));
+        reseed_counter = 1;
+        stats.reseeds++;
+    }
+
+    void reseed_from_os() {
+        uint8_t entropy[SEED_BYTES];
+        os_entropy(entropy, sizeof(entropy));
+        reseed(entropy);
+        std::memset(entropy, 0, sizeof(entropy));
+    }
+
+    bool needs_reseed() const {
+        return reseed_counter > config.reseed_interval;
+    }
+
+    // SP 800-90A generate; callers that cannot supply entropy reseed from the OS when
+    // needs_reseed() is true before calling.
+    void generate(uint8_t* out, size_t n, const uint8_t* additional = nullptr, size_t additional_len = 0) {
+        if (!instantiated) {
+            throw std::logic_error("SM4CtrDrbg: generate before instantiate");
+        }
+        if (n > MAX_REQUEST_BYTES) {
+            throw std::invalid_argument("SM4CtrDrbg: request exceeds 64 KiB");
+        }
+        if (needs_reseed()) {
+            throw std::logic_error("SM4CtrDrbg: reseed required");
+        }
+
+        uint8_t add[SEED_BYTES] = {};
+        if (additional_len > 0) {
+            combine(add, add, additional, additional_len);
+            update(add);
+        }
+
+        size_t full = n / BLOCK_BYTES;
+        for (size_t i = 0; i < full; i++) {
+            increment(v);
+            std::memcpy(out + i * BLOCK_BYTES, v, BLOCK_BYTES);
+        }
+        kernel(round_keys.enc, out, out, full);
+        if (size_t tail = n - full * BLOCK_BYTES) {
+            uint8_t block[BLOCK_BYTES];
+            increment(v);
+            kernel(round_keys.enc, v, block, 1);
+            std::memcpy(out + full * BLOCK_BYTES, block, tail);
+            std::memset(block, 0, sizeof(block));
+        }
+
+        update(add);
+        reseed_counter++;
+        stats.generate_calls++;
+        stats.bytes_generated += n;
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    static void os_entropy(uint8_t* out, size_t n) {
+        while (n > 0) {
+            ssize_t got = getrandom(out, n, 0);
+            if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("SM4CtrDrbg: getrandom failed");
+            }
+            out += got;
+            n -= static_cast<size_t>(got);
+        }
+    }
+
+    static Kernel select_kernel() {
+        if (sm4_engine::GfniSBox::is_supported()) {
+            return &sm4_engine::SM4Engine<sm4_engine::GfniSBox, 16>::crypt_blocks;
+        }
+        if (sm4_engine::AesniSBox::is_supported()) {
+            return &sm4_engine::SM4Engine<sm4_engine::AesniSBox, 16>::crypt_blocks;
+        }
+        return &sm4_engine::SM4Engine<sm4_engine::TableSBox, 4>::crypt_blocks;
+    }
+
+private:
+    // seed = data ^ (extra zero-padded to SEED_BYTES)
+    static void combine(uint8_t seed[SEED_BYTES], const uint8_t data[SEED_BYTES], const uint8_t* extra,
+                        size_t extra_len) {
+        if (extra_len > SEED_BYTES) {
+            throw std::invalid_argument("SM4CtrDrbg: additional input longer than seedlen");
+        }
+        std::memmove(seed, data, SEED_BYTES);
+        for (size_t i = 0; i < extra_len; i++) {
+            seed[i] ^= extra[i];
+        }
+    }
+
+    // V is a 128-bit big-endian counter.
+    static void increment(uint8_t ctr[BLOCK_BYTES]) {
+        for (int i = BLOCK_BYTES - 1; i >= 0; i--) {
+            if (++ctr[i] != 0) {
+                break;
+            }
+        }
+    }
+
+    // CTR_DRBG_Update: two counter blocks under the current key, XORed with the
+    // provided data, become the new key and V.
+    void update(const uint8_t provided[SEED_BYTES]) {
+        uint8_t temp[SEED_BYTES];
+        increment(v);
+        std::memcpy(temp, v, BLOCK_BYTES);
+        increment(v);
+        std::memcpy(temp + BLOCK_BYTES, v, BLOCK_BYTES);
+        kernel(round_keys.enc, temp, temp, 2);
+        for (size_t i = 0; i < SEED_BYTES; i++) {
+            temp[i] ^= provided[i];
+        }
+        std::memcpy(key, temp, KEY_BYTES);
+        std::memcpy(v, temp + KEY_BYTES, BLOCK_BYTES);
+        sm4_engine::expand_key(key, round_keys);
+        std::memset(temp, 0, sizeof(temp));
+    }
+
+    void wipe() {
+        volatile uint8_t* p = reinterpret_cast<volatile uint8_t*>(&round_keys);
+        for (size_t i = 0; i < sizeof(round_keys); i++) {
+            p[i] = 0;
+        }
+        std::memset(key, 0, sizeof(key));
+        std::memset(v, 0, sizeof(v));
+    }
+
+    Config config;
+    Kernel kernel;
+    uint8_t key[KEY_BYTES] = {};
+    uint8_t v[BLOCK_BYTES] = {};
+    sm4_engine::SM4Key round_keys = {};
+    uint64_t reseed_counter = 0;
+    bool instantiated = false;
+    Stats stats;
+};
+
+/**
+ * Per-thread ring of pre-generated output. Requests up to RING_BYTES are copied out of
+ * the ring; larger ones are generated straight into the caller's buffer.
+ */
+class ThreadRandom {
+public:
+    static constexpr size_t RING_BYTES = SM4CtrDrbg::MAX_REQUEST_BYTES;
+
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t refills = 0;
+        uint64_t bytes_served = 0;
+    };
+
+    static ThreadRandom& local() {
+        thread_local ThreadRandom instance;
+        return instance;
+    }
+
+    void fill(uint8_t* out, size_t n) {
+        if (generation != fork_generation().load(std::memory_order_relaxed)) {
+            // After fork() the child would replay the parent's ring and key.
+            discard();
+            drbg.reseed_from_os();
+            generation = fork_generation().load(std::memory_order_relaxed);
+        }
+        stats.requests++;
+        stats.bytes_served += n;
+
+        if (n > RING_BYTES) {
+            while (n > 0) {
+                size_t chunk = n < SM4CtrDrbg::MAX_REQUEST_BYTES ? n : SM4CtrDrbg::MAX_REQUEST_BYTES;
+                generate(out, chunk);
+                out += chunk;
+                n -= chunk;
+            }
+            return;
+        }
+
+        while (n > 0) {
+            if (pos == RING_BYTES) {
+                refill();
+            }
+            size_t take = RING_BYTES - pos < n ? RING_BYTES - pos : n;
+            std::memcpy(out, ring.data() + pos, take);
+            std::memset(ring.data() + pos, 0, take);
+            pos += take;
+            out += take;
+            n -= take;
+        }
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    const SM4CtrDrbg::Stats& drbg_stats() const {
+        return drbg.get_stats();
+    }
+
+private:
+    ThreadRandom() : ring(crypto_runtime::BufferPool::shared().acquire(RING_BYTES)) {
+        generation = fork_generation().load(std::memory_order_relaxed);
+        drbg.instantiate_from_os();
+    }
+
+    // Bumped in the child by a pthread_atfork handler; getpid() is a system call on
+    // current glibc and would dominate a 16-byte request.
+    static std::atomic<uint64_t>& fork_generation() {
+        static std::atomic<uint64_t> counter{0};
+        static const bool registered = [] {
+            pthread_atfork(nullptr, nullptr, [] { counter.fetch_add(1, std::memory_order_relaxed); });
+            return true;
+        }();
+        (void)registered;
+        return counter;
+    }
+
+    ~ThreadRandom() {
+        discard();
+    }
+
+    void generate(uint8_t* out, size_t n) {
+        if (drbg.needs_reseed()) {
+            drbg.reseed_from_os();
+        }
+        drbg.generate(out, n);
+    }
+
+    void refill() {
+        generate(ring.data(), RING_BYTES);
+        pos = 0;
+        stats.refills++;
+    }
+
+    void discard() {
+        std::memset(ring.data() + pos, 0, RING_BYTES - pos);
+        pos = RING_BYTES;
+    }
+
+    SM4CtrDrbg drbg;
+    crypto_runtime::BufferPool::Buffer ring;
+    size_t pos = RING_BYTES;  // ring starts empty
+    uint64_t generation = 0;
+    Stats stats;
+};
+
+inline void random_bytes(void* out, size_t n) {
+    ThreadRandom::local().fill(static_cast<uint8_t*>(out), n);
+}
+
+}  // namespace sm4_drbg
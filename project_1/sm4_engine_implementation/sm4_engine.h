@@ -0,0 +1,691 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <immintrin.h>
+
+/**
+ * Compile-time specialized SM4 engine.
+ *
+ *     SM4Engine<SBoxStrategy, Width>::crypt_blocks(rk, src, dst, num_blocks);
+ *
+ * The S-box strategy fixes the vector type, how many blocks one vector carries (LANES)
+ * and the round function T = L(tau(.)):
+ * - TableSBox:     scalar words, four combined S-box + L tables generated at compile time;
+ * - AesniSBox:     4 blocks per __m128i, S-box through AESENCLAST and affine shuffles;
+ * - GfniSBox:      8 blocks per __m256i, S-box through GF2P8AFFINEINVQB;
+ * - BitslicedSBox: 16 blocks, S-box evaluated on 8 bit planes (constant time, no tables).
+ *
+ * Width is the number of blocks processed per step (1, 4, 8 or 16). Widths above LANES
+ * interleave Width / LANES independent groups for instruction-level parallelism; widths
+ * below LANES pad the step to one full vector. The 32 rounds are expanded from an
+ * index_sequence, so every round is its own instantiation with R a compile-time
+ * constant: the state slot R % 4 and the round key offset are resolved at compile time
+ * and the round loop, its counter and the state rotation disappear.
+ *
+ * SM4_AESNI, SM4_GFNI and the T-table program are instantiations of this template;
+ * reference_crypt_block() is the one scalar implementation kept outside it, for the
+ * self-test and the basic sm4.cpp program.
+ */
+namespace sm4_engine {
+
+constexpr uint8_t SBOX[256] = {
+    0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7, 0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+    0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3, 0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+    0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a, 0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+    0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95, 0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+    0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba, 0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+    0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b, 0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+    0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2, 0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+    0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52, 0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+    0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5, 0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+    0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55, 0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+    0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60, 0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+    0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f, 0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+    0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f, 0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+    0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd, 0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+    0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e, 0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+    0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20, 0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48
+};
+
+constexpr uint32_t FK[4] = {
+    0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc
+};
+
+constexpr uint32_t CK[32] = {
+    0x00070e15, 0x1c232a31, 0x383f464d, 0x545b6269,
+    0x70777e85, 0x8c939aa1, 0xa8afb6bd, 0xc4cbd2d9,
+    0xe0e7eef5, 0xfc030a11, 0x181f262d, 0x343b4249,
+    0x50575e65, 0x6c737a81, 0x888f969d, 0xa4abb2b9,
+    0xc0c7ced5, 0xdce3eaf1, 0xf8ff060d, 0x141b2229,
+    0x30373e45, 0x4c535a61, 0x686f767d, 0x848b9299,
+    0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
+    0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279
+};
+
+#define SM4_ENGINE_INLINE inline __attribute__((always_inline))
+
+constexpr uint32_t rotl32(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+constexpr uint32_t linear_l(uint32_t b) {
+    return b ^ rotl32(b, 2) ^ rotl32(b, 10) ^ rotl32(b, 18) ^ rotl32(b, 24);
+}
+
+constexpr uint32_t load_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void store_be32(uint32_t value, uint8_t* p) {
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+// Compile-time table and matrix generators.
+namespace detail {
+
+constexpr std::array<std::array<uint32_t, 256>, 4> make_t_tables() {
+    std::array<std::array<uint32_t, 256>, 4> t{};
+    for (int pos = 0; pos < 4; pos++) {
+        for (int b = 0; b < 256; b++) {
+            t[pos][b] = linear_l(static_cast<uint32_t>(SBOX[b]) << (24 - 8 * pos));
+        }
+    }
+    return t;
+}
+
+// Bitsliced S-box parameters: S(x) = A * inv(A * x + c) + c over GF(2^8) mod FIELD_POLY,
+// where A is the circulant matrix generated by AFFINE_ROW.
+constexpr uint8_t AFFINE_ROW = 0xD3;
+constexpr uint8_t AFFINE_CONST = 0xD3;
+constexpr unsigned FIELD_POLY = 0x1F5;
+
+// Row i of a GF(2) matrix is the mask of input bits that feed output bit i.
+constexpr std::array<uint8_t, 8> affine_rows() {
+    std::array<uint8_t, 8> rows{};
+    for (int i = 0; i < 8; i++) {
+        rows[7 - i] = static_cast<uint8_t>((AFFINE_ROW >> i) | (AFFINE_ROW << (8 - i)));
+    }
+    return rows;
+}
+
+constexpr unsigned field_square(unsigned a) {
+    unsigned r = 0, b = a;
+    while (b) {
+        if (b & 1) {
+            r ^= a;
+        }
+        b >>= 1;
+        a <<= 1;
+        if (a & 0x100) {
+            a ^= FIELD_POLY;
+        }
+    }
+    return r;
+}
+
+constexpr std::array<uint8_t, 8> square_rows() {
+    std::array<uint8_t, 8> rows{};
+    for (int j = 0; j < 8; j++) {
+        unsigned col = field_square(1u << j);
+        for (int i = 0; i < 8; i++) {
+            if ((col >> i) & 1) {
+                rows[i] |= static_cast<uint8_t>(1u << j);
+            }
+        }
+    }
+    return rows;
+}
+
+constexpr uint64_t pack_rows(const std::array<uint8_t, 8>& rows) {
+    uint64_t packed = 0;
+    for (int i = 0; i < 8; i++) {
+        packed |= static_cast<uint64_t>(rows[i]) << (8 * i);
+    }
+    return packed;
+}
+
+}  // namespace detail
+
+// Encryption and decryption round keys; decryption is the same network with the
+// schedule reversed.
+struct SM4Key {
+    uint32_t enc[32];
+    uint32_t dec[32];
+};
+
+inline void expand_key(const uint8_t key[16], SM4Key& out) {
+    uint32_t k[4];
+    for (int i = 0; i < 4; i++) {
+        k[i] = load_be32(key + i * 4) ^ FK[i];
+    }
+    for (int i = 0; i < 32; i++) {
+        uint32_t a = k[(i + 1) & 3] ^ k[(i + 2) & 3] ^ k[(i + 3) & 3] ^ CK[i];
+        uint32_t b = (static_cast<uint32_t>(SBOX[a >> 24]) << 24) | (static_cast<uint32_t>(SBOX[(a >> 16) & 0xFF]) << 16) |
+                     (static_cast<uint32_t>(SBOX[(a >> 8) & 0xFF]) << 8) | static_cast<uint32_t>(SBOX[a & 0xFF]);
+        k[i & 3] ^= b ^ rotl32(b, 13) ^ rotl32(b, 23);
+        out.enc[i] = k[i & 3];
+    }
+    for (int i = 0; i < 32; i++) {
+        out.dec[i] = out.enc[31 - i];
+    }
+}
+
+// The textbook cipher on one block, the S-box applied byte by byte and L computed with
+// rotations: the independent scalar reference every instantiation is checked against.
+inline void reference_crypt_block(const uint32_t rk[32], const uint8_t src[16], uint8_t dst[16]) {
+    uint32_t x[36];
+    for (int i = 0; i < 4; i++) {
+        x[i] = load_be32(src + 4 * i);
+    }
+    for (int i = 0; i < 32; i++) {
+        uint32_t a = x[i + 1] ^ x[i + 2] ^ x[i + 3] ^ rk[i];
+        uint32_t b = (static_cast<uint32_t>(SBOX[a >> 24]) << 24) | (static_cast<uint32_t>(SBOX[(a >> 16) & 0xFF]) << 16) |
+                     (static_cast<uint32_t>(SBOX[(a >> 8) & 0xFF]) << 8) | static_cast<uint32_t>(SBOX[a & 0xFF]);
+        x[i + 4] = x[i] ^ linear_l(b);
+    }
+    for (int i = 0; i < 4; i++) {
+        store_be32(x[35 - i], dst + 4 * i);
+    }
+}
+
+/**
+ * Scalar T-table strategy: T(x) = T0[x>>24] ^ T1[x>>16 & 0xff] ^ T2[..] ^ T3[..], where
+ * each table already has L applied to the S-box output in its byte position.
+ */
+struct TableSBox {
+    using Vec = uint32_t;
+    static constexpr size_t LANES = 1;
+
+    alignas(64) static constexpr std::array<std::array<uint32_t, 256>, 4> T = detail::make_t_tables();
+
+    static bool is_supported() {
+        return true;
+    }
+
+    static SM4_ENGINE_INLINE Vec broadcast(uint32_t k) {
+        return k;
+    }
+
+    static SM4_ENGINE_INLINE Vec round_t(Vec x) {
+        return T[0][x >> 24] ^ T[1][(x >> 16) & 0xFF] ^ T[2][(x >> 8) & 0xFF] ^ T[3][x & 0xFF];
+    }
+
+    static SM4_ENGINE_INLINE void load(const uint8_t* src, Vec x[4]) {
+        for (int k = 0; k < 4; k++) {
+            x[k] = load_be32(src + 4 * k);
+        }
+    }
+
+    static SM4_ENGINE_INLINE void store(const Vec x[4], uint8_t* dst) {
+        for (int k = 0; k < 4; k++) {
+            store_be32(x[k], dst + 4 * k);
+        }
+    }
+};
+
+// The vector strategies exist only when their instruction sets are enabled at compile
+// time (-maes -mssse3, -mgfni -mavx2): their intrinsics cannot be inlined otherwise, so
+// a scalar build such as the T-table program sees TableSBox and BitslicedSBox alone.
+#if defined(__AES__) && defined(__SSSE3__)
+/**
+ * AES-NI strategy, four blocks transposed into one __m128i per state word. The S-box is
+ * an affine map into the AES field, AESENCLAST (ShiftRows undone beforehand) and an
+ * affine map back; the nibble tables are the ones used by SM4_AESNI.
+ */
+struct AesniSBox {
+    using Vec = __m128i;
+    static constexpr size_t LANES = 4;
+
+    static bool is_supported() {
+        return __builtin_cpu_supports("aes") && __builtin_cpu_supports("ssse3");
+    }
+
+    static SM4_ENGINE_INLINE Vec broadcast(uint32_t k) {
+        return _mm_set1_epi32(static_cast<int>(k));
+    }
+
+    // Round key r of four different schedules, one per lane.
+    static SM4_ENGINE_INLINE Vec gather(const uint32_t* const rk[4], size_t r) {
+        return _mm_set_epi32(static_cast<int>(rk[3][r]), static_cast<int>(rk[2][r]), static_cast<int>(rk[1][r]),
+                             static_cast<int>(rk[0][r]));
+    }
+
+    static SM4_ENGINE_INLINE Vec round_t(Vec x) {
+        const __m128i c0f = _mm_set1_epi8(0x0F);
+        const __m128i shr = _mm_set_epi64x(0x0306090C0F020508LL, 0x0B0E0104070A0D00LL);
+        const __m128i m1l = _mm_set_epi64x(0xC7C1B4B222245157LL, 0x9197E2E474720701LL);
+        const __m128i m1h = _mm_set_epi64x(0xF052B91BF95BB012LL, 0xE240AB09EB49A200LL);
+        const __m128i m2l = _mm_set_epi64x(0xEDD14478172BBE82LL, 0x5B67F2CEA19D0834LL);
+        const __m128i m2h = _mm_set_epi64x(0x11CDBE62CC1063BFLL, 0xAE7201DD73AFDC00LL);
+        const __m128i r08 = _mm_set_epi64x(0x0E0D0C0F0A09080BLL, 0x0605040702010003LL);
+        const __m128i r16 = _mm_set_epi64x(0x0D0C0F0E09080B0ALL, 0x0504070601000302LL);
+        const __m128i r24 = _mm_set_epi64x(0x0C0F0E0D080B0A09LL, 0x0407060500030201LL);
+
+        __m128i y = _mm_shuffle_epi8(m1l, _mm_and_si128(x, c0f));
+        x = _mm_shuffle_epi8(m1h, _mm_and_si128(_mm_srli_epi64(x, 4), c0f)) ^ y;
+        x = _mm_shuffle_epi8(x, shr);
+        x = _mm_aesenclast_si128(x, c0f);
+        y = _mm_shuffle_epi8(m2l, _mm_andnot_si128(x, c0f));
+        x = _mm_shuffle_epi8(m2h, _mm_and_si128(_mm_srli_epi64(x, 4), c0f)) ^ y;
+
+        y = x ^ _mm_shuffle_epi8(x, r08) ^ _mm_shuffle_epi8(x, r16);
+        y = _mm_slli_epi32(y, 2) ^ _mm_srli_epi32(y, 30);
+        return x ^ y ^ _mm_shuffle_epi8(x, r24);
+    }
+
+    static SM4_ENGINE_INLINE void transpose(__m128i& x0, __m128i& x1, __m128i& x2, __m128i& x3) {
+        __m128i t0 = _mm_unpacklo_epi32(x0, x1);
+        __m128i t1 = _mm_unpackhi_epi32(x0, x1);
+        __m128i t2 = _mm_unpacklo_epi32(x2, x3);
+        __m128i t3 = _mm_unpackhi_epi32(x2, x3);
+        x0 = _mm_unpacklo_epi64(t0, t2);
+        x1 = _mm_unpackhi_epi64(t0, t2);
+        x2 = _mm_unpacklo_epi64(t1, t3);
+        x3 = _mm_unpackhi_epi64(t1, t3);
+    }
+
+    static SM4_ENGINE_INLINE void load(const uint8_t* src, Vec x[4]) {
+        const __m128i flp = _mm_set_epi64x(0x0C0D0E0F08090A0BLL, 0x0405060700010203LL);
+        for (int b = 0; b < 4; b++) {
+            x[b] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16 * b)), flp);
+        }
+        transpose(x[0], x[1], x[2], x[3]);
+    }
+
+    // Streaming writes with non-temporal stores; dst must then be 16-byte aligned.
+    template <bool Streaming = false>
+    static SM4_ENGINE_INLINE void store(const Vec x[4], uint8_t* dst) {
+        const __m128i flp = _mm_set_epi64x(0x0C0D0E0F08090A0BLL, 0x0405060700010203LL);
+        __m128i t[4] = {x[0], x[1], x[2], x[3]};
+        transpose(t[0], t[1], t[2], t[3]);
+        for (int b = 0; b < 4; b++) {
+            __m128i* out = reinterpret_cast<__m128i*>(dst + 16 * b);
+            if constexpr (Streaming) {
+                _mm_stream_si128(out, _mm_shuffle_epi8(t[b], flp));
+            } else {
+                _mm_storeu_si128(out, _mm_shuffle_epi8(t[b], flp));
+            }
+        }
+    }
+};
+
+#endif  // __AES__ && __SSSE3__
+
+#if defined(__GFNI__) && defined(__AVX2__)
+/**
+ * GFNI/AVX2 strategy, eight blocks per __m256i: blocks 0-3 in the low 128-bit lane and
+ * blocks 4-7 in the high lane, so the transpose and the byte rotations stay in-lane.
+ * Same affine matrices as SM4_GFNI.
+ */
+struct GfniSBox {
+    using Vec = __m256i;
+    static constexpr size_t LANES = 8;
+
+    static bool is_supported() {
+        return __builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2");
+    }
+
+    static SM4_ENGINE_INLINE Vec broadcast(uint32_t k) {
+        return _mm256_set1_epi32(static_cast<int>(k));
+    }
+
+    static SM4_ENGINE_INLINE __m256i rol_bytes(__m256i x, int64_t lo, int64_t hi) {
+        return _mm256_shuffle_epi8(x, _mm256_set_epi64x(hi, lo, hi, lo));
+    }
+
+    static SM4_ENGINE_INLINE Vec round_t(Vec x) {
+        const __m256i pre = _mm256_set1_epi64x(0x34ac259e022dbc52LL);
+        const __m256i post = _mm256_set1_epi64x(static_cast<int64_t>(0xd72d8e511e6c8b19ULL));
+        x = _mm256_gf2p8affine_epi64_epi8(x, pre, 0x65);
+        x = _mm256_gf2p8affineinv_epi64_epi8(x, post, 0xd3);
+
+        __m256i y = x ^ rol_bytes(x, 0x0605040702010003LL, 0x0E0D0C0F0A09080BLL)
+                      ^ rol_bytes(x, 0x0504070601000302LL, 0x0D0C0F0E09080B0ALL);
+        y = _mm256_slli_epi32(y, 2) ^ _mm256_srli_epi32(y, 30);
+        return x ^ y ^ rol_bytes(x, 0x0407060500030201LL, 0x0C0F0E0D080B0A09LL);
+    }
+
+    static SM4_ENGINE_INLINE void transpose(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3) {
+        __m256i t0 = _mm256_unpacklo_epi32(x0, x1);
+        __m256i t1 = _mm256_unpackhi_epi32(x0, x1);
+        __m256i t2 = _mm256_unpacklo_epi32(x2, x3);
+        __m256i t3 = _mm256_unpackhi_epi32(x2, x3);
+        x0 = _mm256_unpacklo_epi64(t0, t2);
+        x1 = _mm256_unpackhi_epi64(t0, t2);
+        x2 = _mm256_unpacklo_epi64(t1, t3);
+        x3 = _mm256_unpackhi_epi64(t1, t3);
+    }
+
+    static SM4_ENGINE_INLINE void load(const uint8_t* src, Vec x[4]) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 0));   // blocks 0, 1
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));  // blocks 2, 3
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));  // blocks 4, 5
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));  // blocks 6, 7
+        const int64_t flp_lo = 0x0405060700010203LL, flp_hi = 0x0C0D0E0F08090A0BLL;
+        x[0] = rol_bytes(_mm256_permute2x128_si256(a, c, 0x20), flp_lo, flp_hi);
+        x[1] = rol_bytes(_mm256_permute2x128_si256(a, c, 0x31), flp_lo, flp_hi);
+        x[2] = rol_bytes(_mm256_permute2x128_si256(b, d, 0x20), flp_lo, flp_hi);
+        x[3] = rol_bytes(_mm256_permute2x128_si256(b, d, 0x31), flp_lo, flp_hi);
+        transpose(x[0], x[1], x[2], x[3]);
+    }
+
+    // Streaming writes with non-temporal stores. They are issued 16 bytes at a time so
+    // that, as for AesniSBox, a 16-byte aligned dst is enough.
+    template <bool Streaming = false>
+    static SM4_ENGINE_INLINE void store(const Vec x[4], uint8_t* dst) {
+        const int64_t flp_lo = 0x0405060700010203LL, flp_hi = 0x0C0D0E0F08090A0BLL;
+        __m256i t0 = x[0], t1 = x[1], t2 = x[2], t3 = x[3];
+        transpose(t0, t1, t2, t3);
+        t0 = rol_bytes(t0, flp_lo, flp_hi);
+        t1 = rol_bytes(t1, flp_lo, flp_hi);
+        t2 = rol_bytes(t2, flp_lo, flp_hi);
+        t3 = rol_bytes(t3, flp_lo, flp_hi);
+        const __m256i out[4] = {_mm256_permute2x128_si256(t0, t1, 0x20), _mm256_permute2x128_si256(t2, t3, 0x20),
+                                _mm256_permute2x128_si256(t0, t1, 0x31), _mm256_permute2x128_si256(t2, t3, 0x31)};
+        for (int i = 0; i < 4; i++) {
+            if constexpr (Streaming) {
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32 * i), _mm256_castsi256_si128(out[i]));
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32 * i + 16), _mm256_extracti128_si256(out[i], 1));
+            } else {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32 * i), out[i]);
+            }
+        }
+    }
+};
+
+#endif  // __GFNI__ && __AVX2__
+
+/**
+ * Bitsliced strategy, sixteen blocks. Each state word is sixteen scalar words; for the
+ * S-box their 64 bytes are transposed into 8 uint64 bit planes (plane p holds bit p of
+ * every byte) and S(x) = A * inv(A * x + c) + c is evaluated with logic operations only:
+ * A and the field squaring are GF(2) matrices, inv(x) = x^254 in GF(2^8) mod
+ * x^8+x^7+x^6+x^5+x^4+x^2+1. No memory access depends on the data. One S-box call
+ * covers only 64 bytes, so the roughly thousand logic operations of the circuit are
+ * amortized over few bytes: this is the constant-time fallback, not the fast path.
+ */
+struct BitslicedSBox {
+    struct Vec {
+        uint32_t w[16];
+    };
+    static constexpr size_t LANES = 16;
+
+    using Planes = uint64_t[8];
+
+    // GF(2) matrices packed one row per byte, so they can be template arguments and
+    // every row test folds to a constant.
+    static constexpr uint64_t A = detail::pack_rows(detail::affine_rows());
+    static constexpr uint64_t SQ = detail::pack_rows(detail::square_rows());
+
+    static bool is_supported() {
+        return true;
+    }
+
+    static SM4_ENGINE_INLINE Vec broadcast(uint32_t k) {
+        Vec v;
+        for (int i = 0; i < 16; i++) {
+            v.w[i] = k;
+        }
+        return v;
+    }
+
+    template <uint64_t Rows>
+    static SM4_ENGINE_INLINE void linear(const Planes in, Planes out) {
+#pragma GCC unroll 8
+        for (int i = 0; i < 8; i++) {
+            uint64_t acc = 0;
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++) {
+                if ((Rows >> (8 * i + j)) & 1) {
+                    acc ^= in[j];
+                }
+            }
+            out[i] = acc;
+        }
+    }
+
+    static SM4_ENGINE_INLINE void square(const Planes in, Planes out) {
+        linear<SQ>(in, out);
+    }
+
+    // Schoolbook product of two field elements followed by reduction of x^14..x^8.
+    static SM4_ENGINE_INLINE void multiply(const Planes a, const Planes b, Planes out) {
+        uint64_t c[15] = {};
+#pragma GCC unroll 8
+        for (int i = 0; i < 8; i++) {
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++) {
+                c[i + j] ^= a[i] & b[j];
+            }
+        }
+#pragma GCC unroll 8
+        for (int k = 14; k >= 8; k--) {
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; j++) {
+                if ((detail::FIELD_POLY >> j) & 1) {
+                    c[k - 8 + j] ^= c[k];
+                }
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            out[i] = c[i];
+        }
+    }
+
+    // x^254 through x^(2^k - 1): 7 squarings and 6 multiplications.
+    static void invert(const Planes x, Planes out) {
+        uint64_t acc[8], sq[8];
+        for (int i = 0; i < 8; i++) {
+            acc[i] = x[i];
+        }
+        for (int step = 0; step < 6; step++) {
+            square(acc, sq);
+            multiply(sq, x, acc);
+        }
+        square(acc, out);
+    }
+
+    static SM4_ENGINE_INLINE void sbox_planes(Planes p) {
+        uint64_t a[8], inv[8];
+        linear<A>(p, a);
+        for (int i = 0; i < 8; i++) {
+            a[i] ^= 0 - static_cast<uint64_t>((detail::AFFINE_CONST >> i) & 1);
+        }
+        invert(a, inv);
+        linear<A>(inv, p);
+        for (int i = 0; i < 8; i++) {
+            p[i] ^= 0 - static_cast<uint64_t>((detail::AFFINE_CONST >> i) & 1);
+        }
+    }
+
+    // 8x8 bit transpose inside every word: bit j of byte i <-> bit i of byte j.
+    static SM4_ENGINE_INLINE void transpose_bits(uint64_t w[8]) {
+        for (int i = 0; i < 8; i++) {
+            uint64_t x = w[i], t;
+            t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+            x ^= t ^ (t << 7);
+            t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+            x ^= t ^ (t << 14);
+            t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+            x ^= t ^ (t << 28);
+            w[i] = x;
+        }
+    }
+
+    // 8x8 byte transpose across the words: byte j of word i <-> byte i of word j.
+    static SM4_ENGINE_INLINE void transpose_bytes(uint64_t w[8]) {
+        const uint64_t masks[3] = {0x00000000FFFFFFFFULL, 0x0000FFFF0000FFFFULL, 0x00FF00FF00FF00FFULL};
+        for (int s = 0; s < 3; s++) {
+            const int d = 4 >> s;
+            const uint64_t m = masks[s];
+            for (int i = 0; i < 8; i++) {
+                if (i & d) {
+                    continue;
+                }
+                uint64_t a = w[i], b = w[i + d];
+                w[i] = (a & m) | ((b & m) << (8 * d));
+                w[i + d] = ((a >> (8 * d)) & m) | (b & ~m);
+            }
+        }
+    }
+
+    // 64 bytes -> 8 planes (plane p, bit i = bit p of byte i) and back.
+    static SM4_ENGINE_INLINE void sub_planes(uint64_t w[8]) {
+        transpose_bits(w);
+        transpose_bytes(w);
+        sbox_planes(w);
+        transpose_bytes(w);
+        transpose_bits(w);
+    }
+
+    // Byte-wise S-box on 64 bytes; the byte order inside the words does not matter.
+    static SM4_ENGINE_INLINE void sub_bytes(uint8_t bytes[64]) {
+        uint64_t planes[8];
+        std::memcpy(planes, bytes, 64);
+        sub_planes(planes);
+        std::memcpy(bytes, planes, 64);
+    }
+
+    static SM4_ENGINE_INLINE Vec round_t(Vec x) {
+        uint64_t planes[8];
+        std::memcpy(planes, x.w, 64);
+        sub_planes(planes);
+        std::memcpy(x.w, planes, 64);
+        for (int i = 0; i < 16; i++) {
+            x.w[i] = linear_l(x.w[i]);
+        }
+        return x;
+    }
+
+    static SM4_ENGINE_INLINE void load(const uint8_t* src, Vec x[4]) {
+        for (int b = 0; b < 16; b++) {
+            for (int k = 0; k < 4; k++) {
+                x[k].w[b] = load_be32(src + 16 * b + 4 * k);
+            }
+        }
+    }
+
+    static SM4_ENGINE_INLINE void store(const Vec x[4], uint8_t* dst) {
+        for (int b = 0; b < 16; b++) {
+            for (int k = 0; k < 4; k++) {
+                store_be32(x[k].w[b], dst + 16 * b + 4 * k);
+            }
+        }
+    }
+};
+
+SM4_ENGINE_INLINE BitslicedSBox::Vec operator^(BitslicedSBox::Vec a, const BitslicedSBox::Vec& b) {
+    for (int i = 0; i < 16; i++) {
+        a.w[i] ^= b.w[i];
+    }
+    return a;
+}
+
+template <typename SBox, size_t Width>
+class SM4Engine {
+public:
+    static_assert(Width == 1 || Width == 4 || Width == 8 || Width == 16, "SM4Engine width must be 1, 4, 8 or 16");
+
+    using Vec = typename SBox::Vec;
+    static constexpr size_t WIDTH = Width;
+    static constexpr size_t LANES = SBox::LANES;
+    static constexpr size_t GROUPS = Width > LANES ? Width / LANES : 1;
+    static constexpr size_t STEP_BYTES = Width * 16;
+
+    static bool is_supported() {
+        return SBox::is_supported();
+    }
+
+    // Exactly Width blocks. Streaming writes dst with non-temporal stores (16-byte
+    // aligned dst, vector strategies at Width >= LANES only); the caller fences.
+    template <bool Streaming = false>
+    static void crypt_step(const uint32_t rk[32], const uint8_t* src, uint8_t* dst) {
+        auto keys = [rk](size_t r) { return SBox::broadcast(rk[r]); };
+        if constexpr (Width < LANES) {
+            static_assert(!Streaming, "a padded step goes through a scratch buffer");
+            uint8_t scratch[LANES * 16] = {};
+            std::memcpy(scratch, src, STEP_BYTES);
+            crypt_groups<false>(keys, scratch, scratch);
+            std::memcpy(dst, scratch, STEP_BYTES);
+        } else {
+            crypt_groups<Streaming>(keys, src, dst);
+        }
+    }
+
+    // Any number of blocks; a partial final step goes through a scratch buffer.
+    static void crypt_blocks(const uint32_t rk[32], const uint8_t* src, uint8_t* dst, size_t num_blocks) {
+        size_t i = 0;
+        for (; i + Width <= num_blocks; i += Width) {
+            crypt_step(rk, src + i * 16, dst + i * 16);
+        }
+        if (i < num_blocks) {
+            uint8_t scratch[STEP_BYTES] = {};
+            size_t tail = (num_blocks - i) * 16;
+            std::memcpy(scratch, src + i * 16, tail);
+            crypt_step(rk, scratch, scratch);
+            std::memcpy(dst + i * 16, scratch, tail);
+        }
+    }
+
+    static void encrypt_blocks(const SM4Key& key, const uint8_t* src, uint8_t* dst, size_t num_blocks) {
+        crypt_blocks(key.enc, src, dst, num_blocks);
+    }
+
+    static void decrypt_blocks(const SM4Key& key, const uint8_t* src, uint8_t* dst, size_t num_blocks) {
+        crypt_blocks(key.dec, src, dst, num_blocks);
+    }
+
+    // One block per lane, lane l under the round keys rk[l], for batching requests that
+    // arrive under different keys. Needs a strategy with gather() and Width == LANES.
+    static void crypt_lanes(const uint32_t* const rk[Width], const uint8_t* src, uint8_t* dst) {
+        static_assert(Width == LANES, "one round key schedule per lane");
+        crypt_groups<false>([rk](size_t r) { return SBox::gather(rk, r); }, src, dst);
+    }
+
+private:
+    using State = Vec[GROUPS][4];
+
+    // X[g][R % 4] is the oldest word of group g before round R and receives its output.
+    template <size_t R, typename Keys>
+    static SM4_ENGINE_INLINE void round(const Keys& keys, State& X) {
+        const Vec k = keys(R);
+        for (size_t g = 0; g < GROUPS; g++) {
+            X[g][R % 4] = X[g][R % 4] ^ SBox::round_t(X[g][(R + 1) % 4] ^ X[g][(R + 2) % 4] ^ X[g][(R + 3) % 4] ^ k);
+        }
+    }
+
+    template <typename Keys, size_t... R>
+    static SM4_ENGINE_INLINE void rounds(const Keys& keys, State& X, std::index_sequence<R...>) {
+        (round<R>(keys, X), ...);
+    }
+
+    template <bool Streaming, typename Keys>
+    static void crypt_groups(const Keys& keys, const uint8_t* src, uint8_t* dst) {
+        State X;
+        for (size_t g = 0; g < GROUPS; g++) {
+            SBox::load(src + g * LANES * 16, X[g]);
+        }
+        rounds(keys, X, std::make_index_sequence<32>());
+        // After round 31 the slots hold X32..X35; the output is X35, X34, X33, X32.
+        for (size_t g = 0; g < GROUPS; g++) {
+            const Vec out[4] = {X[g][3], X[g][2], X[g][1], X[g][0]};
+            if constexpr (Streaming) {
+                SBox::template store<true>(out, dst + g * LANES * 16);
+            } else {
+                SBox::store(out, dst + g * LANES * 16);
+            }
+        }
+    }
+};
+
+#undef SM4_ENGINE_INLINE
+
+}  // namespace sm4_engine
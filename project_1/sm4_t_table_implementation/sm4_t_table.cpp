@@ -6,20 +6,13 @@
 #include <cassert>
 #include <cstdint>
 
+#include "../sm4_engine_implementation/sm4_engine.h"
+
+// T(x) through four combined S-box + L tables, one block at a time: the engine's
+// TableSBox strategy, whose tables are generated at compile time from the S-box.
 class SM4_Optimized {
 private:
-    static const uint32_t T0[256];
-    static const uint32_t T1[256];
-    static const uint32_t T2[256];
-    static const uint32_t T3[256];
-    
-    static const uint32_t T0_KEY[256];
-    static const uint32_t T1_KEY[256];
-    static const uint32_t T2_KEY[256];
-    static const uint32_t T3_KEY[256];
-    
-    static const uint32_t FK[4];
-    static const uint32_t CK[32];
+    using Engine = sm4_engine::SM4Engine<sm4_engine::TableSBox, 1>;
     
     static std::vector<uint8_t> hex_to_bytes(const std::string& hex) {
         std::vector<uint8_t> bytes;
@@ -38,86 +31,16 @@ private:
         return ss.str();
     }
     
-    static std::vector<uint8_t> uint32_to_bytes(uint32_t value) {
-        return {
-            static_cast<uint8_t>((value >> 24) & 0xFF),
-            static_cast<uint8_t>((value >> 16) & 0xFF),
-            static_cast<uint8_t>((value >> 8) & 0xFF),
-            static_cast<uint8_t>(value & 0xFF)
-        };
-    }
-    
-    static uint32_t bytes_to_uint32(const std::vector<uint8_t>& bytes, size_t offset) {
-        return (static_cast<uint32_t>(bytes[offset]) << 24) |
-               (static_cast<uint32_t>(bytes[offset + 1]) << 16) |
-               (static_cast<uint32_t>(bytes[offset + 2]) << 8) |
-               static_cast<uint32_t>(bytes[offset + 3]);
-    }
-    
-    // Optimized T transformation using T-tables
-    static uint32_t T_optimized(uint32_t X) {
-        uint8_t b0 = (X >> 24) & 0xFF;
-        uint8_t b1 = (X >> 16) & 0xFF;
-        uint8_t b2 = (X >> 8) & 0xFF;
-        uint8_t b3 = X & 0xFF;
-        
-        return T0[b0] ^ T1[b1] ^ T2[b2] ^ T3[b3];
-    }
-    
-    // Optimized T' transformation using T-tables for key schedule
-    static uint32_t T_prime_optimized(uint32_t X) {
-        uint8_t b0 = (X >> 24) & 0xFF;
-        uint8_t b1 = (X >> 16) & 0xFF;
-        uint8_t b2 = (X >> 8) & 0xFF;
-        uint8_t b3 = X & 0xFF;
-        
-        return T0_KEY[b0] ^ T1_KEY[b1] ^ T2_KEY[b2] ^ T3_KEY[b3];
-    }
-    
-    static std::vector<uint32_t> key_schedule(const std::vector<uint8_t>& key) {
-        uint32_t MK[4];
-        for (int i = 0; i < 4; i++) {
-            MK[i] = bytes_to_uint32(key, i * 4);
-        }
-        
-        uint32_t K[36];
-        for (int i = 0; i < 4; i++) {
-            K[i] = MK[i] ^ FK[i];
-        }
-        
-        std::vector<uint32_t> round_keys(32);
-        for (int i = 0; i < 32; i++) {
-            K[i + 4] = K[i] ^ T_prime_optimized(K[i + 1] ^ K[i + 2] ^ K[i + 3] ^ CK[i]);
-            round_keys[i] = K[i + 4];
-        }
-        
+    static sm4_engine::SM4Key key_schedule(const std::vector<uint8_t>& key) {
+        sm4_engine::SM4Key round_keys;
+        sm4_engine::expand_key(key.data(), round_keys);
         return round_keys;
     }
     
-    static std::vector<uint8_t> encrypt_block(const std::vector<uint8_t>& plaintext, 
-                                             const std::vector<uint32_t>& round_keys) {
-        uint32_t X[36];
-        for (int i = 0; i < 4; i++) {
-            X[i] = bytes_to_uint32(plaintext, i * 4);
-        }
-        
-        for (int i = 0; i < 32; i++) {
-            X[i + 4] = X[i] ^ T_optimized(X[i + 1] ^ X[i + 2] ^ X[i + 3] ^ round_keys[i]);
-        }
-        
-        std::vector<uint8_t> ciphertext;
-        for (int i = 3; i >= 0; i--) {
-            auto bytes = uint32_to_bytes(X[32 + i]);
-            ciphertext.insert(ciphertext.end(), bytes.begin(), bytes.end());
-        }
-        
-        return ciphertext;
-    }
-    
-    static std::vector<uint8_t> decrypt_block(const std::vector<uint8_t>& ciphertext, 
-                                             const std::vector<uint32_t>& round_keys) {
-        std::vector<uint32_t> reverse_keys(round_keys.rbegin(), round_keys.rend());
-        return encrypt_block(ciphertext, reverse_keys);
+    static std::string crypt_hex(const std::string& in_hex, const uint32_t rk[32]) {
+        auto data = hex_to_bytes(in_hex);
+        Engine::crypt_blocks(rk, data.data(), data.data(), data.size() / 16);
+        return bytes_to_hex(data);
     }
 
 public:
@@ -125,614 +48,31 @@ public:
         assert(plain_hex.length() == 32);
         assert(key_hex.length() == 32);
         
-        auto plaintext = hex_to_bytes(plain_hex);
-        auto key = hex_to_bytes(key_hex);
-        auto round_keys = key_schedule(key);
-        auto ciphertext = encrypt_block(plaintext, round_keys);
-        
-        return bytes_to_hex(ciphertext);
+        return crypt_hex(plain_hex, key_schedule(hex_to_bytes(key_hex)).enc);
     }
     
     static std::string decrypt_block_hex(const std::string& cipher_hex, const std::string& key_hex) {
         assert(cipher_hex.length() == 32);
         assert(key_hex.length() == 32);
         
-        auto ciphertext = hex_to_bytes(cipher_hex);
-        auto key = hex_to_bytes(key_hex);
-        auto round_keys = key_schedule(key);
-        auto plaintext = decrypt_block(ciphertext, round_keys);
-        
-        return bytes_to_hex(plaintext);
+        return crypt_hex(cipher_hex, key_schedule(hex_to_bytes(key_hex)).dec);
     }
     
     static std::string encrypt_hex(const std::string& plain_hex, const std::string& key_hex) {
         assert(plain_hex.length() % 32 == 0);
         assert(key_hex.length() == 32);
         
-        auto key = hex_to_bytes(key_hex);
-        auto round_keys = key_schedule(key);
-        
-        std::string result;
-        for (size_t i = 0; i < plain_hex.length(); i += 32) {
-            std::string block = plain_hex.substr(i, 32);
-            auto plaintext_block = hex_to_bytes(block);
-            auto ciphertext_block = encrypt_block(plaintext_block, round_keys);
-            result += bytes_to_hex(ciphertext_block);
-        }
-        
-        return result;
+        return crypt_hex(plain_hex, key_schedule(hex_to_bytes(key_hex)).enc);
     }
     
     static std::string decrypt_hex(const std::string& cipher_hex, const std::string& key_hex) {
         assert(cipher_hex.length() % 32 == 0);
         assert(key_hex.length() == 32);
         
-        auto key = hex_to_bytes(key_hex);
-        auto round_keys = key_schedule(key);
-        
-        std::string result;
-        for (size_t i = 0; i < cipher_hex.length(); i += 32) {
-            std::string block = cipher_hex.substr(i, 32);
-            auto ciphertext_block = hex_to_bytes(block);
-            auto plaintext_block = decrypt_block(ciphertext_block, round_keys);
-            result += bytes_to_hex(plaintext_block);
-        }
-        
-        return result;
+        return crypt_hex(cipher_hex, key_schedule(hex_to_bytes(key_hex)).dec);
     }
 };
 
-const uint32_t SM4_Optimized::T0[256] = {
-    0x8ed55b5b,    0xd0924242,    0x4deaa7a7,    0x06fdfbfb,
-    0xfccf3333,    0x65e28787,    0xc93df4f4,    0x6bb5dede,
-    0x4e165858,    0x6eb4dada,    0x44145050,    0xcac10b0b,
-    0x8828a0a0,    0x17f8efef,    0x9c2cb0b0,    0x11051414,
-    0x872bacac,    0xfb669d9d,    0xf2986a6a,    0xae77d9d9,
-    0x822aa8a8,    0x46bcfafa,    0x14041010,    0xcfc00f0f,
-    0x02a8aaaa,    0x54451111,    0x5f134c4c,    0xbe269898,
-    0x6d482525,    0x9e841a1a,    0x1e061818,    0xfd9b6666,
-    0xec9e7272,    0x4a430909,    0x10514141,    0x24f7d3d3,
-    0xd5934646,    0x53ecbfbf,    0xf89a6262,    0x927be9e9,
-    0xff33cccc,    0x04555151,    0x270b2c2c,    0x4f420d0d,
-    0x59eeb7b7,    0xf3cc3f3f,    0x1caeb2b2,    0xea638989,
-    0x74e79393,    0x7fb1cece,    0x6c1c7070,    0x0daba6a6,
-    0xedca2727,    0x28082020,    0x48eba3a3,    0xc1975656,
-    0x80820202,    0xa3dc7f7f,    0xc4965252,    0x12f9ebeb,
-    0xa174d5d5,    0xb38d3e3e,    0xc33ffcfc,    0x3ea49a9a,
-    0x5b461d1d,    0x1b071c1c,    0x3ba59e9e,    0x0cfff3f3,
-    0x3ff0cfcf,    0xbf72cdcd,    0x4b175c5c,    0x52b8eaea,
-    0x8f810e0e,    0x3d586565,    0xcc3cf0f0,    0x7d196464,
-    0x7ee59b9b,    0x91871616,    0x734e3d3d,    0x08aaa2a2,
-    0xc869a1a1,    0xc76aadad,    0x85830606,    0x7ab0caca,
-    0xb570c5c5,    0xf4659191,    0xb2d96b6b,    0xa7892e2e,
-    0x18fbe3e3,    0x47e8afaf,    0x330f3c3c,    0x674a2d2d,
-    0xb071c1c1,    0x0e575959,    0xe99f7676,    0xe135d4d4,
-    0x661e7878,    0xb4249090,    0x360e3838,    0x265f7979,
-    0xef628d8d,    0x38596161,    0x95d24747,    0x2aa08a8a,
-    0xb1259494,    0xaa228888,    0x8c7df1f1,    0xd73becec,
-    0x05010404,    0xa5218484,    0x9879e1e1,    0x9b851e1e,
-    0x84d75353,    0x00000000,    0x5e471919,    0x0b565d5d,
-    0xe39d7e7e,    0x9fd04f4f,    0xbb279c9c,    0x1a534949,
-    0x7c4d3131,    0xee36d8d8,    0x0a020808,    0x7be49f9f,
-    0x20a28282,    0xd4c71313,    0xe8cb2323,    0xe69c7a7a,
-    0x42e9abab,    0x43bdfefe,    0xa2882a2a,    0x9ad14b4b,
-    0x40410101,    0xdbc41f1f,    0xd838e0e0,    0x61b7d6d6,
-    0x2fa18e8e,    0x2bf4dfdf,    0x3af1cbcb,    0xf6cd3b3b,
-    0x1dfae7e7,    0xe5608585,    0x41155454,    0x25a38686,
-    0x60e38383,    0x16acbaba,    0x295c7575,    0x34a69292,
-    0xf7996e6e,    0xe434d0d0,    0x721a6868,    0x01545555,
-    0x19afb6b6,    0xdf914e4e,    0xfa32c8c8,    0xf030c0c0,
-    0x21f6d7d7,    0xbc8e3232,    0x75b3c6c6,    0x6fe08f8f,
-    0x691d7474,    0x2ef5dbdb,    0x6ae18b8b,    0x962eb8b8,
-    0x8a800a0a,    0xfe679999,    0xe2c92b2b,    0xe0618181,
-    0xc0c30303,    0x8d29a4a4,    0xaf238c8c,    0x07a9aeae,
-    0x390d3434,    0x1f524d4d,    0x764f3939,    0xd36ebdbd,
-    0x81d65757,    0xb7d86f6f,    0xeb37dcdc,    0x51441515,
-    0xa6dd7b7b,    0x09fef7f7,    0xb68c3a3a,    0x932fbcbc,
-    0x0f030c0c,    0x03fcffff,    0xc26ba9a9,    0xba73c9c9,
-    0xd96cb5b5,    0xdc6db1b1,    0x375a6d6d,    0x15504545,
-    0xb98f3636,    0x771b6c6c,    0x13adbebe,    0xda904a4a,
-    0x57b9eeee,    0xa9de7777,    0x4cbef2f2,    0x837efdfd,
-    0x55114444,    0xbdda6767,    0x2c5d7171,    0x45400505,
-    0x631f7c7c,    0x50104040,    0x325b6969,    0xb8db6363,
-    0x220a2828,    0xc5c20707,    0xf531c4c4,    0xa88a2222,
-    0x31a79696,    0xf9ce3737,    0x977aeded,    0x49bff6f6,
-    0x992db4b4,    0xa475d1d1,    0x90d34343,    0x5a124848,
-    0x58bae2e2,    0x71e69797,    0x64b6d2d2,    0x70b2c2c2,
-    0xad8b2626,    0xcd68a5a5,    0xcb955e5e,    0x624b2929,
-    0x3c0c3030,    0xce945a5a,    0xab76dddd,    0x867ff9f9,
-    0xf1649595,    0x5dbbe6e6,    0x35f2c7c7,    0x2d092424,
-    0xd1c61717,    0xd66fb9b9,    0xdec51b1b,    0x94861212,
-    0x78186060,    0x30f3c3c3,    0x897cf5f5,    0x5cefb3b3,
-    0xd23ae8e8,    0xacdf7373,    0x794c3535,    0xa0208080,
-    0x9d78e5e5,    0x56edbbbb,    0x235e7d7d,    0xc63ef8f8,
-    0x8bd45f5f,    0xe7c82f2f,    0xdd39e4e4,    0x68492121
-};
-
-const uint32_t SM4_Optimized::T1[256] = {
-    0x5b8ed55b,    0x42d09242,    0xa74deaa7,    0xfb06fdfb,
-    0x33fccf33,    0x8765e287,    0xf4c93df4,    0xde6bb5de,
-    0x584e1658,    0xda6eb4da,    0x50441450,    0x0bcac10b,
-    0xa08828a0,    0xef17f8ef,    0xb09c2cb0,    0x14110514,
-    0xac872bac,    0x9dfb669d,    0x6af2986a,    0xd9ae77d9,
-    0xa8822aa8,    0xfa46bcfa,    0x10140410,    0x0fcfc00f,
-    0xaa02a8aa,    0x11544511,    0x4c5f134c,    0x98be2698,
-    0x256d4825,    0x1a9e841a,    0x181e0618,    0x66fd9b66,
-    0x72ec9e72,    0x094a4309,    0x41105141,    0xd324f7d3,
-    0x46d59346,    0xbf53ecbf,    0x62f89a62,    0xe9927be9,
-    0xccff33cc,    0x51045551,    0x2c270b2c,    0x0d4f420d,
-    0xb759eeb7,    0x3ff3cc3f,    0xb21caeb2,    0x89ea6389,
-    0x9374e793,    0xce7fb1ce,    0x706c1c70,    0xa60daba6,
-    0x27edca27,    0x20280820,    0xa348eba3,    0x56c19756,
-    0x02808202,    0x7fa3dc7f,    0x52c49652,    0xeb12f9eb,
-    0xd5a174d5,    0x3eb38d3e,    0xfcc33ffc,    0x9a3ea49a,
-    0x1d5b461d,    0x1c1b071c,    0x9e3ba59e,    0xf30cfff3,
-    0xcf3ff0cf,    0xcdbf72cd,    0x5c4b175c,    0xea52b8ea,
-    0x0e8f810e,    0x653d5865,    0xf0cc3cf0,    0x647d1964,
-    0x9b7ee59b,    0x16918716,    0x3d734e3d,    0xa208aaa2,
-    0xa1c869a1,    0xadc76aad,    0x06858306,    0xca7ab0ca,
-    0xc5b570c5,    0x91f46591,    0x6bb2d96b,    0x2ea7892e,
-    0xe318fbe3,    0xaf47e8af,    0x3c330f3c,    0x2d674a2d,
-    0xc1b071c1,    0x590e5759,    0x76e99f76,    0xd4e135d4,
-    0x78661e78,    0x90b42490,    0x38360e38,    0x79265f79,
-    0x8def628d,    0x61385961,    0x4795d247,    0x8a2aa08a,
-    0x94b12594,    0x88aa2288,    0xf18c7df1,    0xecd73bec,
-    0x04050104,    0x84a52184,    0xe19879e1,    0x1e9b851e,
-    0x5384d753,    0x00000000,    0x195e4719,    0x5d0b565d,
-    0x7ee39d7e,    0x4f9fd04f,    0x9cbb279c,    0x491a5349,
-    0x317c4d31,    0xd8ee36d8,    0x080a0208,    0x9f7be49f,
-    0x8220a282,    0x13d4c713,    0x23e8cb23,    0x7ae69c7a,
-    0xab42e9ab,    0xfe43bdfe,    0x2aa2882a,    0x4b9ad14b,
-    0x01404101,    0x1fdbc41f,    0xe0d838e0,    0xd661b7d6,
-    0x8e2fa18e,    0xdf2bf4df,    0xcb3af1cb,    0x3bf6cd3b,
-    0xe71dfae7,    0x85e56085,    0x54411554,    0x8625a386,
-    0x8360e383,    0xba16acba,    0x75295c75,    0x9234a692,
-    0x6ef7996e,    0xd0e434d0,    0x68721a68,    0x55015455,
-    0xb619afb6,    0x4edf914e,    0xc8fa32c8,    0xc0f030c0,
-    0xd721f6d7,    0x32bc8e32,    0xc675b3c6,    0x8f6fe08f,
-    0x74691d74,    0xdb2ef5db,    0x8b6ae18b,    0xb8962eb8,
-    0x0a8a800a,    0x99fe6799,    0x2be2c92b,    0x81e06181,
-    0x03c0c303,    0xa48d29a4,    0x8caf238c,    0xae07a9ae,
-    0x34390d34,    0x4d1f524d,    0x39764f39,    0xbdd36ebd,
-    0x5781d657,    0x6fb7d86f,    0xdceb37dc,    0x15514415,
-    0x7ba6dd7b,    0xf709fef7,    0x3ab68c3a,    0xbc932fbc,
-    0x0c0f030c,    0xff03fcff,    0xa9c26ba9,    0xc9ba73c9,
-    0xb5d96cb5,    0xb1dc6db1,    0x6d375a6d,    0x45155045,
-    0x36b98f36,    0x6c771b6c,    0xbe13adbe,    0x4ada904a,
-    0xee57b9ee,    0x77a9de77,    0xf24cbef2,    0xfd837efd,
-    0x44551144,    0x67bdda67,    0x712c5d71,    0x05454005,
-    0x7c631f7c,    0x40501040,    0x69325b69,    0x63b8db63,
-    0x28220a28,    0x07c5c207,    0xc4f531c4,    0x22a88a22,
-    0x9631a796,    0x37f9ce37,    0xed977aed,    0xf649bff6,
-    0xb4992db4,    0xd1a475d1,    0x4390d343,    0x485a1248,
-    0xe258bae2,    0x9771e697,    0xd264b6d2,    0xc270b2c2,
-    0x26ad8b26,    0xa5cd68a5,    0x5ecb955e,    0x29624b29,
-    0x303c0c30,    0x5ace945a,    0xddab76dd,    0xf9867ff9,
-    0x95f16495,    0xe65dbbe6,    0xc735f2c7,    0x242d0924,
-    0x17d1c617,    0xb9d66fb9,    0x1bdec51b,    0x12948612,
-    0x60781860,    0xc330f3c3,    0xf5897cf5,    0xb35cefb3,
-    0xe8d23ae8,    0x73acdf73,    0x35794c35,    0x80a02080,
-    0xe59d78e5,    0xbb56edbb,    0x7d235e7d,    0xf8c63ef8,
-    0x5f8bd45f,    0x2fe7c82f,    0xe4dd39e4,    0x21684921
-};
-
-const uint32_t SM4_Optimized::T2[256] = {
-    0x5b5b8ed5,    0x4242d092,    0xa7a74dea,    0xfbfb06fd,
-    0x3333fccf,    0x878765e2,    0xf4f4c93d,    0xdede6bb5,
-    0x58584e16,    0xdada6eb4,    0x50504414,    0x0b0bcac1,
-    0xa0a08828,    0xefef17f8,    0xb0b09c2c,    0x14141105,
-    0xacac872b,    0x9d9dfb66,    0x6a6af298,    0xd9d9ae77,
-    0xa8a8822a,    0xfafa46bc,    0x10101404,    0x0f0fcfc0,
-    0xaaaa02a8,    0x11115445,    0x4c4c5f13,    0x9898be26,
-    0x25256d48,    0x1a1a9e84,    0x18181e06,    0x6666fd9b,
-    0x7272ec9e,    0x09094a43,    0x41411051,    0xd3d324f7,
-    0x4646d593,    0xbfbf53ec,    0x6262f89a,    0xe9e9927b,
-    0xccccff33,    0x51510455,    0x2c2c270b,    0x0d0d4f42,
-    0xb7b759ee,    0x3f3ff3cc,    0xb2b21cae,    0x8989ea63,
-    0x939374e7,    0xcece7fb1,    0x70706c1c,    0xa6a60dab,
-    0x2727edca,    0x20202808,    0xa3a348eb,    0x5656c197,
-    0x02028082,    0x7f7fa3dc,    0x5252c496,    0xebeb12f9,
-    0xd5d5a174,    0x3e3eb38d,    0xfcfcc33f,    0x9a9a3ea4,
-    0x1d1d5b46,    0x1c1c1b07,    0x9e9e3ba5,    0xf3f30cff,
-    0xcfcf3ff0,    0xcdcdbf72,    0x5c5c4b17,    0xeaea52b8,
-    0x0e0e8f81,    0x65653d58,    0xf0f0cc3c,    0x64647d19,
-    0x9b9b7ee5,    0x16169187,    0x3d3d734e,    0xa2a208aa,
-    0xa1a1c869,    0xadadc76a,    0x06068583,    0xcaca7ab0,
-    0xc5c5b570,    0x9191f465,    0x6b6bb2d9,    0x2e2ea789,
-    0xe3e318fb,    0xafaf47e8,    0x3c3c330f,    0x2d2d674a,
-    0xc1c1b071,    0x59590e57,    0x7676e99f,    0xd4d4e135,
-    0x7878661e,    0x9090b424,    0x3838360e,    0x7979265f,
-    0x8d8def62,    0x61613859,    0x474795d2,    0x8a8a2aa0,
-    0x9494b125,    0x8888aa22,    0xf1f18c7d,    0xececd73b,
-    0x04040501,    0x8484a521,    0xe1e19879,    0x1e1e9b85,
-    0x535384d7,    0x00000000,    0x19195e47,    0x5d5d0b56,
-    0x7e7ee39d,    0x4f4f9fd0,    0x9c9cbb27,    0x49491a53,
-    0x31317c4d,    0xd8d8ee36,    0x08080a02,    0x9f9f7be4,
-    0x828220a2,    0x1313d4c7,    0x2323e8cb,    0x7a7ae69c,
-    0xabab42e9,    0xfefe43bd,    0x2a2aa288,    0x4b4b9ad1,
-    0x01014041,    0x1f1fdbc4,    0xe0e0d838,    0xd6d661b7,
-    0x8e8e2fa1,    0xdfdf2bf4,    0xcbcb3af1,    0x3b3bf6cd,
-    0xe7e71dfa,    0x8585e560,    0x54544115,    0x868625a3,
-    0x838360e3,    0xbaba16ac,    0x7575295c,    0x929234a6,
-    0x6e6ef799,    0xd0d0e434,    0x6868721a,    0x55550154,
-    0xb6b619af,    0x4e4edf91,    0xc8c8fa32,    0xc0c0f030,
-    0xd7d721f6,    0x3232bc8e,    0xc6c675b3,    0x8f8f6fe0,
-    0x7474691d,    0xdbdb2ef5,    0x8b8b6ae1,    0xb8b8962e,
-    0x0a0a8a80,    0x9999fe67,    0x2b2be2c9,    0x8181e061,
-    0x0303c0c3,    0xa4a48d29,    0x8c8caf23,    0xaeae07a9,
-    0x3434390d,    0x4d4d1f52,    0x3939764f,    0xbdbdd36e,
-    0x575781d6,    0x6f6fb7d8,    0xdcdceb37,    0x15155144,
-    0x7b7ba6dd,    0xf7f709fe,    0x3a3ab68c,    0xbcbc932f,
-    0x0c0c0f03,    0xffff03fc,    0xa9a9c26b,    0xc9c9ba73,
-    0xb5b5d96c,    0xb1b1dc6d,    0x6d6d375a,    0x45451550,
-    0x3636b98f,    0x6c6c771b,    0xbebe13ad,    0x4a4ada90,
-    0xeeee57b9,    0x7777a9de,    0xf2f24cbe,    0xfdfd837e,
-    0x44445511,    0x6767bdda,    0x71712c5d,    0x05054540,
-    0x7c7c631f,    0x40405010,    0x6969325b,    0x6363b8db,
-    0x2828220a,    0x0707c5c2,    0xc4c4f531,    0x2222a88a,
-    0x969631a7,    0x3737f9ce,    0xeded977a,    0xf6f649bf,
-    0xb4b4992d,    0xd1d1a475,    0x434390d3,    0x48485a12,
-    0xe2e258ba,    0x979771e6,    0xd2d264b6,    0xc2c270b2,
-    0x2626ad8b,    0xa5a5cd68,    0x5e5ecb95,    0x2929624b,
-    0x30303c0c,    0x5a5ace94,    0xddddab76,    0xf9f9867f,
-    0x9595f164,    0xe6e65dbb,    0xc7c735f2,    0x24242d09,
-    0x1717d1c6,    0xb9b9d66f,    0x1b1bdec5,    0x12129486,
-    0x60607818,    0xc3c330f3,    0xf5f5897c,    0xb3b35cef,
-    0xe8e8d23a,    0x7373acdf,    0x3535794c,    0x8080a020,
-    0xe5e59d78,    0xbbbb56ed,    0x7d7d235e,    0xf8f8c63e,
-    0x5f5f8bd4,    0x2f2fe7c8,    0xe4e4dd39,    0x21216849
-};
-
-const uint32_t SM4_Optimized::T3[256] = {
-    0xd55b5b8e,    0x924242d0,    0xeaa7a74d,    0xfdfbfb06,
-    0xcf3333fc,    0xe2878765,    0x3df4f4c9,    0xb5dede6b,
-    0x1658584e,    0xb4dada6e,    0x14505044,    0xc10b0bca,
-    0x28a0a088,    0xf8efef17,    0x2cb0b09c,    0x05141411,
-    0x2bacac87,    0x669d9dfb,    0x986a6af2,    0x77d9d9ae,
-    0x2aa8a882,    0xbcfafa46,    0x04101014,    0xc00f0fcf,
-    0xa8aaaa02,    0x45111154,    0x134c4c5f,    0x269898be,
-    0x4825256d,    0x841a1a9e,    0x0618181e,    0x9b6666fd,
-    0x9e7272ec,    0x4309094a,    0x51414110,    0xf7d3d324,
-    0x934646d5,    0xecbfbf53,    0x9a6262f8,    0x7be9e992,
-    0x33ccccff,    0x55515104,    0x0b2c2c27,    0x420d0d4f,
-    0xeeb7b759,    0xcc3f3ff3,    0xaeb2b21c,    0x638989ea,
-    0xe7939374,    0xb1cece7f,    0x1c70706c,    0xaba6a60d,
-    0xca2727ed,    0x08202028,    0xeba3a348,    0x975656c1,
-    0x82020280,    0xdc7f7fa3,    0x965252c4,    0xf9ebeb12,
-    0x74d5d5a1,    0x8d3e3eb3,    0x3ffcfcc3,    0xa49a9a3e,
-    0x461d1d5b,    0x071c1c1b,    0xa59e9e3b,    0xfff3f30c,
-    0xf0cfcf3f,    0x72cdcdbf,    0x175c5c4b,    0xb8eaea52,
-    0x810e0e8f,    0x5865653d,    0x3cf0f0cc,    0x1964647d,
-    0xe59b9b7e,    0x87161691,    0x4e3d3d73,    0xaaa2a208,
-    0x69a1a1c8,    0x6aadadc7,    0x83060685,    0xb0caca7a,
-    0x70c5c5b5,    0x659191f4,    0xd96b6bb2,    0x892e2ea7,
-    0xfbe3e318,    0xe8afaf47,    0x0f3c3c33,    0x4a2d2d67,
-    0x71c1c1b0,    0x5759590e,    0x9f7676e9,    0x35d4d4e1,
-    0x1e787866,    0x249090b4,    0x0e383836,    0x5f797926,
-    0x628d8def,    0x59616138,    0xd2474795,    0xa08a8a2a,
-    0x259494b1,    0x228888aa,    0x7df1f18c,    0x3bececd7,
-    0x01040405,    0x218484a5,    0x79e1e198,    0x851e1e9b,
-    0xd7535384,    0x00000000,    0x4719195e,    0x565d5d0b,
-    0x9d7e7ee3,    0xd04f4f9f,    0x279c9cbb,    0x5349491a,
-    0x4d31317c,    0x36d8d8ee,    0x0208080a,    0xe49f9f7b,
-    0xa2828220,    0xc71313d4,    0xcb2323e8,    0x9c7a7ae6,
-    0xe9abab42,    0xbdfefe43,    0x882a2aa2,    0xd14b4b9a,
-    0x41010140,    0xc41f1fdb,    0x38e0e0d8,    0xb7d6d661,
-    0xa18e8e2f,    0xf4dfdf2b,    0xf1cbcb3a,    0xcd3b3bf6,
-    0xfae7e71d,    0x608585e5,    0x15545441,    0xa3868625,
-    0xe3838360,    0xacbaba16,    0x5c757529,    0xa6929234,
-    0x996e6ef7,    0x34d0d0e4,    0x1a686872,    0x54555501,
-    0xafb6b619,    0x914e4edf,    0x32c8c8fa,    0x30c0c0f0,
-    0xf6d7d721,    0x8e3232bc,    0xb3c6c675,    0xe08f8f6f,
-    0x1d747469,    0xf5dbdb2e,    0xe18b8b6a,    0x2eb8b896,
-    0x800a0a8a,    0x679999fe,    0xc92b2be2,    0x618181e0,
-    0xc30303c0,    0x29a4a48d,    0x238c8caf,    0xa9aeae07,
-    0x0d343439,    0x524d4d1f,    0x4f393976,    0x6ebdbdd3,
-    0xd6575781,    0xd86f6fb7,    0x37dcdceb,    0x44151551,
-    0xdd7b7ba6,    0xfef7f709,    0x8c3a3ab6,    0x2fbcbc93,
-    0x030c0c0f,    0xfcffff03,    0x6ba9a9c2,    0x73c9c9ba,
-    0x6cb5b5d9,    0x6db1b1dc,    0x5a6d6d37,    0x50454515,
-    0x8f3636b9,    0x1b6c6c77,    0xadbebe13,    0x904a4ada,
-    0xb9eeee57,    0xde7777a9,    0xbef2f24c,    0x7efdfd83,
-    0x11444455,    0xda6767bd,    0x5d71712c,    0x40050545,
-    0x1f7c7c63,    0x10404050,    0x5b696932,    0xdb6363b8,
-    0x0a282822,    0xc20707c5,    0x31c4c4f5,    0x8a2222a8,
-    0xa7969631,    0xce3737f9,    0x7aeded97,    0xbff6f649,
-    0x2db4b499,    0x75d1d1a4,    0xd3434390,    0x1248485a,
-    0xbae2e258,    0xe6979771,    0xb6d2d264,    0xb2c2c270,
-    0x8b2626ad,    0x68a5a5cd,    0x955e5ecb,    0x4b292962,
-    0x0c30303c,    0x945a5ace,    0x76ddddab,    0x7ff9f986,
-    0x649595f1,    0xbbe6e65d,    0xf2c7c735,    0x0924242d,
-    0xc61717d1,    0x6fb9b9d6,    0xc51b1bde,    0x86121294,
-    0x18606078,    0xf3c3c330,    0x7cf5f589,    0xefb3b35c,
-    0x3ae8e8d2,    0xdf7373ac,    0x4c353579,    0x208080a0,
-    0x78e5e59d,    0xedbbbb56,    0x5e7d7d23,    0x3ef8f8c6,
-    0xd45f5f8b,    0xc82f2fe7,    0x39e4e4dd,    0x49212168
-};
-
-const uint32_t SM4_Optimized::T0_KEY[256] = {
-    0xd66b1ac0,    0x90481200,    0xe9749d20,    0xfe7f1fc0,
-    0xcc661980,    0xe1709c20,    0x3d1e87a0,    0xb75b96e0,
-    0x160b02c0,    0xb65b16c0,    0x140a0280,    0xc2611840,
-    0x28140500,    0xfb7d9f60,    0x2c160580,    0x050280a0,
-    0x2b158560,    0x67338ce0,    0x9a4d1340,    0x763b0ec0,
-    0x2a150540,    0xbe5f17c0,    0x04020080,    0xc3619860,
-    0xaa551540,    0x44220880,    0x13098260,    0x261304c0,
-    0x49248920,    0x864310c0,    0x060300c0,    0x994c9320,
-    0x9c4e1380,    0x42210840,    0x50280a00,    0xf47a1e80,
-    0x91489220,    0xef779de0,    0x984c1300,    0x7a3d0f40,
-    0x33198660,    0x542a0a80,    0x0b058160,    0x43218860,
-    0xed769da0,    0xcf6799e0,    0xac561580,    0x62310c40,
-    0xe4721c80,    0xb3599660,    0x1c0e0380,    0xa9549520,
-    0xc9649920,    0x08040100,    0xe8741d00,    0x954a92a0,
-    0x80401000,    0xdf6f9be0,    0x944a1280,    0xfa7d1f40,
-    0x753a8ea0,    0x8f4791e0,    0x3f1f87e0,    0xa65314c0,
-    0x472388e0,    0x070380e0,    0xa75394e0,    0xfc7e1f80,
-    0xf3799e60,    0x73398e60,    0x170b82e0,    0xba5d1740,
-    0x83419060,    0x592c8b20,    0x3c1e0780,    0x190c8320,
-    0xe6731cc0,    0x854290a0,    0x4f2789e0,    0xa8541500,
-    0x68340d00,    0x6b358d60,    0x81409020,    0xb2591640,
-    0x71388e20,    0x64320c80,    0xda6d1b40,    0x8b459160,
-    0xf87c1f00,    0xeb759d60,    0x0f0781e0,    0x4b258960,
-    0x70380e00,    0x562b0ac0,    0x9d4e93a0,    0x351a86a0,
-    0x1e0f03c0,    0x24120480,    0x0e0701c0,    0x5e2f0bc0,
-    0x63318c60,    0x582c0b00,    0xd1689a20,    0xa2511440,
-    0x251284a0,    0x22110440,    0x7c3e0f80,    0x3b1d8760,
-    0x01008020,    0x21108420,    0x783c0f00,    0x874390e0,
-    0xd46a1a80,    0x00000000,    0x462308c0,    0x572b8ae0,
-    0x9f4f93e0,    0xd3699a60,    0x271384e0,    0x52290a40,
-    0x4c260980,    0x361b06c0,    0x02010040,    0xe7739ce0,
-    0xa0501400,    0xc4621880,    0xc8641900,    0x9e4f13c0,
-    0xea751d40,    0xbf5f97e0,    0x8a451140,    0xd2691a40,
-    0x40200800,    0xc76398e0,    0x381c0700,    0xb55a96a0,
-    0xa3519460,    0xf77b9ee0,    0xf2791e40,    0xce6719c0,
-    0xf97c9f20,    0x61308c20,    0x150a82a0,    0xa1509420,
-    0xe0701c00,    0xae5715c0,    0x5d2e8ba0,    0xa4521480,
-    0x9b4d9360,    0x341a0680,    0x1a0d0340,    0x552a8aa0,
-    0xad5695a0,    0x93499260,    0x32190640,    0x30180600,
-    0xf57a9ea0,    0x8c461180,    0xb1589620,    0xe3719c60,
-    0x1d0e83a0,    0xf67b1ec0,    0xe2711c40,    0x2e1705c0,
-    0x82411040,    0x66330cc0,    0xca651940,    0x60300c00,
-    0xc0601800,    0x29148520,    0x23118460,    0xab559560,
-    0x0d0681a0,    0x53298a60,    0x4e2709c0,    0x6f378de0,
-    0xd56a9aa0,    0xdb6d9b60,    0x371b86e0,    0x452288a0,
-    0xde6f1bc0,    0xfd7e9fa0,    0x8e4711c0,    0x2f1785e0,
-    0x03018060,    0xff7f9fe0,    0x6a350d40,    0x72390e40,
-    0x6d368da0,    0x6c360d80,    0x5b2d8b60,    0x51288a20,
-    0x8d4691a0,    0x1b0d8360,    0xaf5795e0,    0x92491240,
-    0xbb5d9760,    0xdd6e9ba0,    0xbc5e1780,    0x7f3f8fe0,
-    0x11088220,    0xd96c9b20,    0x5c2e0b80,    0x41208820,
-    0x1f0f83e0,    0x10080200,    0x5a2d0b40,    0xd86c1b00,
-    0x0a050140,    0xc1609820,    0x31188620,    0x88441100,
-    0xa55294a0,    0xcd6699a0,    0x7b3d8f60,    0xbd5e97a0,
-    0x2d1685a0,    0x743a0e80,    0xd0681a00,    0x12090240,
-    0xb85c1700,    0xe5729ca0,    0xb45a1680,    0xb0581600,
-    0x89449120,    0x69348d20,    0x974b92e0,    0x4a250940,
-    0x0c060180,    0x964b12c0,    0x773b8ee0,    0x7e3f0fc0,
-    0x65328ca0,    0xb95c9720,    0xf1789e20,    0x09048120,
-    0xc56298a0,    0x6e370dc0,    0xc66318c0,    0x84421080,
-    0x180c0300,    0xf0781e00,    0x7d3e8fa0,    0xec761d80,
-    0x3a1d0740,    0xdc6e1b80,    0x4d2689a0,    0x20100400,
-    0x793c8f20,    0xee771dc0,    0x5f2f8be0,    0x3e1f07c0,
-    0xd76b9ae0,    0xcb659960,    0x391c8720,    0x48240900
-};
-
-const uint32_t SM4_Optimized::T1_KEY[256] = {
-    0xc0d66b1a,    0x00904812,    0x20e9749d,    0xc0fe7f1f,
-    0x80cc6619,    0x20e1709c,    0xa03d1e87,    0xe0b75b96,
-    0xc0160b02,    0xc0b65b16,    0x80140a02,    0x40c26118,
-    0x00281405,    0x60fb7d9f,    0x802c1605,    0xa0050280,
-    0x602b1585,    0xe067338c,    0x409a4d13,    0xc0763b0e,
-    0x402a1505,    0xc0be5f17,    0x80040200,    0x60c36198,
-    0x40aa5515,    0x80442208,    0x60130982,    0xc0261304,
-    0x20492489,    0xc0864310,    0xc0060300,    0x20994c93,
-    0x809c4e13,    0x40422108,    0x0050280a,    0x80f47a1e,
-    0x20914892,    0xe0ef779d,    0x00984c13,    0x407a3d0f,
-    0x60331986,    0x80542a0a,    0x600b0581,    0x60432188,
-    0xa0ed769d,    0xe0cf6799,    0x80ac5615,    0x4062310c,
-    0x80e4721c,    0x60b35996,    0x801c0e03,    0x20a95495,
-    0x20c96499,    0x00080401,    0x00e8741d,    0xa0954a92,
-    0x00804010,    0xe0df6f9b,    0x80944a12,    0x40fa7d1f,
-    0xa0753a8e,    0xe08f4791,    0xe03f1f87,    0xc0a65314,
-    0xe0472388,    0xe0070380,    0xe0a75394,    0x80fc7e1f,
-    0x60f3799e,    0x6073398e,    0xe0170b82,    0x40ba5d17,
-    0x60834190,    0x20592c8b,    0x803c1e07,    0x20190c83,
-    0xc0e6731c,    0xa0854290,    0xe04f2789,    0x00a85415,
-    0x0068340d,    0x606b358d,    0x20814090,    0x40b25916,
-    0x2071388e,    0x8064320c,    0x40da6d1b,    0x608b4591,
-    0x00f87c1f,    0x60eb759d,    0xe00f0781,    0x604b2589,
-    0x0070380e,    0xc0562b0a,    0xa09d4e93,    0xa0351a86,
-    0xc01e0f03,    0x80241204,    0xc00e0701,    0xc05e2f0b,
-    0x6063318c,    0x00582c0b,    0x20d1689a,    0x40a25114,
-    0xa0251284,    0x40221104,    0x807c3e0f,    0x603b1d87,
-    0x20010080,    0x20211084,    0x00783c0f,    0xe0874390,
-    0x80d46a1a,    0x00000000,    0xc0462308,    0xe0572b8a,
-    0xe09f4f93,    0x60d3699a,    0xe0271384,    0x4052290a,
-    0x804c2609,    0xc0361b06,    0x40020100,    0xe0e7739c,
-    0x00a05014,    0x80c46218,    0x00c86419,    0xc09e4f13,
-    0x40ea751d,    0xe0bf5f97,    0x408a4511,    0x40d2691a,
-    0x00402008,    0xe0c76398,    0x00381c07,    0xa0b55a96,
-    0x60a35194,    0xe0f77b9e,    0x40f2791e,    0xc0ce6719,
-    0x20f97c9f,    0x2061308c,    0xa0150a82,    0x20a15094,
-    0x00e0701c,    0xc0ae5715,    0xa05d2e8b,    0x80a45214,
-    0x609b4d93,    0x80341a06,    0x401a0d03,    0xa0552a8a,
-    0xa0ad5695,    0x60934992,    0x40321906,    0x00301806,
-    0xa0f57a9e,    0x808c4611,    0x20b15896,    0x60e3719c,
-    0xa01d0e83,    0xc0f67b1e,    0x40e2711c,    0xc02e1705,
-    0x40824110,    0xc066330c,    0x40ca6519,    0x0060300c,
-    0x00c06018,    0x20291485,    0x60231184,    0x60ab5595,
-    0xa00d0681,    0x6053298a,    0xc04e2709,    0xe06f378d,
-    0xa0d56a9a,    0x60db6d9b,    0xe0371b86,    0xa0452288,
-    0xc0de6f1b,    0xa0fd7e9f,    0xc08e4711,    0xe02f1785,
-    0x60030180,    0xe0ff7f9f,    0x406a350d,    0x4072390e,
-    0xa06d368d,    0x806c360d,    0x605b2d8b,    0x2051288a,
-    0xa08d4691,    0x601b0d83,    0xe0af5795,    0x40924912,
-    0x60bb5d97,    0xa0dd6e9b,    0x80bc5e17,    0xe07f3f8f,
-    0x20110882,    0x20d96c9b,    0x805c2e0b,    0x20412088,
-    0xe01f0f83,    0x00100802,    0x405a2d0b,    0x00d86c1b,
-    0x400a0501,    0x20c16098,    0x20311886,    0x00884411,
-    0xa0a55294,    0xa0cd6699,    0x607b3d8f,    0xa0bd5e97,
-    0xa02d1685,    0x80743a0e,    0x00d0681a,    0x40120902,
-    0x00b85c17,    0xa0e5729c,    0x80b45a16,    0x00b05816,
-    0x20894491,    0x2069348d,    0xe0974b92,    0x404a2509,
-    0x800c0601,    0xc0964b12,    0xe0773b8e,    0xc07e3f0f,
-    0xa065328c,    0x20b95c97,    0x20f1789e,    0x20090481,
-    0xa0c56298,    0xc06e370d,    0xc0c66318,    0x80844210,
-    0x00180c03,    0x00f0781e,    0xa07d3e8f,    0x80ec761d,
-    0x403a1d07,    0x80dc6e1b,    0xa04d2689,    0x00201004,
-    0x20793c8f,    0xc0ee771d,    0xe05f2f8b,    0xc03e1f07,
-    0xe0d76b9a,    0x60cb6599,    0x20391c87,    0x00482409
-};
-
-const uint32_t SM4_Optimized::T2_KEY[256] = {
-    0x1ac0d66b,    0x12009048,    0x9d20e974,    0x1fc0fe7f,
-    0x1980cc66,    0x9c20e170,    0x87a03d1e,    0x96e0b75b,
-    0x02c0160b,    0x16c0b65b,    0x0280140a,    0x1840c261,
-    0x05002814,    0x9f60fb7d,    0x05802c16,    0x80a00502,
-    0x85602b15,    0x8ce06733,    0x13409a4d,    0x0ec0763b,
-    0x05402a15,    0x17c0be5f,    0x00800402,    0x9860c361,
-    0x1540aa55,    0x08804422,    0x82601309,    0x04c02613,
-    0x89204924,    0x10c08643,    0x00c00603,    0x9320994c,
-    0x13809c4e,    0x08404221,    0x0a005028,    0x1e80f47a,
-    0x92209148,    0x9de0ef77,    0x1300984c,    0x0f407a3d,
-    0x86603319,    0x0a80542a,    0x81600b05,    0x88604321,
-    0x9da0ed76,    0x99e0cf67,    0x1580ac56,    0x0c406231,
-    0x1c80e472,    0x9660b359,    0x03801c0e,    0x9520a954,
-    0x9920c964,    0x01000804,    0x1d00e874,    0x92a0954a,
-    0x10008040,    0x9be0df6f,    0x1280944a,    0x1f40fa7d,
-    0x8ea0753a,    0x91e08f47,    0x87e03f1f,    0x14c0a653,
-    0x88e04723,    0x80e00703,    0x94e0a753,    0x1f80fc7e,
-    0x9e60f379,    0x8e607339,    0x82e0170b,    0x1740ba5d,
-    0x90608341,    0x8b20592c,    0x07803c1e,    0x8320190c,
-    0x1cc0e673,    0x90a08542,    0x89e04f27,    0x1500a854,
-    0x0d006834,    0x8d606b35,    0x90208140,    0x1640b259,
-    0x8e207138,    0x0c806432,    0x1b40da6d,    0x91608b45,
-    0x1f00f87c,    0x9d60eb75,    0x81e00f07,    0x89604b25,
-    0x0e007038,    0x0ac0562b,    0x93a09d4e,    0x86a0351a,
-    0x03c01e0f,    0x04802412,    0x01c00e07,    0x0bc05e2f,
-    0x8c606331,    0x0b00582c,    0x9a20d168,    0x1440a251,
-    0x84a02512,    0x04402211,    0x0f807c3e,    0x87603b1d,
-    0x80200100,    0x84202110,    0x0f00783c,    0x90e08743,
-    0x1a80d46a,    0x00000000,    0x08c04623,    0x8ae0572b,
-    0x93e09f4f,    0x9a60d369,    0x84e02713,    0x0a405229,
-    0x09804c26,    0x06c0361b,    0x00400201,    0x9ce0e773,
-    0x1400a050,    0x1880c462,    0x1900c864,    0x13c09e4f,
-    0x1d40ea75,    0x97e0bf5f,    0x11408a45,    0x1a40d269,
-    0x08004020,    0x98e0c763,    0x0700381c,    0x96a0b55a,
-    0x9460a351,    0x9ee0f77b,    0x1e40f279,    0x19c0ce67,
-    0x9f20f97c,    0x8c206130,    0x82a0150a,    0x9420a150,
-    0x1c00e070,    0x15c0ae57,    0x8ba05d2e,    0x1480a452,
-    0x93609b4d,    0x0680341a,    0x03401a0d,    0x8aa0552a,
-    0x95a0ad56,    0x92609349,    0x06403219,    0x06003018,
-    0x9ea0f57a,    0x11808c46,    0x9620b158,    0x9c60e371,
-    0x83a01d0e,    0x1ec0f67b,    0x1c40e271,    0x05c02e17,
-    0x10408241,    0x0cc06633,    0x1940ca65,    0x0c006030,
-    0x1800c060,    0x85202914,    0x84602311,    0x9560ab55,
-    0x81a00d06,    0x8a605329,    0x09c04e27,    0x8de06f37,
-    0x9aa0d56a,    0x9b60db6d,    0x86e0371b,    0x88a04522,
-    0x1bc0de6f,    0x9fa0fd7e,    0x11c08e47,    0x85e02f17,
-    0x80600301,    0x9fe0ff7f,    0x0d406a35,    0x0e407239,
-    0x8da06d36,    0x0d806c36,    0x8b605b2d,    0x8a205128,
-    0x91a08d46,    0x83601b0d,    0x95e0af57,    0x12409249,
-    0x9760bb5d,    0x9ba0dd6e,    0x1780bc5e,    0x8fe07f3f,
-    0x82201108,    0x9b20d96c,    0x0b805c2e,    0x88204120,
-    0x83e01f0f,    0x02001008,    0x0b405a2d,    0x1b00d86c,
-    0x01400a05,    0x9820c160,    0x86203118,    0x11008844,
-    0x94a0a552,    0x99a0cd66,    0x8f607b3d,    0x97a0bd5e,
-    0x85a02d16,    0x0e80743a,    0x1a00d068,    0x02401209,
-    0x1700b85c,    0x9ca0e572,    0x1680b45a,    0x1600b058,
-    0x91208944,    0x8d206934,    0x92e0974b,    0x09404a25,
-    0x01800c06,    0x12c0964b,    0x8ee0773b,    0x0fc07e3f,
-    0x8ca06532,    0x9720b95c,    0x9e20f178,    0x81200904,
-    0x98a0c562,    0x0dc06e37,    0x18c0c663,    0x10808442,
-    0x0300180c,    0x1e00f078,    0x8fa07d3e,    0x1d80ec76,
-    0x07403a1d,    0x1b80dc6e,    0x89a04d26,    0x04002010,
-    0x8f20793c,    0x1dc0ee77,    0x8be05f2f,    0x07c03e1f,
-    0x9ae0d76b,    0x9960cb65,    0x8720391c,    0x09004824
-};
-
-const uint32_t SM4_Optimized::T3_KEY[256] = {
-    0x6b1ac0d6,    0x48120090,    0x749d20e9,    0x7f1fc0fe,
-    0x661980cc,    0x709c20e1,    0x1e87a03d,    0x5b96e0b7,
-    0x0b02c016,    0x5b16c0b6,    0x0a028014,    0x611840c2,
-    0x14050028,    0x7d9f60fb,    0x1605802c,    0x0280a005,
-    0x1585602b,    0x338ce067,    0x4d13409a,    0x3b0ec076,
-    0x1505402a,    0x5f17c0be,    0x02008004,    0x619860c3,
-    0x551540aa,    0x22088044,    0x09826013,    0x1304c026,
-    0x24892049,    0x4310c086,    0x0300c006,    0x4c932099,
-    0x4e13809c,    0x21084042,    0x280a0050,    0x7a1e80f4,
-    0x48922091,    0x779de0ef,    0x4c130098,    0x3d0f407a,
-    0x19866033,    0x2a0a8054,    0x0581600b,    0x21886043,
-    0x769da0ed,    0x6799e0cf,    0x561580ac,    0x310c4062,
-    0x721c80e4,    0x599660b3,    0x0e03801c,    0x549520a9,
-    0x649920c9,    0x04010008,    0x741d00e8,    0x4a92a095,
-    0x40100080,    0x6f9be0df,    0x4a128094,    0x7d1f40fa,
-    0x3a8ea075,    0x4791e08f,    0x1f87e03f,    0x5314c0a6,
-    0x2388e047,    0x0380e007,    0x5394e0a7,    0x7e1f80fc,
-    0x799e60f3,    0x398e6073,    0x0b82e017,    0x5d1740ba,
-    0x41906083,    0x2c8b2059,    0x1e07803c,    0x0c832019,
-    0x731cc0e6,    0x4290a085,    0x2789e04f,    0x541500a8,
-    0x340d0068,    0x358d606b,    0x40902081,    0x591640b2,
-    0x388e2071,    0x320c8064,    0x6d1b40da,    0x4591608b,
-    0x7c1f00f8,    0x759d60eb,    0x0781e00f,    0x2589604b,
-    0x380e0070,    0x2b0ac056,    0x4e93a09d,    0x1a86a035,
-    0x0f03c01e,    0x12048024,    0x0701c00e,    0x2f0bc05e,
-    0x318c6063,    0x2c0b0058,    0x689a20d1,    0x511440a2,
-    0x1284a025,    0x11044022,    0x3e0f807c,    0x1d87603b,
-    0x00802001,    0x10842021,    0x3c0f0078,    0x4390e087,
-    0x6a1a80d4,    0x00000000,    0x2308c046,    0x2b8ae057,
-    0x4f93e09f,    0x699a60d3,    0x1384e027,    0x290a4052,
-    0x2609804c,    0x1b06c036,    0x01004002,    0x739ce0e7,
-    0x501400a0,    0x621880c4,    0x641900c8,    0x4f13c09e,
-    0x751d40ea,    0x5f97e0bf,    0x4511408a,    0x691a40d2,
-    0x20080040,    0x6398e0c7,    0x1c070038,    0x5a96a0b5,
-    0x519460a3,    0x7b9ee0f7,    0x791e40f2,    0x6719c0ce,
-    0x7c9f20f9,    0x308c2061,    0x0a82a015,    0x509420a1,
-    0x701c00e0,    0x5715c0ae,    0x2e8ba05d,    0x521480a4,
-    0x4d93609b,    0x1a068034,    0x0d03401a,    0x2a8aa055,
-    0x5695a0ad,    0x49926093,    0x19064032,    0x18060030,
-    0x7a9ea0f5,    0x4611808c,    0x589620b1,    0x719c60e3,
-    0x0e83a01d,    0x7b1ec0f6,    0x711c40e2,    0x1705c02e,
-    0x41104082,    0x330cc066,    0x651940ca,    0x300c0060,
-    0x601800c0,    0x14852029,    0x11846023,    0x559560ab,
-    0x0681a00d,    0x298a6053,    0x2709c04e,    0x378de06f,
-    0x6a9aa0d5,    0x6d9b60db,    0x1b86e037,    0x2288a045,
-    0x6f1bc0de,    0x7e9fa0fd,    0x4711c08e,    0x1785e02f,
-    0x01806003,    0x7f9fe0ff,    0x350d406a,    0x390e4072,
-    0x368da06d,    0x360d806c,    0x2d8b605b,    0x288a2051,
-    0x4691a08d,    0x0d83601b,    0x5795e0af,    0x49124092,
-    0x5d9760bb,    0x6e9ba0dd,    0x5e1780bc,    0x3f8fe07f,
-    0x08822011,    0x6c9b20d9,    0x2e0b805c,    0x20882041,
-    0x0f83e01f,    0x08020010,    0x2d0b405a,    0x6c1b00d8,
-    0x0501400a,    0x609820c1,    0x18862031,    0x44110088,
-    0x5294a0a5,    0x6699a0cd,    0x3d8f607b,    0x5e97a0bd,
-    0x1685a02d,    0x3a0e8074,    0x681a00d0,    0x09024012,
-    0x5c1700b8,    0x729ca0e5,    0x5a1680b4,    0x581600b0,
-    0x44912089,    0x348d2069,    0x4b92e097,    0x2509404a,
-    0x0601800c,    0x4b12c096,    0x3b8ee077,    0x3f0fc07e,
-    0x328ca065,    0x5c9720b9,    0x789e20f1,    0x04812009,
-    0x6298a0c5,    0x370dc06e,    0x6318c0c6,    0x42108084,
-    0x0c030018,    0x781e00f0,    0x3e8fa07d,    0x761d80ec,
-    0x1d07403a,    0x6e1b80dc,    0x2689a04d,    0x10040020,
-    0x3c8f2079,    0x771dc0ee,    0x2f8be05f,    0x1f07c03e,
-    0x6b9ae0d7,    0x659960cb,    0x1c872039,    0x24090048
-};
-
-const uint32_t SM4_Optimized::FK[4] = {
-    0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc
-};
-
-const uint32_t SM4_Optimized::CK[32] = {
-    0x00070e15, 0x1c232a31, 0x383f464d, 0x545b6269,
-    0x70777e85, 0x8c939aa1, 0xa8afb6bd, 0xc4cbd2d9,
-    0xe0e7eef5, 0xfc030a11, 0x181f262d, 0x343b4249,
-    0x50575e65, 0x6c737a81, 0x888f969d, 0xa4abb2b9,
-    0xc0c7ced5, 0xdce3eaf1, 0xf8ff060d, 0x141b2229,
-    0x30373e45, 0x4c535a61, 0x686f767d, 0x848b9299,
-    0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
-    0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279
-};
-
 // Public API functions to match the original interface
 std::string encrypt_block_hex(const std::string &plain_hex, const std::string &key_hex) {
     return SM4_Optimized::encrypt_block_hex(plain_hex, key_hex);
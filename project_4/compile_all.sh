@@ -9,6 +9,7 @@ VARIANTS=(
     "opt3_simd:SIMD Message Expansion"
     "opt4_on_the_fly:On-the-fly Computation"
     "opt5_flatten:Flattened & Macro Optimized"
+    "opt6_vector_expand:Vectorized Expansion Interleaved with Rounds"
 )
 
 echo "Using compilation flags: $CFLAGS"
@@ -31,3 +32,95 @@ for variant_info in "${VARIANTS[@]}"; do
     fi
 done
 
+echo ""
+echo "Compiling sm3_async (C++20 coroutine front end)..."
+g++ $CFLAGS -std=c++20 -pthread -o sm3_async.elf sm3_async.cpp
+./sm3_async.elf
+
+echo ""
+echo "Compiling sm3_multibuffer (8-lane AVX2 engine + benchmark)..."
+g++ $CFLAGS -o sm3_multibuffer.elf sm3_multibuffer.cpp
+./sm3_multibuffer.elf
+
+echo ""
+echo "Compiling sm3_large_file_bench (single-stream large input benchmark)..."
+g++ $CFLAGS -o sm3_large_file_bench.elf sm3_large_file_bench.cpp
+./sm3_large_file_bench.elf
+
+echo ""
+echo "Compiling sm3_x2 (2-way interleaved scalar kernel + pair latency benchmark)..."
+g++ $CFLAGS -o sm3_x2.elf sm3_x2.cpp
+./sm3_x2.elf
+
+echo ""
+echo "Compiling sm3sum (parallel checksum tool) and checking its own manifest..."
+g++ $CFLAGS -pthread -o sm3sum.elf sm3sum.cpp
+MANIFEST=$(mktemp)
+./sm3sum.elf --stats *.h *.cpp > "$MANIFEST"
+./sm3sum.elf -c -q "$MANIFEST" && echo "✓ sm3sum -c verified $(wc -l < "$MANIFEST") files"
+rm -f "$MANIFEST"
+
+echo ""
+echo "Compiling sm3_tree (parallel tree hash v1 + scaling benchmark)..."
+g++ $CFLAGS -pthread -o sm3_tree.elf sm3_tree.cpp
+./sm3_tree.elf 64
+
+echo ""
+echo "Compiling sm3_merkle_log (append-only Merkle log + proofs)..."
+g++ $CFLAGS -o sm3_merkle_log.elf sm3_merkle_log.cpp
+./sm3_merkle_log.elf
+
+echo ""
+echo "Compiling sm3_state (mid-state export/import + checkpoint resume)..."
+g++ $CFLAGS -o sm3_state.elf sm3_state.cpp
+./sm3_state.elf
+
+echo ""
+echo "Compiling sm3_prefix_cache (prefix mid-state LRU cache + benchmark)..."
+g++ $CFLAGS -o sm3_prefix_cache.elf sm3_prefix_cache.cpp
+./sm3_prefix_cache.elf
+
+echo ""
+echo "Compiling sm3_hmac (HMAC-SM3 with cached pad states + batch verify)..."
+g++ $CFLAGS -o sm3_hmac.elf sm3_hmac.cpp
+./sm3_hmac.elf
+
+echo ""
+echo "Compiling sm3_pbkdf2 (PBKDF2-HMAC-SM3 on 8 lanes)..."
+g++ $CFLAGS -o sm3_pbkdf2.elf sm3_pbkdf2.cpp
+./sm3_pbkdf2.elf
+
+echo ""
+echo "Compiling sm3_fixed (fixed-length SM3 with compile-time padding)..."
+g++ $CFLAGS -o sm3_fixed.elf sm3_fixed.cpp
+./sm3_fixed.elf
+
+echo ""
+echo "Compiling sm3_round_engine (compile-time round engine, schedules x unroll factors)..."
+g++ $CFLAGS -o sm3_round_engine.elf sm3_round_engine.cpp
+./sm3_round_engine.elf
+
+echo ""
+echo "Compiling sm3_dispatch (auto-tuning variant dispatcher by message size)..."
+g++ $CFLAGS -o sm3_dispatch.elf sm3_dispatch.cpp
+./sm3_dispatch.elf
+
+echo ""
+echo "Compiling sm3_bench (benchmark harness over every variant and mode, JSON report)..."
+g++ $CFLAGS -o sm3_bench.elf sm3_bench.cpp
+./sm3_bench.elf --max-size 1M --budget 1M --json sm3_bench.json
+
+echo ""
+echo "Compiling sm3_bench with per-stage timing (-DSM3_STAGE_TIMING)..."
+g++ $CFLAGS -DSM3_STAGE_TIMING -o sm3_bench_stages.elf sm3_bench.cpp
+./sm3_bench_stages.elf --max-size 64K --budget 256K --json sm3_bench_stages.json
+
+echo ""
+echo "Compiling sm3_digest (stateless one-shot SM3 for short inputs)..."
+g++ $CFLAGS -o sm3_digest.elf sm3_digest.cpp
+./sm3_digest.elf
+
+echo ""
+echo "Compiling sm3_batch (batch API with length-sorted lane packing)..."
+g++ $CFLAGS -std=c++20 -o sm3_batch.elf sm3_batch.cpp
+./sm3_batch.elf
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "sm3_hasher.h"
+
+// Schedule and W' array before the rounds, all 64 rounds unrolled.
+using SM3_Unrolled = sm3_engine::Hasher<sm3_engine::Precomputed<sm3_engine::WPrime::Array>, 64>;
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "sm3_hasher.h"
+
+// All 64 rounds unrolled with no W' array: W[j] ^ W[j+4] is formed at the round, so
+// the schedule words can stay in registers instead of a second array.
+using SM3_RegAlloc = sm3_engine::Hasher<sm3_engine::Precomputed<sm3_engine::WPrime::OnUse, true>, 64>;
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "sm3_hasher.h"
+
+// The reference order with the W' array filled four words per SSE XOR.
+using SM3_SIMD = sm3_engine::Hasher<sm3_engine::Precomputed<sm3_engine::WPrime::Simd>, 1>;
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "sm3_hasher.h"
+
+// The schedule lives in a 16-word window that is refilled eight rounds ahead of the
+// round that reads it, so there is no expansion pass and no 68-word array.
+using SM3_OnTheFly = sm3_engine::Hasher<sm3_engine::RollingWindow<8>, 64>;
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "sm3_hasher.h"
+
+// Everything flattened: the 52 expansion steps and all 64 rounds as straight-line code.
+using SM3_Flatten = sm3_engine::Hasher<sm3_engine::Precomputed<sm3_engine::WPrime::Array, true>, 64>;
@@ -0,0 +1,6 @@
+#include "opt6_vector_expand.h"
+#include "sm3_file.h"
+
+int main(int argc, char** argv) {
+    return sm3_file::run_main<SM3_VectorExpand>(argc, argv);
+}
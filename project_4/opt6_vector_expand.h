@@ -0,0 +1,43 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "sm3_hasher.h"
+
+/**
+ * Single-stream SM3 with the message expansion vectorized three words at a time and
+ * interleaved with the compression rounds.
+ *
+ * W[j] depends on W[j-3], so W[j], W[j+1] and W[j+2] can be computed together from
+ * words that already exist, but W[j+3] cannot. Each expand3() step evaluates the
+ * recurrence on a 128-bit vector of four lanes; the fourth lane reads the unfinished
+ * W[j] and its result is overwritten by the next step. 18 steps produce W[16..67].
+ *
+ * The first step runs before round 0 and one further step is issued every three rounds,
+ * so every word is ready at least twelve rounds before it is first used. The vector steps
+ * do not depend on A..H, which lets the out-of-order core run them alongside the scalar
+ * round chain instead of in a separate expansion phase.
+ */
+class SM3_VectorExpand : public sm3_engine::Hasher<sm3_engine::Interleaved, 64> {
+public:
+    // Compresses one 64-byte block into the chaining value H, for callers that build
+    // their own padded blocks (PBKDF2 iterations, fixed-length inputs).
+    static void compress(uint32_t H[8], const uint8_t* block) {
+        sm3_engine::Interleaved w(block);
+        sm3_engine::compress<64>(H, w);
+    }
+
+    // The same for a block already in registers as four 16-byte chunks in message byte
+    // order, so a block assembled from input and padding need not go through memory.
+    static inline __attribute__((always_inline)) void compress_chunks(uint32_t H[8], const __m128i m[4]) {
+        sm3_engine::Interleaved w(m);
+        sm3_engine::compress<64>(H, w);
+    }
+
+    // Compresses a block whose whole schedule W[0..67] is already known, such as a
+    // constant padding block expanded at compile time.
+    static void compress_expanded(uint32_t H[8], const uint32_t W[68]) {
+        sm3_engine::Given w(W);
+        sm3_engine::compress<64>(H, w);
+    }
+};
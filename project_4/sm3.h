@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sm3_fixed.h"
+#include "sm3_hasher.h"
+
+// The reference order: the whole schedule and the W' array before the rounds, one
+// round per loop iteration (the smallest code).
+class SM3 : public sm3_engine::Hasher<sm3_engine::Precomputed<sm3_engine::WPrime::Array>, 1> {
+public:
+    using Hasher::hash;
+
+    // SM3 of exactly N bytes, with the padding fixed at compile time (sm3_fixed.h).
+    template <size_t N>
+    static void hash(const uint8_t* data, uint8_t digest[32]) {
+        SM3_Fixed<N>::hash(data, digest);
+    }
+};
@@ -0,0 +1,48 @@
+#include "sm3_async.h"
+
+/**
+ * Drives SM3Async from a single-threaded event loop with a burst of small messages
+ * (batched), one message on an idle loop (inline) and one large message (worker pool),
+ * and checks every digest against the synchronous SM3 class.
+ */
+
+using crypto_async::EventLoop;
+using crypto_async::Task;
+
+static Task<void> hash_and_check(SM3Async& sm3, const std::vector<uint8_t>& message, bool& ok) {
+    std::string digest = co_await sm3.hash_async(message);
+    ok = ok && digest == SM3::hash(message);
+}
+
+int main() {
+    EventLoop loop;
+    SM3Async sm3(loop);
+    bool ok = true;
+
+    std::vector<uint8_t> abc = {'a', 'b', 'c'};
+    loop.spawn(hash_and_check(sm3, abc, ok));
+    loop.run();
+
+    std::vector<std::vector<uint8_t>> messages;
+    for (int j = 0; j < 64; j++) {
+        messages.emplace_back(j * 5, static_cast<uint8_t>(j));
+    }
+    messages.emplace_back(1024 * 1024, 0x61);
+
+    for (const auto& message : messages) {
+        loop.spawn(hash_and_check(sm3, message, ok));
+    }
+    loop.run();
+
+    const auto& stats = sm3.get_stats();
+    std::cout << "Inline jobs:    " << stats.inline_jobs << std::endl;
+    std::cout << "Batched jobs:   " << stats.batched_jobs << " in " << stats.batches << " batches" << std::endl;
+    std::cout << "Offloaded jobs: " << stats.offloaded_jobs << std::endl;
+
+    if (ok) {
+        std::cout << "✓ Async digests match synchronous SM3" << std::endl;
+        return 0;
+    }
+    std::cout << "✗ Async digests differ from synchronous SM3" << std::endl;
+    return 1;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../project_1/crypto_runtime/crypto_async.h"
+#include "sm3.h"
+#include "sm3_multibuffer.h"
+
+/**
+ * Awaitable SM3 front end sharing the SM4 coroutine runtime and worker pool:
+ *
+ *     SM3Async sm3(loop);
+ *     std::string digest = co_await sm3.hash_async(span);
+ *
+ * Small messages run inline on an idle loop, or are queued and hashed together by the
+ * 8-lane multi-buffer engine at the end of the loop tick; messages at or above
+ * AsyncConfig::offload_threshold are hashed on the shared worker pool.
+ */
+class SM3Async {
+public:
+    class Awaiter {
+    public:
+        Awaiter(SM3Async& owner, std::span<const uint8_t> data) : owner(owner), data(data) {}
+
+        bool await_ready() {
+            if (data.size() >= owner.config.offload_threshold) {
+                return false;
+            }
+            if (owner.loop.idle() && owner.batcher.empty()) {
+                digest = hash_span(data);
+                owner.stats.inline_jobs++;
+                return true;
+            }
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            if (data.size() >= owner.config.offload_threshold) {
+                owner.stats.offloaded_jobs++;
+                offload.emplace(owner.loop, crypto_async::WorkerPool::shared(), [this] {
+                    digest = hash_span(data);
+                });
+                offload->await_suspend(h);
+                return;
+            }
+            owner.batcher.enqueue(Job{data, &digest}, 1, h, &batch_error);
+        }
+
+        std::string await_resume() {
+            if (offload) {
+                offload->await_resume();
+            }
+            if (batch_error) {
+                std::rethrow_exception(batch_error);
+            }
+            return std::move(digest);
+        }
+
+    private:
+        SM3Async& owner;
+        std::span<const uint8_t> data;
+        std::string digest;
+        std::optional<crypto_async::OffloadAwaiter> offload;
+        std::exception_ptr batch_error;
+    };
+
+    explicit SM3Async(crypto_async::EventLoop& loop, crypto_async::AsyncConfig config = {})
+        : loop(loop), config(config),
+          batcher(loop, [](std::vector<Job>& jobs) { hash_batch(jobs); }, config.max_batch_units, stats) {}
+
+    Awaiter hash_async(std::span<const uint8_t> data) {
+        return Awaiter(*this, data);
+    }
+
+    const crypto_async::AsyncStats& get_stats() const {
+        return stats;
+    }
+
+private:
+    struct Job {
+        std::span<const uint8_t> data;
+        std::string* digest;
+    };
+
+    static std::string hash_span(std::span<const uint8_t> data) {
+        SM3 sm3;
+        sm3.update(data.data(), data.size());
+        return sm3.finalize();
+    }
+
+    // One call per tick for every queued message, hashed 8 at a time by the
+    // multi-buffer engine.
+    static void hash_batch(std::vector<Job>& jobs) {
+        if (!SM3_MultiBuffer::is_supported()) {
+            for (auto& job : jobs) {
+                *job.digest = hash_span(job.data);
+            }
+            return;
+        }
+        SM3_MultiBuffer engine;
+        std::vector<uint8_t> digests(jobs.size() * SM3_MultiBuffer::DIGEST_BYTES);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            engine.submit(jobs[i].data.data(), jobs[i].data.size(), &digests[i * SM3_MultiBuffer::DIGEST_BYTES]);
+        }
+        engine.flush();
+        for (size_t i = 0; i < jobs.size(); i++) {
+            *jobs[i].digest = SM3_MultiBuffer::to_hex(&digests[i * SM3_MultiBuffer::DIGEST_BYTES]);
+        }
+    }
+
+    crypto_async::EventLoop& loop;
+    crypto_async::AsyncConfig config;
+    crypto_async::AsyncStats stats;
+    crypto_async::Batcher<Job> batcher;
+};
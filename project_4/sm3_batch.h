@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "sm3_digest.h"
+#include "sm3_multibuffer.h"
+
+/**
+ * Batch SM3 over the 8-lane multi-buffer engine, with the messages ordered so that the
+ * lanes stay busy to the end (C++20, for std::span).
+ *
+ *     std::vector<SM3_Batch::Msg> msgs = ...;
+ *     std::vector<SM3_Batch::Digest> digests(msgs.size());
+ *     SM3_Batch::Stats stats = sm3_hash_many(msgs, digests);   // stats.lane_utilization()
+ *
+ * The engine refills a lane as soon as its message ends, so lanes only idle once the
+ * queue is empty; what they waste is the drain, when the last few messages finish one
+ * after another. Fed in arrival order, a long message that comes late runs nearly alone
+ * for most of its length. The batch is therefore queued by block count, longest first:
+ * every lane picks the longest message left, the short ones fill in at the end, and the
+ * lanes retire within a few blocks of each other. The order comes from one bucketing
+ * pass (by the bit length of the block count, arrival order within a bucket) rather than
+ * a sort, which would cost more than hashing a batch of short messages gains.
+ *
+ * A message that would still outlast the rest of the batch on its own lane (a few huge
+ * files among small records, or nine equal messages for eight lanes) is hashed on the
+ * single-stream path instead, where one block costs about 1 / kernel_cost of an 8-lane
+ * compression rather than all of it. The choice comes from replaying the lane schedule:
+ * the longest message is moved to the single-stream path while that lowers the
+ * estimated total cost. Without AVX2 every message takes the single-stream path.
+ */
+class SM3_Batch {
+public:
+    static constexpr size_t LANES = SM3_MultiBuffer::LANES;
+
+    struct Msg {
+        const uint8_t* data;
+        size_t length;
+    };
+
+    using Digest = std::array<uint8_t, SM3_MultiBuffer::DIGEST_BYTES>;
+
+    struct Config {
+        bool pack = true;          // false: arrival order, every message on the lanes
+        double kernel_cost = 2.5;  // one 8-lane compression, in single-stream blocks
+    };
+
+    struct Stats {
+        uint64_t messages = 0;
+        uint64_t single_stream_messages = 0;
+        uint64_t single_stream_blocks = 0;
+        uint64_t kernel_calls = 0;      // 8-lane compressions
+        uint64_t busy_lane_blocks = 0;  // lane slots that carried a real block
+
+        double lane_utilization() const {
+            return kernel_calls ? static_cast<double>(busy_lane_blocks) / (kernel_calls * LANES) : 0.0;
+        }
+    };
+
+    SM3_Batch() : SM3_Batch(Config()) {}
+    explicit SM3_Batch(const Config& config) : config(config) {}
+
+    // Every message must stay valid until the call returns; digests[i] is the SM3 of
+    // messages[i]. Throws std::invalid_argument if the spans differ in size.
+    void hash_many(std::span<const Msg> messages, std::span<Digest> digests) {
+        if (messages.size() != digests.size()) {
+            throw std::invalid_argument("SM3_Batch: one digest per message");
+        }
+        std::vector<size_t> order(messages.size());
+        size_t single = 0;
+        if (config.pack && SM3_MultiBuffer::is_supported()) {
+            longest_first(messages, order);
+            single = single_stream_count(messages, order);
+        } else {
+            std::iota(order.begin(), order.end(), size_t(0));
+            single = SM3_MultiBuffer::is_supported() ? 0 : order.size();
+        }
+
+        for (size_t k = 0; k < single; k++) {
+            const Msg& m = messages[order[k]];
+            sm3_digest(m.data, m.length, digests[order[k]].data());
+            stats.single_stream_blocks += blocks(m.length);
+        }
+        stats.single_stream_messages += single;
+
+        if (single < order.size()) {
+            SM3_MultiBuffer engine;
+            for (size_t k = single; k < order.size(); k++) {
+                const Msg& m = messages[order[k]];
+                engine.submit(m.data, m.length, digests[order[k]].data());
+            }
+            engine.flush();
+            stats.kernel_calls += engine.get_stats().kernel_calls;
+            stats.busy_lane_blocks += engine.get_stats().busy_lane_blocks;
+        }
+        stats.messages += messages.size();
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    // Compressions for a message of this length, padding included.
+    static size_t blocks(size_t length) {
+        return (length + 8) / 64 + 1;
+    }
+
+private:
+    static constexpr int BUCKETS = 65;
+
+    // Bit length of the block count, 1..64.
+    static int bucket(size_t length) {
+        return 64 - __builtin_clzll(blocks(length));
+    }
+
+    static void longest_first(std::span<const Msg> messages, std::vector<size_t>& order) {
+        std::array<size_t, BUCKETS> start{};
+        for (const Msg& m : messages) {
+            start[BUCKETS - 1 - bucket(m.length)]++;
+        }
+        size_t sum = 0;
+        for (size_t& s : start) {
+            size_t count = s;
+            s = sum;
+            sum += count;
+        }
+        for (size_t i = 0; i < messages.size(); i++) {
+            order[start[BUCKETS - 1 - bucket(messages[i].length)]++] = i;
+        }
+    }
+
+    // How many of the longest messages (order is longest first) to hash single-stream.
+    size_t single_stream_count(std::span<const Msg> messages, const std::vector<size_t>& order) const {
+        uint64_t lane_blocks = 0;
+        for (size_t i : order) {
+            lane_blocks += blocks(messages[i].length);
+        }
+        uint64_t calls = kernel_calls(messages, order, 0);
+        size_t p = 0;
+        while (p < order.size()) {
+            uint64_t longest = blocks(messages[order[p]].length);
+            // Taking it off the lanes shortens them by at most this much; skip replaying
+            // the schedule when even that would not pay for hashing it single-stream.
+            double shorter = calls - double(lane_blocks - longest) / LANES;
+            if (config.kernel_cost * shorter <= longest) {
+                break;
+            }
+            uint64_t next = kernel_calls(messages, order, p + 1);
+            if (longest + config.kernel_cost * next >= config.kernel_cost * calls) {
+                break;
+            }
+            lane_blocks -= longest;
+            calls = next;
+            p++;
+        }
+        return p;
+    }
+
+    // 8-lane compressions for order[first..] in queue order: each message goes to the
+    // lane that frees up first, as SM3_MultiBuffer::flush() hands them out.
+    static uint64_t kernel_calls(std::span<const Msg> messages, const std::vector<size_t>& order, size_t first) {
+        std::array<uint64_t, LANES> busy_until{};
+        for (size_t k = first; k < order.size(); k++) {
+            auto lane = std::min_element(busy_until.begin(), busy_until.end());
+            *lane += blocks(messages[order[k]].length);
+        }
+        return *std::max_element(busy_until.begin(), busy_until.end());
+    }
+
+    Config config;
+    Stats stats;
+};
+
+// One batch with the default configuration; returns its statistics.
+inline SM3_Batch::Stats sm3_hash_many(std::span<const SM3_Batch::Msg> messages,
+                                      std::span<SM3_Batch::Digest> digests) {
+    SM3_Batch batch;
+    batch.hash_many(messages, digests);
+    return batch.get_stats();
+}
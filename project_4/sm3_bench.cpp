@@ -0,0 +1,443 @@
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sm3.h"
+#include "sm3_dispatch.h"
+#include "sm3_multibuffer.h"
+#include "sm3_stage_timing.h"
+#include "sm3_tree.h"
+#include "sm3_x2.h"
+
+/**
+ * Benchmark harness over every SM3 implementation in this directory:
+ * - single-stream: the seven variant classes, sm3_digest(), the dispatcher and the
+ *   scalar one-shot kernel, one message at a time;
+ * - many-stream: 8 messages per flush on the multi-buffer engine, pairs on the 2-way
+ *   interleaved kernel, and one message through the parallel tree hash;
+ * - message sizes from 0 B up to --max-size (default 1 GiB), on both sides of the padding
+ *   boundaries and in powers of four above them;
+ * - warm cache (the input was just hashed) and cold cache (its lines are flushed before
+ *   every message).
+ *
+ * Before measuring, every mode must reproduce the published SM3 vectors ("abc" and
+ * "abcd" x 16, GB/T 32905) and the tree hash its "abc" known answer. Every digest
+ * produced while measuring is compared with the reference SM3 class (the tree hash with
+ * a single-threaded tree), and a divergence fails the run.
+ *
+ * Built with -DSM3_STAGE_TIMING, it first prints (and records under "stages") how each
+ * variant class's cycles split between message expansion, the W' array, the rounds,
+ * update() buffering and the rest, for 64-byte messages and one large buffer; the
+ * instrumented timings below are then slower by the cost of the scopes.
+ *
+ * Results are written as JSON, one record per mode, size and cache state: TSC cycles
+ * per byte, GB/s over the timed calls, and per-call latency percentiles (a call hashes
+ * all of a mode's streams, so for many-stream modes it is the time until every digest of
+ * the batch is ready). Progress and check marks go to stderr.
+ *
+ * Usage: sm3_bench.elf [--max-size BYTES[K|M|G]] [--budget BYTES[K|M|G]] [--json PATH]
+ *   --budget is the input volume timed per record (default 64M; at least 2 and at most
+ *   2000 calls). Without --json the report goes to stdout.
+ */
+
+using Clock = std::chrono::steady_clock;
+using Digest = std::array<uint8_t, 32>;
+
+static bool check(bool ok, const std::string& what) {
+    std::cerr << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+static std::string hex(const uint8_t* digest) {
+    std::stringstream ss;
+    for (int i = 0; i < 32; i++) {
+        ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(digest[i]);
+    }
+    return ss.str();
+}
+
+// One benchmarked implementation. run() hashes `streams` messages of one length, one
+// per input pointer, into consecutive 32-byte digests.
+struct Mode {
+    std::string name;
+    const char* kind;  // "single-stream" or "many-stream"
+    size_t streams;
+    bool tree;         // tree digests are compared with a single-threaded tree, not SM3
+    std::function<void(const uint8_t* const* in, size_t length, uint8_t* out)> run;
+};
+
+static std::vector<Mode> modes(SM3_TreeHash& tree) {
+    std::vector<Mode> all;
+    for (const auto& v : SM3_Dispatch::variants()) {
+        SM3_Dispatch::OneShot hash = v.hash;
+        all.push_back({v.name, "single-stream", 1, false,
+                       [hash](const uint8_t* const* in, size_t length, uint8_t* out) { hash(in[0], length, out); }});
+    }
+    all.push_back({"dispatch", "single-stream", 1, false, [](const uint8_t* const* in, size_t length, uint8_t* out) {
+                       SM3_Dispatch::shared().hash(in[0], length, out);
+                   }});
+    all.push_back({"x2_hash1", "single-stream", 1, false, [](const uint8_t* const* in, size_t length, uint8_t* out) {
+                       SM3_X2::hash1(in[0], length, out);
+                   }});
+    all.push_back({"x2_pairs", "many-stream", 2, false, [](const uint8_t* const* in, size_t length, uint8_t* out) {
+                       SM3_X2::hash2(in[0], length, in[1], length, out, out + 32);
+                   }});
+    if (SM3_MultiBuffer::is_supported()) {
+        all.push_back({"multibuffer_x8", "many-stream", SM3_MultiBuffer::LANES, false,
+                       [](const uint8_t* const* in, size_t length, uint8_t* out) {
+                           SM3_MultiBuffer mb;
+                           for (size_t s = 0; s < SM3_MultiBuffer::LANES; s++) {
+                               mb.submit(in[s], length, out + 32 * s);
+                           }
+                           mb.flush();
+                       }});
+    }
+    all.push_back({"tree_" + std::to_string(tree.threads()) + "t", "many-stream", 1, true,
+                   [&tree](const uint8_t* const* in, size_t length, uint8_t* out) {
+                       Digest d = tree.hash(in[0], length);
+                       std::memcpy(out, d.data(), 32);
+                   }});
+    return all;
+}
+
+static bool known_vectors(const std::vector<Mode>& all) {
+    std::string abc = "abc";
+    std::string abcd(64, ' ');
+    for (size_t i = 0; i < 64; i++) {
+        abcd[i] = "abcd"[i % 4];
+    }
+    bool ok = true;
+    for (const Mode& m : all) {
+        if (m.tree) {
+            continue;
+        }
+        for (const auto& [message, expected] :
+             {std::pair<std::string, std::string>{abc, "66c7f0f462eeedd9d1f2d46bdc10e4e24167c4875cf2f7a2297da02b8f4ba8e0"},
+              {abcd, "debe9ff92275b8a138604889c18e5a4d6fdb70e5387e5765293dcba39c0c5732"}}) {
+            std::vector<const uint8_t*> in(m.streams, reinterpret_cast<const uint8_t*>(message.data()));
+            std::vector<uint8_t> out(32 * m.streams);
+            m.run(in.data(), message.size(), out.data());
+            for (size_t s = 0; s < m.streams; s++) {
+                if (hex(out.data() + 32 * s) != expected) {
+                    check(false, m.name + " digest of a " + std::to_string(message.size()) + "-byte known vector");
+                    ok = false;
+                }
+            }
+        }
+    }
+    SM3_TreeHash default_tree;
+    Digest d = default_tree.hash(reinterpret_cast<const uint8_t*>(abc.data()), abc.size());
+    ok = ok && hex(d.data()) == "edc557905b97cfab85aa6514f7b0c2f0dc2d3666732b2b9c59546f3147b50c41";
+    return check(ok, "Every mode reproduces the SM3 known vectors (tree hash: its v1 answer)");
+}
+
+// TSC ticks per nanosecond, against the steady clock over 50 ms.
+static double tsc_per_ns() {
+    auto t0 = Clock::now();
+    uint64_t c0 = __rdtsc();
+    while (Clock::now() - t0 < std::chrono::milliseconds(50)) {
+    }
+    uint64_t c1 = __rdtsc();
+    return double(c1 - c0) / std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+static void flush_lines(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i += 64) {
+        _mm_clflush(data + i);
+    }
+    if (length > 0) {
+        _mm_clflush(data + length - 1);
+    }
+    _mm_mfence();
+}
+
+static bool parse_bytes(const char* text, size_t& out) {
+    char* end = nullptr;
+    unsigned long long v = std::strtoull(text, &end, 10);
+    if (end == text) {
+        return false;
+    }
+    switch (*end) {
+        case 'G': v <<= 10; [[fallthrough]];
+        case 'M': v <<= 10; [[fallthrough]];
+        case 'K': v <<= 10; end++; break;
+        default: break;
+    }
+    out = static_cast<size_t>(v);
+    return *end == '\0';
+}
+
+// Cycles per 64-byte block in each stage, for every variant class. The cost of the
+// scopes is measured first and taken off: each stage pays for its own scopes, and
+// Buffering, which encloses every engine scope, for the part of an inner scope that
+// falls outside it. What is left of the externally timed call is "other"
+// (construction, digest store, the call).
+static std::string stage_breakdown(const std::vector<uint8_t>& arena, size_t large) {
+    const int n = 100000;
+    double scope_cost = 1e30, outer_cost = 1e30;
+    for (int pass = 0; pass < 5; pass++) {
+        sm3_stage::reset();
+        for (int i = 0; i < n; i++) {
+            SM3_STAGE_SCOPE(Rounds);
+            asm volatile("" ::: "memory");
+        }
+        for (int i = 0; i < n; i++) {
+            SM3_STAGE_SCOPE(Buffering);
+            SM3_STAGE_SCOPE(Expansion);
+            asm volatile("" ::: "memory");
+        }
+        sm3_stage::Counters empty = sm3_stage::read();
+        scope_cost = std::min(scope_cost, double(empty.cycles[sm3_stage::Rounds]) / n);
+        outer_cost = std::min(outer_cost, double(empty.cycles[sm3_stage::Buffering]) / n);
+    }
+    const double nested_cost = std::max(0.0, outer_cost - scope_cost);
+
+    std::cerr << "Stage breakdown, TSC cycles per block (scope cost " << std::fixed << std::setprecision(1)
+              << scope_cost << " + " << nested_cost << " nested, subtracted):" << std::endl;
+    std::cerr << "  " << std::left << std::setw(20) << "variant" << std::right << std::setw(10) << "input";
+    for (const char* name : sm3_stage::NAMES) {
+        std::cerr << std::setw(11) << name;
+    }
+    std::cerr << std::setw(9) << "other" << std::setw(9) << "total" << std::endl;
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(1);
+    bool first = true;
+    uint8_t digest[32];
+    for (const auto& v : SM3_Dispatch::variants()) {
+        for (size_t length : {size_t(64), large}) {
+            const size_t messages = std::max<size_t>(1, (size_t(4) << 20) / (length + 64));
+            const size_t blocks = messages * ((length + 8) / 64 + 1);
+            uint64_t best_total = ~uint64_t(0);
+            sm3_stage::Counters best;
+            for (int pass = 0; pass < 3; pass++) {
+                sm3_stage::reset();
+                uint64_t t0 = __rdtsc();
+                for (size_t i = 0; i < messages; i++) {
+                    v.hash(arena.data(), length, digest);
+                    asm volatile("" : : "r"(digest) : "memory");
+                }
+                uint64_t total = __rdtsc() - t0;
+                if (total < best_total) {
+                    best_total = total;
+                    best = sm3_stage::read();
+                }
+            }
+            double per_block[sm3_stage::STAGES];
+            double total = double(best_total);
+            uint64_t inner = 0;
+            for (int st = 0; st < sm3_stage::STAGES; st++) {
+                inner += st == sm3_stage::Buffering ? 0 : best.calls[st];
+            }
+            for (int st = 0; st < sm3_stage::STAGES; st++) {
+                double overhead = scope_cost * best.calls[st] + (st == sm3_stage::Buffering ? nested_cost * inner : 0);
+                per_block[st] = std::max(0.0, best.cycles[st] - overhead) / blocks;
+                total -= overhead;
+            }
+            total = std::max(0.0, total) / blocks;
+            double other = total;
+            for (double stage : per_block) {
+                other -= stage;
+            }
+            other = std::max(0.0, other);
+
+            std::cerr << "  " << std::left << std::setw(20) << v.name << std::right << std::setw(10)
+                      << (length >= 1024 ? std::to_string(length >> 10) + " KiB" : std::to_string(length) + " B");
+            json << (first ? "\n" : ",\n") << "    {\"mode\": \"" << v.name << "\", \"bytes\": " << length
+                 << ", \"cycles_per_block\": {";
+            for (int st = 0; st < sm3_stage::STAGES; st++) {
+                std::cerr << std::setw(11) << per_block[st];
+                json << "\"" << sm3_stage::NAMES[st] << "\": " << per_block[st] << ", ";
+            }
+            std::cerr << std::setw(9) << other << std::setw(9) << total << std::endl;
+            json << "\"other\": " << other << ", \"total\": " << total << "}}";
+            first = false;
+        }
+    }
+    std::cerr << "  (opt2 computes W' in the rounds, opt4 and opt6 expand inside them: their expansion column"
+              << " is the block load only)" << std::endl;
+    return json.str();
+}
+
+struct Options {
+    size_t max_size = size_t(1) << 30;
+    size_t budget = size_t(64) << 20;
+    std::string json_path;
+};
+
+static bool parse_options(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--max-size" && i + 1 < argc) {
+            if (!parse_bytes(argv[++i], opts.max_size)) {
+                return false;
+            }
+        } else if (arg == "--budget" && i + 1 < argc) {
+            if (!parse_bytes(argv[++i], opts.budget) || opts.budget == 0) {
+                return false;
+            }
+        } else if (arg == "--json" && i + 1 < argc) {
+            opts.json_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::cerr << "usage: " << argv[0] << " [--max-size BYTES[K|M|G]] [--budget BYTES[K|M|G]] [--json PATH]"
+                  << std::endl;
+        return 2;
+    }
+
+    SM3_TreeHash tree;
+    SM3_TreeHash::Config serial_config;
+    serial_config.threads = 1;
+    SM3_TreeHash serial_tree(serial_config);
+    std::vector<Mode> all = modes(tree);
+    if (!known_vectors(all)) {
+        return 1;
+    }
+
+    std::vector<size_t> sizes;
+    for (size_t s : {0, 1, 16, 55, 56, 64, 119, 120, 256}) {
+        sizes.push_back(s);
+    }
+    for (size_t s = 1024; s <= (size_t(1) << 30); s *= 4) {
+        sizes.push_back(s);
+    }
+    sizes.erase(std::remove_if(sizes.begin(), sizes.end(), [&](size_t s) { return s > opts.max_size; }),
+                sizes.end());
+
+    // Many-stream inputs start one page apart past the largest message, wrapping back
+    // when the arena is too small for them to be disjoint.
+    const size_t arena_size = std::max<size_t>(opts.max_size, 1) + 8 * 4096;
+    std::vector<uint8_t> arena(arena_size);
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < arena_size; i++) {
+        x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+        arena[i] = static_cast<uint8_t>(x);
+    }
+    std::map<std::pair<size_t, size_t>, Digest> reference;
+    auto expected = [&](const Mode& m, size_t offset, size_t length) {
+        auto key = std::make_pair(offset, m.tree ? ~length : length);
+        auto it = reference.find(key);
+        if (it == reference.end()) {
+            Digest d;
+            if (m.tree) {
+                d = serial_tree.hash(arena.data() + offset, length);
+            } else {
+                SM3 h;
+                h.update(arena.data() + offset, length);
+                h.finalize(d.data());
+            }
+            it = reference.emplace(key, d).first;
+        }
+        return it->second;
+    };
+
+    const double ticks_per_ns = tsc_per_ns();
+    std::string stages;
+    if (sm3_stage::ENABLED) {
+        stages = stage_breakdown(arena, std::min<size_t>(opts.max_size, size_t(1) << 20));
+    }
+    std::ostringstream json;
+    json << std::fixed;
+    json << "{\n  \"cpu\": \"" << SM3_Dispatch::cpu_name() << "\",\n  \"tsc_ghz\": " << std::setprecision(3)
+         << ticks_per_ns << ",\n  \"stage_timing\": " << (sm3_stage::ENABLED ? "true" : "false")
+         << ",\n  \"stages\": [" << stages << (stages.empty() ? "" : "\n  ") << "],\n  \"results\": [";
+    bool ok = true, first = true;
+    for (const Mode& m : all) {
+        double warm_1k = 0, warm_large = 0;
+        for (size_t length : sizes) {
+            std::vector<const uint8_t*> in(m.streams);
+            std::vector<size_t> offsets(m.streams);
+            for (size_t s = 0; s < m.streams; s++) {
+                offsets[s] = s * (length / 4096 + 1) * 4096 % (arena_size - length + 1);
+                in[s] = arena.data() + offsets[s];
+            }
+            std::vector<uint8_t> out(32 * m.streams);
+            const size_t call_bytes = length * m.streams;
+            const size_t calls = std::clamp<size_t>(opts.budget / std::max<size_t>(call_bytes, 64), 2, 2000);
+            for (bool cold : {false, true}) {
+                std::vector<uint64_t> ticks(calls);
+                if (!cold) {
+                    m.run(in.data(), length, out.data());
+                }
+                for (size_t c = 0; c < calls; c++) {
+                    if (cold) {
+                        for (size_t s = 0; s < m.streams; s++) {
+                            flush_lines(in[s], length);
+                        }
+                    }
+                    uint64_t t0 = __rdtsc();
+                    m.run(in.data(), length, out.data());
+                    asm volatile("" : : "r"(out.data()) : "memory");
+                    ticks[c] = __rdtsc() - t0;
+                }
+                bool same = true;
+                for (size_t s = 0; s < m.streams; s++) {
+                    same = same && std::memcmp(out.data() + 32 * s, expected(m, offsets[s], length).data(), 32) == 0;
+                }
+                if (!same) {
+                    check(false, m.name + " diverges from the reference on " + std::to_string(length) + " bytes");
+                    ok = false;
+                }
+
+                uint64_t total = 0;
+                for (uint64_t t : ticks) {
+                    total += t;
+                }
+                std::sort(ticks.begin(), ticks.end());
+                auto pct = [&](double p) { return ticks[std::min(calls - 1, size_t(p * calls))] / ticks_per_ns; };
+                double seconds = total / ticks_per_ns / 1e9;
+                double gbps = double(call_bytes) * calls / seconds / 1e9;
+                if (!cold && length == 1024) {
+                    warm_1k = gbps;
+                }
+                if (!cold) {
+                    warm_large = gbps;
+                }
+                json << (first ? "\n" : ",\n") << "    {\"mode\": \"" << m.name << "\", \"kind\": \"" << m.kind
+                     << "\", \"streams\": " << m.streams << ", \"bytes\": " << length << ", \"cache\": \""
+                     << (cold ? "cold" : "warm") << "\", \"calls\": " << calls << ", \"digests_match\": "
+                     << (same ? "true" : "false") << ", \"cycles_per_byte\": ";
+                if (call_bytes > 0) {
+                    json << std::setprecision(3) << double(total) / (double(call_bytes) * calls);
+                } else {
+                    json << "null";
+                }
+                json << ", \"gb_per_s\": " << std::setprecision(4) << gbps << ", \"latency_ns\": {\"p50\": "
+                     << std::setprecision(1) << pct(0.5) << ", \"p90\": " << pct(0.9) << ", \"p99\": " << pct(0.99)
+                     << ", \"max\": " << ticks.back() / ticks_per_ns << "}}";
+                first = false;
+            }
+        }
+        std::cerr << "  " << std::left << std::setw(20) << m.name << std::right << std::fixed << std::setprecision(3)
+                  << "warm GB/s at 1 KiB " << std::setw(7) << warm_1k << ", at " << sizes.back() << " B "
+                  << std::setw(7) << warm_large << std::endl;
+    }
+    json << "\n  ],\n  \"ok\": " << (ok ? "true" : "false") << "\n}\n";
+
+    if (opts.json_path.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(opts.json_path, std::ios::trunc) << json.str();
+    }
+    return check(ok, "Every digest measured matches the reference") ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "opt6_vector_expand.h"
+#include "sm3.h"
+#include "sm3_digest.h"
+#include "sm3_x2.h"
+
+/**
+ * Stateless one-shot SM3 self-test and benchmark:
+ * - sm3_digest equals the reference SM3 class for every length 0..300 and for longer
+ *   inputs, from aligned and unaligned addresses;
+ * - nanoseconds per hash for 16..119-byte inputs against the SM3 class (update and
+ *   hex finalize), the vector-expansion class with a binary digest, the compile-time
+ *   length SM3::hash<N>, and the bare compression of the one or two padded blocks, which
+ *   is the floor for any one-shot hash.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static bool check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+// Nanoseconds per call over a pool of distinct inputs, for one pass.
+template <typename Fn>
+static double ns_per_hash(size_t length, Fn fn) {
+    const size_t pool = 256;
+    static std::vector<uint8_t> inputs, digests;
+    inputs.assign(pool * (length + 1), 0x5a);
+    digests.assign(pool * 32, 0);
+    const int count = 1 << 15;
+    auto t0 = Clock::now();
+    for (int i = 0; i < count; i++) {
+        size_t slot = i % pool;
+        fn(inputs.data() + slot * (length + 1), digests.data() + slot * 32);
+        asm volatile("" ::: "memory");
+    }
+    return std::chrono::duration<double>(Clock::now() - t0).count() / count * 1e9;
+}
+
+template <size_t N>
+static void benchmark() {
+    constexpr size_t blocks = (N + 8) / 64 + 1;
+    alignas(16) static uint8_t padded[64 * blocks] = {};
+    auto one_shot = [](const uint8_t* in, uint8_t* out) { sm3_digest(in, N, out); };
+    auto reference = [](const uint8_t* in, uint8_t* out) {
+        SM3 h;
+        h.update(in, N);
+        std::string hex = h.finalize();
+        out[0] = static_cast<uint8_t>(hex[0]);
+    };
+    auto streaming = [](const uint8_t* in, uint8_t* out) {
+        SM3_VectorExpand h;
+        h.update(in, N);
+        h.finalize(out);
+    };
+    auto fixed = [](const uint8_t* in, uint8_t* out) { SM3::hash<N>(in, out); };
+    auto floor = [](const uint8_t* in, uint8_t* out) {
+        uint32_t H[8] = {};
+        padded[0] = in[0];
+        for (size_t b = 0; b < blocks; b++) {
+            sm3_oneshot::compress(H, padded + 64 * b);
+        }
+        std::memcpy(out, H, 32);
+    };
+    // Passes alternate between the five so clock drift affects all of them alike.
+    double d = 1e30, r = 1e30, s = 1e30, f = 1e30, c = 1e30;
+    for (int pass = 0; pass < 20; pass++) {
+        d = std::min(d, ns_per_hash(N, one_shot));
+        r = std::min(r, ns_per_hash(N, reference));
+        s = std::min(s, ns_per_hash(N, streaming));
+        f = std::min(f, ns_per_hash(N, fixed));
+        c = std::min(c, ns_per_hash(N, floor));
+    }
+    std::cout << "  " << std::setw(4) << N << " B  " << std::fixed << std::setprecision(1) << "sm3_digest "
+              << std::setw(6) << d << " ns (" << std::setprecision(2) << d / c << "x floor)   SM3 class "
+              << std::setprecision(1) << std::setw(6) << r << " ns (" << std::setprecision(2) << r / d
+              << "x)   streaming " << std::setprecision(1) << std::setw(6) << s << " ns (" << std::setprecision(2)
+              << s / d << "x)   hash<N> " << std::setprecision(1) << std::setw(6) << f << " ns   floor "
+              << std::setw(6) << c << " ns (" << blocks << (blocks == 1 ? " block)" : " blocks)") << std::endl;
+}
+
+int main() {
+    std::mt19937_64 rng(49);
+    std::vector<uint8_t> data(5000 + 8);
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(rng());
+    }
+    bool all = true;
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t len = 0; len <= 5000; len += (len < 300 ? 1 : 469)) {
+            std::vector<uint8_t> m(data.begin() + offset, data.begin() + offset + len);
+            uint8_t digest[32];
+            sm3_digest(data.data() + offset, len, digest);
+            all = all && SM3_X2::to_hex(digest) == SM3::hash(m);
+        }
+    }
+    bool ok = check(all, "sm3_digest matches the reference for 0..300 bytes and longer inputs, at any alignment");
+    if (!ok) {
+        return 1;
+    }
+
+    std::cout << "One-shot hashing of independent inputs, best of 20 x 2^15 calls:" << std::endl;
+    benchmark<16>();
+    benchmark<32>();
+    benchmark<55>();
+    benchmark<64>();
+    benchmark<100>();
+    benchmark<119>();
+    return 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "sm3_round_engine.h"
+
+/**
+ * One-shot SM3 with no hasher object, for the short inputs that dominate most callers
+ * (tokens, keys, record fields of 16 to 100 bytes).
+ *
+ *     uint8_t digest[32];
+ *     sm3_digest(token.data(), token.size(), digest);
+ *
+ * Whole blocks are compressed straight from the input. The last length % 64 bytes are
+ * copied once into a zeroed 128-byte pair of blocks on the stack, followed by 0x80 and
+ * the bit length, and compressed as one block (up to 55 bytes left) or two. An input of
+ * at most 119 bytes is therefore one or two compressions and a copy: no heap, no carry
+ * buffer or length counter, no per-byte padding and no text formatting. The digest is
+ * written as 32 binary bytes.
+ *
+ * The compression is the engine's 16-word rolling window, fully unrolled (as in
+ * opt4_on_the_fly.h), which is the fastest schedule from cold on short inputs.
+ */
+namespace sm3_oneshot {
+
+inline void compress(uint32_t H[8], const uint8_t* block) {
+    sm3_engine::RollingWindow<8> w(block);
+    sm3_engine::compress<64>(H, w);
+}
+
+}  // namespace sm3_oneshot
+
+inline void sm3_digest(const void* data, size_t length, uint8_t out[32]) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    const size_t full = length / 64;
+    const size_t rest = length % 64;
+
+    alignas(16) uint8_t tail[128] = {};
+    if (rest > 0) {
+        std::memcpy(tail, in + 64 * full, rest);
+    }
+    tail[rest] = 0x80;
+    const size_t tail_blocks = rest < 56 ? 1 : 2;
+    uint64_t bits = __builtin_bswap64(static_cast<uint64_t>(length) * 8);
+    std::memcpy(tail + 64 * tail_blocks - 8, &bits, sizeof(bits));
+
+    uint32_t H[8] = {0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600,
+                     0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e};
+    // One loop over the input's blocks and then the tail's, so the unrolled rounds are
+    // emitted once.
+    for (size_t b = 0; b < full + tail_blocks; b++) {
+        sm3_oneshot::compress(H, b < full ? in + 64 * b : tail + 64 * (b - full));
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint32_t h = __builtin_bswap32(H[i]);
+        std::memcpy(out + 4 * i, &h, sizeof(h));
+    }
+}
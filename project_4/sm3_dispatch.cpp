@@ -0,0 +1,186 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sm3.h"
+#include "sm3_dispatch.h"
+
+/**
+ * Dispatcher self-test and benchmark:
+ * - every variant's one-shot entry point and the dispatcher hash messages of every size
+ *   class to the reference SM3 digests;
+ * - size classes split at their limits (55/56, 119/120, 1024/1025, 64 KiB);
+ * - a tuned profile is saved, and a second dispatcher loads it without tuning and picks
+ *   the same variants; profiles for another CPU, an older format, another variant list,
+ *   an unknown variant or a truncated file are rejected and re-tuned;
+ * - the tuned table, the tuning and loading times, and MB/s on a mixed-size workload for
+ *   the dispatcher against each variant used alone.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static bool check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+static std::string hex(const uint8_t digest[32]) {
+    std::stringstream ss;
+    for (int i = 0; i < 32; i++) {
+        ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(digest[i]);
+    }
+    return ss.str();
+}
+
+static void write_file(const std::string& path, const std::string& text) {
+    std::ofstream(path, std::ios::trunc) << text;
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Seconds to hash every message once with fn.
+template <typename Fn>
+static double workload_seconds(const std::vector<std::vector<uint8_t>>& messages, Fn fn) {
+    uint8_t digest[32];
+    auto t0 = Clock::now();
+    for (const auto& m : messages) {
+        fn(m.data(), m.size(), digest);
+        asm volatile("" : : "r"(digest) : "memory");
+    }
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+int main() {
+    std::mt19937_64 rng(46);
+    std::vector<std::vector<uint8_t>> messages;
+    for (size_t len : {0, 1, 31, 55, 56, 63, 64, 100, 119, 120, 500, 1024, 1025, 4096, 65536, 65537, 300000}) {
+        std::vector<uint8_t> m(len);
+        for (auto& b : m) {
+            b = static_cast<uint8_t>(rng());
+        }
+        messages.push_back(m);
+    }
+    std::vector<std::string> expected;
+    for (const auto& m : messages) {
+        expected.push_back(SM3::hash(m));
+    }
+
+    bool all = true;
+    for (const auto& v : SM3_Dispatch::variants()) {
+        for (size_t i = 0; i < messages.size(); i++) {
+            uint8_t digest[32];
+            v.hash(messages[i].data(), messages[i].size(), digest);
+            all = all && hex(digest) == expected[i];
+        }
+    }
+    bool ok = check(all, "Every variant's one-shot entry point matches the reference digests");
+
+    ok = check(SM3_Dispatch::size_class(0) == 0 && SM3_Dispatch::size_class(55) == 0 &&
+                   SM3_Dispatch::size_class(56) == 1 && SM3_Dispatch::size_class(119) == 1 &&
+                   SM3_Dispatch::size_class(120) == 2 && SM3_Dispatch::size_class(1024) == 2 &&
+                   SM3_Dispatch::size_class(1025) == 3 && SM3_Dispatch::size_class(65536) == 3 &&
+                   SM3_Dispatch::size_class(65537) == 4 && SM3_Dispatch::size_class(SIZE_MAX) == 4,
+               "Size classes split at 55/56, 119/120, 1024/1025 and 64 KiB") &&
+         ok;
+
+    char path[] = "/tmp/sm3_dispatch_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    unlink(path);
+    SM3_Dispatch::Config config;
+    config.profile_path = path;
+
+    auto t0 = Clock::now();
+    SM3_Dispatch tuned(config);
+    double tune_ms = std::chrono::duration<double>(Clock::now() - t0).count() * 1e3;
+    t0 = Clock::now();
+    SM3_Dispatch cached(config);
+    double load_ms = std::chrono::duration<double>(Clock::now() - t0).count() * 1e3;
+
+    all = true;
+    for (size_t i = 0; i < messages.size(); i++) {
+        all = all && tuned.hash(messages[i]) == expected[i] && cached.hash(messages[i]) == expected[i];
+    }
+    ok = check(all, "Dispatched hashes match the reference digests") && ok;
+    ok = check(!tuned.profile().from_cache && cached.profile().from_cache &&
+                   cached.profile().choice == tuned.profile().choice,
+               "A saved profile is loaded by the next dispatcher with the same choices") &&
+         ok;
+
+    std::string saved = read_file(path);
+    std::string other_cpu = saved;
+    other_cpu.replace(other_cpu.find("cpu ") + 4, 0, "other ");
+    std::string old_version = saved;
+    old_version.replace(0, saved.find('\n'), "sm3-dispatch 0");
+    // As written before sm3_digest was added: the variant list lacks it.
+    std::string fewer_variants = saved;
+    fewer_variants.erase(fewer_variants.find(" sm3_digest\n"), std::string(" sm3_digest").size());
+    std::string unknown_variant = saved;
+    unknown_variant.replace(unknown_variant.rfind(' ') + 1, std::string::npos, "opt9_future\n");
+    all = true;
+    for (const std::string& text : {other_cpu, old_version, fewer_variants, unknown_variant,
+                                    saved.substr(0, saved.size() / 2), std::string()}) {
+        write_file(path, text);
+        SM3_Dispatch::Profile p;
+        all = all && !SM3_Dispatch::load_profile(path, p) && !p.from_cache;
+        SM3_Dispatch retuned(config);
+        all = all && !retuned.profile().from_cache && read_file(path) != text;
+    }
+    ok = check(all, "Profiles for another CPU, format or variant set, or truncated, are re-tuned") && ok;
+    unlink(path);
+    if (!ok) {
+        return 1;
+    }
+
+    std::cout << "Tuned on " << tuned.profile().cpu << " in " << std::fixed << std::setprecision(1) << tune_ms
+              << " ms; loading the profile took " << std::setprecision(3) << load_ms << " ms" << std::endl;
+    for (size_t c = 0; c < SM3_Dispatch::SIZE_CLASSES; c++) {
+        std::string limit = SM3_Dispatch::CLASS_MAX[c] == SIZE_MAX
+                                ? "larger"
+                                : "<= " + std::to_string(SM3_Dispatch::CLASS_MAX[c]) + " B";
+        std::cout << "  " << std::left << std::setw(12) << limit << std::setw(20)
+                  << SM3_Dispatch::variants()[tuned.profile().choice[c]].name << std::right << std::setprecision(1)
+                  << std::setw(8) << tuned.profile().mbps[c] << " MB/s" << std::endl;
+    }
+
+    // Mostly short messages with a tail of large ones, as in a request log.
+    std::vector<std::vector<uint8_t>> workload;
+    size_t total = 0;
+    for (int i = 0; i < 4000; i++) {
+        size_t r = rng() % 100;
+        size_t len = r < 60 ? rng() % 120 : r < 90 ? 120 + rng() % 4000 : r < 99 ? 4096 + rng() % 60000
+                                                                                  : 65536 + rng() % 400000;
+        workload.emplace_back(len, static_cast<uint8_t>(i));
+        total += len;
+    }
+    const size_t n = SM3_Dispatch::VARIANTS;
+    std::vector<double> best(n + 1, 1e30);
+    // Passes alternate between the entries so clock drift affects all of them alike.
+    for (int pass = 0; pass < 5; pass++) {
+        best[n] = std::min(best[n], workload_seconds(workload, [&](const uint8_t* d, size_t l, uint8_t* out) {
+                               tuned.hash(d, l, out);
+                           }));
+        for (size_t v = 0; v < n; v++) {
+            best[v] = std::min(best[v], workload_seconds(workload, SM3_Dispatch::variants()[v].hash));
+        }
+    }
+    std::cout << "Mixed workload (" << workload.size() << " messages, " << total / 1024 << " KiB), best of 5:"
+              << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "dispatched" << std::right << std::setprecision(1)
+              << std::setw(8) << total / best[n] / 1e6 << " MB/s" << std::endl;
+    for (size_t v = 0; v < n; v++) {
+        std::cout << "  " << std::left << std::setw(20) << SM3_Dispatch::variants()[v].name << std::right
+                  << std::setw(8) << total / best[v] / 1e6 << " MB/s (" << std::setprecision(2)
+                  << best[v] / best[n] << "x dispatched)" << std::setprecision(1) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cpuid.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "opt1_unroll.h"
+#include "opt2_regalloc.h"
+#include "opt3_simd.h"
+#include "opt4_on_the_fly.h"
+#include "opt5_flatten.h"
+#include "opt6_vector_expand.h"
+#include "sm3.h"
+#include "sm3_digest.h"
+
+/**
+ * One SM3 entry point over every single-stream variant, picking the fastest one for this
+ * host per message-size class.
+ *
+ *     uint8_t digest[32];
+ *     SM3_Dispatch::shared().hash(data, length, digest);
+ *
+ * All seven variant classes and the stateless sm3_digest() are linked into the program
+ * under their own names. The first use microbenchmarks each of them on a representative
+ * length for every size class (one block, two blocks, up to 1 KiB, up to 64 KiB, larger)
+ * and keeps the winner of each class; a call then costs one table lookup on the length
+ * before the chosen variant runs.
+ *
+ * The result is saved as a small text profile, keyed by the CPU's brand string and
+ * listing the variants it was tuned over, and later processes load it instead of tuning
+ * again: from $SM3_DISPATCH_PROFILE if set, else ~/.cache/sm3_dispatch.profile. A
+ * profile from another CPU, an older format or a different set of variants is ignored
+ * and replaced, so a newly added variant is always tuned. Failing to read or write the
+ * profile only costs a re-tune; it never fails a hash.
+ */
+class SM3_Dispatch {
+public:
+    using OneShot = void (*)(const uint8_t* data, size_t length, uint8_t digest[32]);
+
+    struct Variant {
+        const char* name;
+        OneShot hash;
+    };
+
+    static constexpr int PROFILE_VERSION = 2;
+    static constexpr size_t VARIANTS = 8;
+    static constexpr size_t SIZE_CLASSES = 5;
+    // Largest length in each class, and the length each class is tuned on.
+    static constexpr size_t CLASS_MAX[SIZE_CLASSES] = {55, 119, 1024, 64 * 1024, SIZE_MAX};
+    static constexpr size_t CLASS_SAMPLE[SIZE_CLASSES] = {32, 100, 1024, 16 * 1024, 256 * 1024};
+
+    struct Config {
+        std::string profile_path;        // empty: default location; "-": never cache
+        size_t trial_bytes = 128 * 1024; // hashed per variant per trial
+        int trials = 5;
+    };
+
+    struct Profile {
+        std::string cpu;
+        std::array<uint8_t, SIZE_CLASSES> choice{};  // index into variants()
+        std::array<double, SIZE_CLASSES> mbps{};     // of the choice, when tuned here
+        bool from_cache = false;
+    };
+
+    SM3_Dispatch() : SM3_Dispatch(Config()) {}
+
+    explicit SM3_Dispatch(const Config& config) {
+        std::string path = config.profile_path.empty() ? default_profile_path() : config.profile_path;
+        if (path == "-" || !load_profile(path, profile_)) {
+            profile_ = tune(config);
+            if (path != "-") {
+                save_profile(path, profile_);
+            }
+        }
+        for (size_t c = 0; c < SIZE_CLASSES; c++) {
+            table[c] = variants()[profile_.choice[c]].hash;
+        }
+    }
+
+    // Process-wide dispatcher, tuned (or loaded) on first use.
+    static const SM3_Dispatch& shared() {
+        static const SM3_Dispatch instance;
+        return instance;
+    }
+
+    void hash(const uint8_t* data, size_t length, uint8_t digest[32]) const {
+        table[size_class(length)](data, length, digest);
+    }
+
+    std::string hash(const std::vector<uint8_t>& message) const {
+        uint8_t digest[32];
+        hash(message.data(), message.size(), digest);
+        std::stringstream ss;
+        for (uint8_t b : digest) {
+            ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
+        }
+        return ss.str();
+    }
+
+    const Profile& profile() const {
+        return profile_;
+    }
+
+    static size_t size_class(size_t length) {
+        size_t c = 0;
+        while (length > CLASS_MAX[c]) {
+            c++;
+        }
+        return c;
+    }
+
+    static const std::array<Variant, VARIANTS>& variants() {
+        static const std::array<Variant, VARIANTS> all = {{
+            {"sm3", &SM3::hash},
+            {"opt1_unroll", &SM3_Unrolled::hash},
+            {"opt2_regalloc", &SM3_RegAlloc::hash},
+            {"opt3_simd", &SM3_SIMD::hash},
+            {"opt4_on_the_fly", &SM3_OnTheFly::hash},
+            {"opt5_flatten", &SM3_Flatten::hash},
+            {"opt6_vector_expand", &SM3_VectorExpand::hash},
+            {"sm3_digest",
+             [](const uint8_t* data, size_t length, uint8_t digest[32]) { sm3_digest(data, length, digest); }},
+        }};
+        return all;
+    }
+
+    // Best of config.trials passes per variant and class; passes alternate between the
+    // variants so that clock drift affects all of them alike.
+    static Profile tune(const Config& config) {
+        using Clock = std::chrono::steady_clock;
+        Profile p;
+        p.cpu = cpu_name();
+        std::vector<uint8_t> input(CLASS_SAMPLE[SIZE_CLASSES - 1]);
+        for (size_t i = 0; i < input.size(); i++) {
+            input[i] = static_cast<uint8_t>(i * 131 + 7);
+        }
+        uint8_t digest[32] = {};
+        for (size_t c = 0; c < SIZE_CLASSES; c++) {
+            size_t length = CLASS_SAMPLE[c];
+            size_t calls = std::max<size_t>(1, config.trial_bytes / length);
+            std::array<double, VARIANTS> best;
+            best.fill(1e30);
+            for (int trial = 0; trial < config.trials; trial++) {
+                for (size_t v = 0; v < VARIANTS; v++) {
+                    auto t0 = Clock::now();
+                    for (size_t i = 0; i < calls; i++) {
+                        variants()[v].hash(input.data(), length, digest);
+                        asm volatile("" : : "r"(digest) : "memory");
+                    }
+                    best[v] = std::min(best[v], std::chrono::duration<double>(Clock::now() - t0).count());
+                }
+            }
+            size_t winner = std::min_element(best.begin(), best.end()) - best.begin();
+            p.choice[c] = static_cast<uint8_t>(winner);
+            p.mbps[c] = double(calls) * length / best[winner] / 1e6;
+        }
+        return p;
+    }
+
+    // Returns false, leaving p alone, unless path holds a complete profile for this CPU
+    // and this set of variants.
+    static bool load_profile(const std::string& path, Profile& p) {
+        std::ifstream in(path);
+        std::string magic, cpu_key, cpu;
+        int version = 0;
+        if (!(in >> magic >> version) || magic != "sm3-dispatch" || version != PROFILE_VERSION) {
+            return false;
+        }
+        in >> cpu_key >> std::ws;
+        if (cpu_key != "cpu" || !std::getline(in, cpu) || cpu != cpu_name()) {
+            return false;
+        }
+        std::string names;
+        if (!std::getline(in, names) || names != variant_list()) {
+            return false;
+        }
+        Profile loaded;
+        loaded.cpu = cpu;
+        loaded.from_cache = true;
+        for (size_t c = 0; c < SIZE_CLASSES; c++) {
+            std::string key, limit, name;
+            if (!(in >> key >> limit >> name) || key != "class" || limit != limit_text(c)) {
+                return false;
+            }
+            auto it = std::find_if(variants().begin(), variants().end(),
+                                   [&](const Variant& v) { return name == v.name; });
+            if (it == variants().end()) {
+                return false;
+            }
+            loaded.choice[c] = static_cast<uint8_t>(it - variants().begin());
+        }
+        p = loaded;
+        return true;
+    }
+
+    // Written to a temporary file and renamed into place, so a concurrent reader sees
+    // the old profile or the new one. Returns false if it could not be written.
+    static bool save_profile(const std::string& path, const Profile& p) {
+        std::string tmp = path + "." + std::to_string(getpid()) + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            out << "sm3-dispatch " << PROFILE_VERSION << "\n" << "cpu " << p.cpu << "\n" << variant_list() << "\n";
+            for (size_t c = 0; c < SIZE_CLASSES; c++) {
+                out << "class " << limit_text(c) << " " << variants()[p.choice[c]].name << "\n";
+            }
+            if (!out.flush()) {
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static std::string default_profile_path() {
+        if (const char* env = std::getenv("SM3_DISPATCH_PROFILE")) {
+            return env;
+        }
+        const char* home = std::getenv("HOME");
+        if (home == nullptr) {
+            return "-";
+        }
+        std::string dir = std::string(home) + "/.cache";
+        if (access(dir.c_str(), W_OK) != 0) {
+            return "-";
+        }
+        return dir + "/sm3_dispatch.profile";
+    }
+
+    static std::string cpu_name() {
+        unsigned int regs[12] = {};
+        if (__get_cpuid(0x80000000, &regs[0], &regs[1], &regs[2], &regs[3]) == 0 || regs[0] < 0x80000004) {
+            return "unknown";
+        }
+        for (unsigned int leaf = 0; leaf < 3; leaf++) {
+            __get_cpuid(0x80000002 + leaf, &regs[4 * leaf], &regs[4 * leaf + 1], &regs[4 * leaf + 2],
+                        &regs[4 * leaf + 3]);
+        }
+        std::string name(reinterpret_cast<const char*>(regs), sizeof(regs));
+        name.erase(std::find(name.begin(), name.end(), '\0'), name.end());
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        return name.empty() ? "unknown" : name;
+    }
+
+private:
+    // "variants <name> <name> ...", in table order.
+    static std::string variant_list() {
+        std::string line = "variants";
+        for (const Variant& v : variants()) {
+            line += " ";
+            line += v.name;
+        }
+        return line;
+    }
+
+    static std::string limit_text(size_t c) {
+        return CLASS_MAX[c] == SIZE_MAX ? "max" : std::to_string(CLASS_MAX[c]);
+    }
+
+    Profile profile_;
+    OneShot table[SIZE_CLASSES];
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../project_1/crypto_runtime/buffer_pool.h"
+
+/**
+ * File-path hashing driver shared by the command-line entry points.
+ *
+ *     std::string hex = sm3_file::hash_path<SM3_Flatten>("/var/log/big.img");
+ *
+ * Regular files are mapped read-only in 16 MiB windows with MADV_SEQUENTIAL, and each
+ * window goes straight into update(), so full blocks are compressed from the page cache
+ * without a copy. Only one window is mapped at a time. Pipes, terminals and other
+ * non-mappable descriptors are read in 1 MiB chunks into one pooled buffer. Memory use
+ * is the same for a 1 KiB file and a 10 GB one.
+ *
+ * A regular file is hashed up to the size fstat() reported when it was opened; a file
+ * truncated while it is being hashed faults like any other mapped read.
+ */
+namespace sm3_file {
+
+constexpr size_t READ_CHUNK_BYTES = 1024 * 1024;
+constexpr size_t MAP_WINDOW_BYTES = 16 * 1024 * 1024;
+
+[[noreturn]] inline void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+template <typename Hasher>
+void update_from_read(Hasher& hasher, int fd, const std::string& name) {
+    auto chunk = crypto_runtime::BufferPool::shared().acquire(READ_CHUNK_BYTES);
+    while (true) {
+        ssize_t n = read(fd, chunk.data(), READ_CHUNK_BYTES);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno(name);
+        }
+        if (n == 0) {
+            return;
+        }
+        hasher.update(chunk.data(), static_cast<size_t>(n));
+    }
+}
+
+template <typename Hasher>
+void update_from_fd(Hasher& hasher, int fd, const std::string& name) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw_errno(name);
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        update_from_read(hasher, fd, name);
+        return;
+    }
+
+    // Start from the current offset so that a redirected stdin that was partly consumed
+    // hashes the same bytes read() would return.
+    off_t start = lseek(fd, 0, SEEK_CUR);
+    if (start < 0) {
+        start = 0;
+    }
+    // At or past EOF read() returns nothing, and the window below would underflow.
+    if (start >= st.st_size) {
+        return;
+    }
+    const off_t page = sysconf(_SC_PAGESIZE);
+    off_t offset = start - start % page;
+    size_t skip = static_cast<size_t>(start - offset);
+    bool first = true;
+    while (offset < st.st_size) {
+        size_t len = static_cast<size_t>(std::min<off_t>(MAP_WINDOW_BYTES, st.st_size - offset));
+        void* map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, offset);
+        if (map == MAP_FAILED) {
+            // Some special files report S_ISREG but cannot be mapped; mmap() leaves the
+            // file offset alone, so read() still starts at the right byte.
+            if (first) {
+                update_from_read(hasher, fd, name);
+                return;
+            }
+            throw_errno(name);
+        }
+        madvise(map, len, MADV_SEQUENTIAL);
+        hasher.update(static_cast<const uint8_t*>(map) + skip, len - skip);
+        munmap(map, len);
+        offset += static_cast<off_t>(len);
+        skip = 0;
+        first = false;
+    }
+}
+
+// "-" hashes standard input. Throws std::system_error naming the path on failure.
+template <typename Hasher>
+std::string hash_path(const std::string& path) {
+    Hasher hasher;
+    if (path == "-") {
+        update_from_fd(hasher, STDIN_FILENO, path);
+        return hasher.finalize();
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno(path);
+    }
+    try {
+        update_from_fd(hasher, fd, path);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return hasher.finalize();
+}
+
+// Writes a checkpoint atomically: a crash leaves either the old file or the new one.
+inline void save_checkpoint(const std::string& path, const std::vector<uint8_t>& state) {
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw_errno(tmp);
+    }
+    bool ok = write(fd, state.data(), state.size()) == static_cast<ssize_t>(state.size()) && fsync(fd) == 0;
+    int saved = errno;
+    close(fd);
+    if (!ok) {
+        errno = saved;
+        throw_errno(tmp);
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        throw_errno(path);
+    }
+}
+
+// Returns false if there is no checkpoint at path.
+inline bool load_checkpoint(const std::string& path, std::vector<uint8_t>& state) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw_errno(path);
+    }
+    uint8_t buf[256];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    int saved = errno;
+    close(fd);
+    if (n < 0) {
+        errno = saved;
+        throw_errno(path);
+    }
+    state.assign(buf, buf + n);
+    return true;
+}
+
+/**
+ * Hashes a seekable file like hash_path(), saving the hasher's exported mid-state to
+ * checkpoint every checkpoint_bytes. If checkpoint already exists the job resumes from
+ * it, at the byte offset recorded in the state, instead of starting over. The
+ * checkpoint is removed once the digest is returned.
+ *
+ * The checkpoint records only the hash state, so each file needs its own checkpoint
+ * path, and the file must not change between the interrupted run and the resumed one.
+ */
+template <typename Hasher>
+std::string hash_path_resumable(const std::string& path, const std::string& checkpoint, uint64_t checkpoint_bytes) {
+    Hasher hasher;
+    std::vector<uint8_t> state;
+    if (load_checkpoint(checkpoint, state)) {
+        hasher.import_state(state.data(), state.size());
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno(path);
+    }
+    try {
+        if (lseek(fd, static_cast<off_t>(hasher.bytes_hashed()), SEEK_SET) < 0) {
+            throw_errno(path);
+        }
+        auto chunk = crypto_runtime::BufferPool::shared().acquire(READ_CHUNK_BYTES);
+        uint64_t next = hasher.bytes_hashed() + checkpoint_bytes;
+        while (true) {
+            ssize_t n = read(fd, chunk.data(), READ_CHUNK_BYTES);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw_errno(path);
+            }
+            if (n == 0) {
+                break;
+            }
+            hasher.update(chunk.data(), static_cast<size_t>(n));
+            if (hasher.bytes_hashed() >= next) {
+                save_checkpoint(checkpoint, hasher.export_state());
+                next = hasher.bytes_hashed() + checkpoint_bytes;
+            }
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    unlink(checkpoint.c_str());
+    return hasher.finalize();
+}
+
+/**
+ * Entry point for the per-variant programs. Without arguments the digest of standard
+ * input is printed on its own; with paths, one "digest  path" line per file. A file
+ * that cannot be read is reported on stderr and the exit status is 1.
+ */
+template <typename Hasher>
+int run_main(int argc, char** argv) {
+    if (argc < 2) {
+        try {
+            std::cout << hash_path<Hasher>("-") << std::endl;
+            return 0;
+        } catch (const std::system_error& e) {
+            std::cerr << argv[0] << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        try {
+            std::string digest = hash_path<Hasher>(argv[i]);
+            std::cout << digest << "  " << argv[i] << "\n";
+        } catch (const std::system_error& e) {
+            std::cout.flush();
+            std::cerr << argv[0] << ": " << e.what() << std::endl;
+            status = 1;
+        }
+    }
+    std::cout.flush();
+    return status;
+}
+
+}  // namespace sm3_file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+#include "opt6_vector_expand.h"
+
+/**
+ * SM3 of inputs whose length N is a compile-time constant: 32-byte digests of digests,
+ * 64-byte node pairs, 65-byte RFC 6962 nodes, fixed-size tokens.
+ *
+ *     uint8_t digest[32];
+ *     SM3_Fixed<65>::hash(node, digest);      // also SM3::hash<65>(node, digest)
+ *
+ * With N known, the padding is known too. The padded tail (the last N % 64 input bytes,
+ * 0x80, zeros and the bit length) is a constexpr template: a call merges the input bytes
+ * into it in registers and compresses. A tail block that holds no input at
+ * all - the last block when N % 64 is 0 or greater than 55 - is the same on every call,
+ * so its whole 68-word schedule W is computed at compile time and the compression skips
+ * both the load and the message expansion. There is no carry buffer, length counter or
+ * branch on the length; everything lives on the stack.
+ */
+template <size_t N>
+class SM3_Fixed {
+public:
+    static constexpr size_t LENGTH = N;
+    static constexpr size_t FULL_BLOCKS = N / 64;
+    static constexpr size_t REST = N % 64;
+    static constexpr size_t TAIL_BLOCKS = REST + 9 > 64 ? 2 : 1;
+    static constexpr size_t BLOCKS = FULL_BLOCKS + TAIL_BLOCKS;
+
+    static void hash(const uint8_t* data, uint8_t digest[32]) {
+        uint32_t H[8] = {0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600,
+                         0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e};
+        for (size_t b = 0; b < FULL_BLOCKS; b++) {
+            SM3_VectorExpand::compress(H, data + 64 * b);
+        }
+
+        if constexpr (REST > 0) {
+            // The first tail block carries the input bytes, so it is expanded per call.
+            const uint8_t* tail = data + 64 * FULL_BLOCKS;
+            const __m128i m[4] = {tail_chunk<0>(tail), tail_chunk<1>(tail), tail_chunk<2>(tail),
+                                  tail_chunk<3>(tail)};
+            SM3_VectorExpand::compress_chunks(H, m);
+        }
+        if constexpr (REST == 0 || TAIL_BLOCKS == 2) {
+            SM3_VectorExpand::compress_expanded(H, CONSTANT_SCHEDULE.data());
+        }
+
+        for (int i = 0; i < 8; i++) {
+            digest[4 * i + 0] = static_cast<uint8_t>(H[i] >> 24);
+            digest[4 * i + 1] = static_cast<uint8_t>(H[i] >> 16);
+            digest[4 * i + 2] = static_cast<uint8_t>(H[i] >> 8);
+            digest[4 * i + 3] = static_cast<uint8_t>(H[i]);
+        }
+    }
+
+private:
+    // Bytes 16K..16K+15 of the first tail block, built in a register: input bytes where
+    // the input reaches, the template's padding elsewhere. A partly filled chunk reads the
+    // input's last 16 bytes and shifts them into place (or, for inputs under 16 bytes,
+    // reads it as two integers), so nothing is read outside the input and the block never
+    // takes a round trip through a stack buffer, whose narrow stores the wide loads of the
+    // compression could not forward from.
+    template <size_t K>
+    static inline __attribute__((always_inline)) __m128i tail_chunk(const uint8_t* tail) {
+        constexpr size_t begin = 16 * K;
+        const __m128i pad = _mm_load_si128(reinterpret_cast<const __m128i*>(TAIL_TEMPLATE.data() + begin));
+        if constexpr (begin + 16 <= REST) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail + begin));
+        } else if constexpr (begin >= REST) {
+            return pad;
+        } else if constexpr (REST >= 16) {
+            __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail + REST - 16));
+            return _mm_or_si128(pad, _mm_srli_si128(last, 16 - (REST - begin)));
+        } else {
+            uint64_t lo = 0, hi = 0;
+            std::memcpy(&lo, tail, REST < 8 ? REST : 8);
+            if constexpr (REST > 8) {
+                std::memcpy(&hi, tail + 8, REST - 8);
+            }
+            return _mm_or_si128(pad, _mm_set_epi64x(static_cast<long long>(hi), static_cast<long long>(lo)));
+        }
+    }
+
+    // The tail blocks with zeros where the input goes.
+    static constexpr std::array<uint8_t, 128> padded_tail() {
+        std::array<uint8_t, 128> tail{};
+        tail[REST] = 0x80;
+        uint64_t bits = static_cast<uint64_t>(N) * 8;
+        for (size_t i = 0; i < 8; i++) {
+            tail[64 * TAIL_BLOCKS - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+        return tail;
+    }
+
+    static constexpr std::array<uint8_t, 64> first_tail_block() {
+        std::array<uint8_t, 128> tail = padded_tail();
+        std::array<uint8_t, 64> block{};
+        for (size_t i = 0; i < 64; i++) {
+            block[i] = tail[i];
+        }
+        return block;
+    }
+
+    static constexpr uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> ((32 - n) & 31));
+    }
+
+    // Full W[0..67] of the tail block that holds no input (the last one), with the room
+    // for 72 words the round function's layout expects.
+    static constexpr std::array<uint32_t, 72> constant_schedule() {
+        std::array<uint8_t, 128> tail = padded_tail();
+        size_t base = 64 * (TAIL_BLOCKS - 1);
+        std::array<uint32_t, 72> W{};
+        for (size_t i = 0; i < 16; i++) {
+            W[i] = uint32_t(tail[base + 4 * i]) << 24 | uint32_t(tail[base + 4 * i + 1]) << 16 |
+                   uint32_t(tail[base + 4 * i + 2]) << 8 | uint32_t(tail[base + 4 * i + 3]);
+        }
+        for (size_t j = 16; j < 68; j++) {
+            uint32_t x = W[j - 16] ^ W[j - 9] ^ rotl(W[j - 3], 15);
+            W[j] = (x ^ rotl(x, 15) ^ rotl(x, 23)) ^ rotl(W[j - 13], 7) ^ W[j - 6];
+        }
+        return W;
+    }
+
+    alignas(16) static constexpr std::array<uint8_t, 64> TAIL_TEMPLATE = first_tail_block();
+    alignas(16) static constexpr std::array<uint32_t, 72> CONSTANT_SCHEDULE = constant_schedule();
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../project_1/crypto_runtime/buffer_pool.h"
+#include "sm3_round_engine.h"
+#include "sm3_state.h"
+
+namespace sm3_engine {
+
+/**
+ * The streaming SM3 hasher every single-stream variant is built from: the 64-byte carry,
+ * the padding and the digest output are the same for all of them, and only the block
+ * compression differs. Schedule is one of the message schedules of sm3_round_engine.h,
+ * constructed from each 64-byte block, and Unroll the number of rounds per loop
+ * iteration passed to compress<Unroll>.
+ *
+ *     using SM3_Flatten = sm3_engine::Hasher<sm3_engine::Precomputed<sm3_engine::WPrime::Array, true>, 64>;
+ *
+ *     SM3_Flatten h;
+ *     h.update(data, length);
+ *     std::string digest = h.finalize();
+ */
+template <typename Schedule, size_t Unroll>
+class Hasher {
+public:
+    static constexpr size_t DIGEST_BYTES = 32;
+
+    Hasher() {
+        reset();
+    }
+
+    void reset() {
+        std::memcpy(H, IV, sizeof(H));
+        buffer_len = 0;
+        total_length = 0;
+    }
+
+    // Full blocks are compressed straight from the caller's memory; only a partial
+    // block is copied into the 64-byte carry.
+    void update(const uint8_t* data, size_t length) {
+        SM3_STAGE_SCOPE(Buffering);
+        total_length += length;
+        if (length == 0) {
+            return;
+        }
+
+        if (buffer_len > 0) {
+            size_t take = std::min(length, sizeof(buffer) - buffer_len);
+            std::memcpy(buffer + buffer_len, data, take);
+            buffer_len += take;
+            data += take;
+            length -= take;
+            if (buffer_len < sizeof(buffer)) {
+                return;
+            }
+            processBlock(buffer);
+            buffer_len = 0;
+        }
+
+        while (length >= 64) {
+            processBlock(data);
+            data += 64;
+            length -= 64;
+        }
+
+        std::memcpy(buffer, data, length);
+        buffer_len = length;
+    }
+
+    // Streams the rest of `in` through one pooled chunk instead of growing a vector
+    // with the whole input.
+    void update(std::istream& in) {
+        auto chunk = crypto_runtime::BufferPool::shared().acquire(STREAM_CHUNK_BYTES);
+        while (in) {
+            in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+            std::streamsize n = in.gcount();
+            if (n <= 0) {
+                break;
+            }
+            update(chunk.data(), static_cast<size_t>(n));
+        }
+    }
+
+    uint64_t bytes_hashed() const {
+        return total_length;
+    }
+
+    // Mid-state in the sm3_state version 1 format, for checkpointing a long job or
+    // handing a partial hash to another process.
+    std::vector<uint8_t> export_state() const {
+        return sm3_state::encode(H, buffer, buffer_len, total_length);
+    }
+
+    // Replaces this hasher's state; throws std::invalid_argument for a malformed state.
+    void import_state(const uint8_t* data, size_t length) {
+        sm3_state::decode(data, length, H, buffer, buffer_len, total_length);
+    }
+
+    // Binary digest, for callers that feed it into further hashing.
+    void finalize(uint8_t digest[DIGEST_BYTES]) {
+        padMessage();
+        for (int i = 0; i < 8; i++) {
+            digest[4 * i + 0] = static_cast<uint8_t>(H[i] >> 24);
+            digest[4 * i + 1] = static_cast<uint8_t>(H[i] >> 16);
+            digest[4 * i + 2] = static_cast<uint8_t>(H[i] >> 8);
+            digest[4 * i + 3] = static_cast<uint8_t>(H[i]);
+        }
+    }
+
+    std::string finalize() {
+        padMessage();
+
+        std::stringstream ss;
+        for (int i = 0; i < 8; i++) {
+            ss << std::hex << std::setfill('0') << std::setw(8) << H[i];
+        }
+
+        return ss.str();
+    }
+
+    // Binary digest of a complete message; the dispatcher's per-variant entry point.
+    static void hash(const uint8_t* data, size_t length, uint8_t digest[DIGEST_BYTES]) {
+        Hasher h;
+        h.update(data, length);
+        h.finalize(digest);
+    }
+
+    static std::string hash(const std::vector<uint8_t>& message) {
+        Hasher h;
+        h.update(message.data(), message.size());
+        return h.finalize();
+    }
+
+    static std::string hash_stream(std::istream& in) {
+        Hasher h;
+        h.update(in);
+        return h.finalize();
+    }
+
+private:
+    static constexpr uint32_t IV[8] = {
+        0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600,
+        0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e
+    };
+    static constexpr size_t STREAM_CHUNK_BYTES = 1024 * 1024;
+
+    void processBlock(const uint8_t* block) {
+        Schedule w(block);
+        compress<Unroll>(H, w);
+    }
+
+    // Pads the carried tail in place and compresses the final one or two blocks.
+    void padMessage() {
+        SM3_STAGE_SCOPE(Buffering);
+        uint64_t bit_length = total_length * 8;
+
+        buffer[buffer_len++] = 0x80;
+        if (buffer_len > 56) {
+            std::memset(buffer + buffer_len, 0, 64 - buffer_len);
+            processBlock(buffer);
+            buffer_len = 0;
+        }
+        std::memset(buffer + buffer_len, 0, 56 - buffer_len);
+
+        for (int i = 0; i < 8; i++) {
+            buffer[56 + i] = static_cast<uint8_t>((bit_length >> ((7 - i) * 8)) & 0xFF);
+        }
+        processBlock(buffer);
+        buffer_len = 0;
+    }
+
+    alignas(16) uint32_t H[8];
+
+    uint8_t buffer[64];
+    size_t buffer_len;
+    uint64_t total_length;
+};
+
+}  // namespace sm3_engine
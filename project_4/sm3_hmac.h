@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "opt6_vector_expand.h"
+#include "sm3_multibuffer.h"
+#include "sm3_state.h"
+#include "sm3_x2.h"
+
+/**
+ * HMAC-SM3 (RFC 2104 / GB/T 15852.2 construction with SM3) with the key blocks
+ * compressed once per key.
+ *
+ *     SM3_HMAC mac(key, key_len);
+ *     SM3_HMAC::Tag tag = mac.mac(request, request_len);
+ *     bool ok = mac.verify(request, request_len, received_tag);
+ *
+ * HMAC(K, m) = SM3((K0 ^ opad) || SM3((K0 ^ ipad) || m)), where K0 is the key padded to
+ * one 64-byte block (keys longer than that are hashed first). Both pad blocks are fixed
+ * per key, so the constructor compresses each once and keeps the two hasher states.
+ * A MAC then costs the message blocks plus the inner padding block, and one block for
+ * the outer hash, instead of re-hashing 128 bytes of key material per message.
+ *
+ * mac_many() and verify_many() run the inner hashes and then the outer hashes of a batch
+ * on the 8-lane multi-buffer engine, all lanes starting from the cached key states.
+ * Tags are compared in constant time; truncated tags are not accepted.
+ */
+class SM3_HMAC {
+public:
+    static constexpr size_t BLOCK_BYTES = 64;
+    static constexpr size_t TAG_BYTES = 32;
+
+    using Tag = std::array<uint8_t, TAG_BYTES>;
+
+    struct Message {
+        const uint8_t* data;
+        size_t length;
+    };
+
+    SM3_HMAC(const uint8_t* key, size_t key_length) {
+        uint8_t k0[BLOCK_BYTES] = {};
+        if (key_length > BLOCK_BYTES) {
+            SM3_X2::hash1(key, key_length, k0);
+        } else if (key_length > 0) {
+            std::memcpy(k0, key, key_length);
+        }
+        uint8_t pad[BLOCK_BYTES];
+        for (size_t i = 0; i < BLOCK_BYTES; i++) {
+            pad[i] = k0[i] ^ 0x36;
+        }
+        inner.update(pad, BLOCK_BYTES);
+        for (size_t i = 0; i < BLOCK_BYTES; i++) {
+            pad[i] = k0[i] ^ 0x5c;
+        }
+        outer.update(pad, BLOCK_BYTES);
+        wipe(k0, sizeof(k0));
+        wipe(pad, sizeof(pad));
+
+        // The same two states as raw chaining values, for the multi-buffer lanes.
+        uint8_t tail[BLOCK_BYTES];
+        size_t tail_len;
+        uint64_t total;
+        std::vector<uint8_t> state = inner.export_state();
+        sm3_state::decode(state.data(), state.size(), inner_h, tail, tail_len, total);
+        wipe(state.data(), state.size());
+        state = outer.export_state();
+        sm3_state::decode(state.data(), state.size(), outer_h, tail, tail_len, total);
+        wipe(state.data(), state.size());
+    }
+
+    ~SM3_HMAC() {
+        wipe(&inner, sizeof(inner));
+        wipe(&outer, sizeof(outer));
+        wipe(inner_h, sizeof(inner_h));
+        wipe(outer_h, sizeof(outer_h));
+    }
+
+    SM3_HMAC(const SM3_HMAC&) = default;
+    SM3_HMAC& operator=(const SM3_HMAC&) = default;
+
+    // Clones the cached states, so only the message and one outer block are compressed.
+    Tag mac(const uint8_t* data, size_t length) const {
+        Tag inner_digest, tag;
+        SM3_VectorExpand h = inner;
+        h.update(data, length);
+        h.finalize(inner_digest.data());
+        SM3_VectorExpand o = outer;
+        o.update(inner_digest.data(), TAG_BYTES);
+        o.finalize(tag.data());
+        return tag;
+    }
+
+    bool verify(const uint8_t* data, size_t length, const uint8_t tag[TAG_BYTES]) const {
+        return equal(mac(data, length).data(), tag, TAG_BYTES);
+    }
+
+    void mac_many(const Message* messages, size_t count, Tag* tags) const {
+        if (!SM3_MultiBuffer::is_supported()) {
+            for (size_t i = 0; i < count; i++) {
+                tags[i] = mac(messages[i].data, messages[i].length);
+            }
+            return;
+        }
+        std::vector<Tag> inner_digests(count);
+        SM3_MultiBuffer engine;
+        for (size_t i = 0; i < count; i++) {
+            engine.submit_from(inner_h, BLOCK_BYTES, messages[i].data, messages[i].length, inner_digests[i].data());
+        }
+        engine.flush();
+        for (size_t i = 0; i < count; i++) {
+            engine.submit_from(outer_h, BLOCK_BYTES, inner_digests[i].data(), TAG_BYTES, tags[i].data());
+        }
+        engine.flush();
+    }
+
+    // Checks tags[i] against messages[i] for the whole batch; valid[i] receives each
+    // result. Returns the number of valid tags.
+    size_t verify_many(const Message* messages, const Tag* tags, size_t count, bool* valid) const {
+        std::vector<Tag> computed(count);
+        mac_many(messages, count, computed.data());
+        size_t ok = 0;
+        for (size_t i = 0; i < count; i++) {
+            valid[i] = equal(computed[i].data(), tags[i].data(), TAG_BYTES);
+            ok += valid[i];
+        }
+        return ok;
+    }
+
+    // Constant-time comparison: the time depends only on n, not on where a and b differ.
+    static bool equal(const uint8_t* a, const uint8_t* b, size_t n) {
+        volatile uint8_t diff = 0;
+        for (size_t i = 0; i < n; i++) {
+            diff = diff | (a[i] ^ b[i]);
+        }
+        return diff == 0;
+    }
+
+    // Chaining values after the pad blocks, for kernels that drive the compression
+    // directly (PBKDF2 iterations).
+    const uint32_t* inner_chaining_value() const {
+        return inner_h;
+    }
+
+    const uint32_t* outer_chaining_value() const {
+        return outer_h;
+    }
+
+    static std::string to_hex(const Tag& tag) {
+        return SM3_X2::to_hex(tag.data());
+    }
+
+private:
+    static void wipe(void* p, size_t n) {
+        volatile uint8_t* v = static_cast<volatile uint8_t*>(p);
+        for (size_t i = 0; i < n; i++) {
+            v[i] = 0;
+        }
+    }
+
+    SM3_VectorExpand inner;  // after (K0 ^ ipad)
+    SM3_VectorExpand outer;  // after (K0 ^ opad)
+    uint32_t inner_h[8];
+    uint32_t outer_h[8];
+};
@@ -0,0 +1,273 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sm3.h"
+#include "sm3_merkle_log.h"
+
+/**
+ * SM3 Merkle log self-test and append benchmark:
+ * - known roots from an independent RFC 6962 model with SM3 as the hash;
+ * - every historical root equals the recursive definition over the stored leaves;
+ * - inclusion and consistency proofs for all (index, size) and (old, new) pairs up to
+ *   70 leaves verify, and fail for a wrong leaf, root or size, or a dropped proof node;
+ * - a file-backed log reopens with the same root and keeps growing like an in-memory one;
+ * - opening a foreign or corrupt file throws without leaking its descriptor or mapping;
+ * - append rate, interior hashes per append and proof cost for a large log.
+ *
+ * Usage: sm3_merkle_log.elf [leaves]   (default 1000000)
+ */
+
+using Clock = std::chrono::steady_clock;
+using Digest = SM3_MerkleLog::Digest;
+
+static bool check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+static std::string entry(uint64_t i) {
+    return "entry-" + std::to_string(i);
+}
+
+static void append_entries(SM3_MerkleLog& log, uint64_t from, uint64_t to) {
+    for (uint64_t i = from; i < to; i++) {
+        std::string e = entry(i);
+        log.append(reinterpret_cast<const uint8_t*>(e.data()), e.size());
+    }
+}
+
+static Digest from_hex(const std::string& hex) {
+    Digest out;
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = static_cast<uint8_t>(std::stoi(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    return out;
+}
+
+static bool known_answers() {
+    SM3_MerkleLog log;
+    const std::pair<uint64_t, const char*> expected[] = {
+        {0, "1ab21d8355cfa17f8e61194831e81a8f22bec8c728fefb747ed035eb5082aa2b"},
+        {1, "48dba5be78ac23c7c7a628e65e5608bf923a090ec8a21e66d6aeea23953b3fc4"},
+        {2, "35fbdce200db2544ff215748549c273fbff35c349d1bdae3407bf088de47c9bc"},
+        {3, "eb1ae160fe67a464eb3d3866d556797e611b87e3200e3e499aeba083e476f433"},
+        {7, "f0bb1afd6f9400b16dea8534b0107c60c91bdece4951dff4ebd06103064e3791"},
+        {1000, "df25430a09fe3705b0a5d2b46a7d87690ef7b25bb552cacc0ddca611b91b1a20"},
+    };
+    append_entries(log, 0, 1000);
+    bool ok = log.node_count(1000) == 2 * 1000 - 6;
+    for (const auto& [size, hex] : expected) {
+        ok = ok && SM3_MerkleLog::to_hex(log.root(size)) == hex;
+    }
+    return check(ok, "RFC 6962 roots match an independent model");
+}
+
+// MTH(d[begin..end)) from the recursive definition, with the reference SM3 class.
+static Digest reference_mth(const std::vector<Digest>& d, size_t begin, size_t end) {
+    if (end - begin == 1) {
+        return d[begin];
+    }
+    size_t m = 1;
+    while (2 * m < end - begin) {
+        m *= 2;
+    }
+    Digest left = reference_mth(d, begin, begin + m), right = reference_mth(d, begin + m, end);
+    std::vector<uint8_t> in = {0x01};
+    in.insert(in.end(), left.begin(), left.end());
+    in.insert(in.end(), right.begin(), right.end());
+    return from_hex(SM3::hash(in));
+}
+
+static bool roots_match_recursive_definition() {
+    SM3_MerkleLog log;
+    std::vector<Digest> leaves;
+    append_entries(log, 0, 300);
+    for (uint64_t n = 1; n <= 300; n++) {
+        leaves.push_back(log.leaf_at(n - 1));
+        if (log.root(n) != reference_mth(leaves, 0, leaves.size())) {
+            return check(false, "Root differs from the recursive definition at " + std::to_string(n) + " leaves");
+        }
+    }
+    return check(true, "Historical roots match the recursive definition for 1..300 leaves");
+}
+
+static bool proofs_verify() {
+    const uint64_t max_size = 70;
+    SM3_MerkleLog log;
+    append_entries(log, 0, max_size);
+    std::vector<Digest> roots(max_size + 1);
+    for (uint64_t n = 0; n <= max_size; n++) {
+        roots[n] = log.root(n);
+    }
+
+    bool ok = true;
+    for (uint64_t n = 1; n <= max_size && ok; n++) {
+        for (uint64_t i = 0; i < n && ok; i++) {
+            auto proof = log.inclusion_proof(i, n);
+            Digest leaf = log.leaf_at(i);
+            ok = SM3_MerkleLog::verify_inclusion(leaf, i, n, proof, roots[n]);
+            if (n > 1) {
+                ok = ok && !SM3_MerkleLog::verify_inclusion(log.leaf_at((i + 1) % n), i, n, proof, roots[n]) &&
+                     !SM3_MerkleLog::verify_inclusion(leaf, i, n, proof, roots[n - 1]);
+                auto shorter = proof;
+                shorter.pop_back();
+                ok = ok && !SM3_MerkleLog::verify_inclusion(leaf, i, n, shorter, roots[n]);
+            }
+        }
+    }
+    ok = check(ok, "Inclusion proofs verify for every leaf of every size up to 70") && ok;
+
+    bool consistent = true;
+    for (uint64_t n = 1; n <= max_size && consistent; n++) {
+        for (uint64_t m = 1; m <= n && consistent; m++) {
+            auto proof = log.consistency_proof(m, n);
+            consistent = SM3_MerkleLog::verify_consistency(m, n, roots[m], roots[n], proof);
+            if (m < n) {
+                consistent = consistent && !SM3_MerkleLog::verify_consistency(m, n, roots[m - 1], roots[n], proof) &&
+                             !SM3_MerkleLog::verify_consistency(m, n, roots[m], roots[n - 1], proof);
+                auto shorter = proof;
+                shorter.pop_back();
+                consistent = consistent && !SM3_MerkleLog::verify_consistency(m, n, roots[m], roots[n], shorter);
+            }
+        }
+    }
+    return check(consistent, "Consistency proofs verify for every pair of sizes up to 70") && ok;
+}
+
+static bool reopen_keeps_log() {
+    char path[] = "/tmp/sm3_merkle_log_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return check(false, "Could not create a temporary log file");
+    }
+    close(fd);
+
+    bool ok;
+    SM3_MerkleLog memory;
+    append_entries(memory, 0, 5000);
+    {
+        SM3_MerkleLog file(path);
+        append_entries(file, 0, 3000);  // grows the file past its initial capacity
+        file.sync();
+        ok = file.get_stats().remaps > 0;
+    }
+    {
+        SM3_MerkleLog file(path);
+        ok = ok && file.size() == 3000 && file.root() == memory.root(3000);
+        append_entries(file, 3000, 5000);
+    }
+    {
+        SM3_MerkleLog file(path);
+        ok = ok && file.size() == 5000 && file.root() == memory.root() &&
+             file.consistency_proof(3000, 5000) == memory.consistency_proof(3000, 5000);
+    }
+    unlink(path);
+    return check(ok, "A reopened file-backed log keeps its nodes and keeps growing");
+}
+
+// Open descriptors and mappings of this process.
+static std::pair<size_t, size_t> open_resources() {
+    size_t fds = 0, maps = 0;
+    for ([[maybe_unused]] const auto& entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+        fds++;
+    }
+    std::ifstream in("/proc/self/maps");
+    for (std::string line; std::getline(in, line);) {
+        maps++;
+    }
+    return {fds, maps};
+}
+
+static bool bad_files_do_not_leak() {
+    char path[] = "/tmp/sm3_merkle_log_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return check(false, "Could not create a temporary log file");
+    }
+    close(fd);
+    {
+        SM3_MerkleLog file(path);
+        append_entries(file, 0, 10);
+    }
+    std::string valid;
+    {
+        std::ifstream in(path, std::ios::binary);
+        valid.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::string foreign = valid, too_many = valid, wrapping = valid;
+    foreign[0] ^= 1;
+    too_many[16 + 7] = 0x01;  // leaf count far beyond the stored nodes
+    // 0x8000000000000001 leaves: 2n - popcount(n) wraps to 0 nodes.
+    wrapping.replace(16, 8, std::string("\x01\0\0\0\0\0\0\x80", 8));
+
+    bool ok = true;
+    auto before = open_resources();
+    for (const std::string& text :
+         {foreign, too_many, wrapping, valid.substr(0, SM3_MerkleLog::HEADER_BYTES + 5)}) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+        for (int i = 0; i < 50; i++) {
+            try {
+                SM3_MerkleLog file(path);
+                ok = false;
+            } catch (const std::runtime_error&) {
+            }
+        }
+    }
+    ok = ok && open_resources() == before;
+    unlink(path);
+    return check(ok, "Foreign and corrupt files are rejected without leaking descriptors or mappings");
+}
+
+int main(int argc, char** argv) {
+    bool ok = known_answers();
+    ok = roots_match_recursive_definition() && ok;
+    ok = proofs_verify() && ok;
+    ok = reopen_keeps_log() && ok;
+    ok = bad_files_do_not_leak() && ok;
+    if (!ok) {
+        return 1;
+    }
+
+    uint64_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    SM3_MerkleLog log;
+    std::mt19937_64 rng(1);
+    uint8_t record[100];
+    auto t0 = Clock::now();
+    for (uint64_t i = 0; i < count; i++) {
+        for (auto& b : record) {
+            b = static_cast<uint8_t>(rng());
+        }
+        log.append(record, sizeof(record));
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    const auto& stats = log.get_stats();
+    std::cout << count << " appends of 100-byte records: " << std::fixed << std::setprecision(0)
+              << count / seconds << " appends/s, " << std::setprecision(3)
+              << double(stats.node_hashes) / stats.appends << " interior hashes per append, "
+              << SM3_MerkleLog::node_count(count) * SM3_MerkleLog::NODE_BYTES / 1e6 << " MB of nodes" << std::endl;
+
+    const int proofs = 10000;
+    size_t proof_nodes = 0;
+    t0 = Clock::now();
+    Digest root = log.root();
+    for (int i = 0; i < proofs; i++) {
+        uint64_t index = rng() % count;
+        auto proof = log.inclusion_proof(index, count);
+        proof_nodes += proof.size();
+        if (!SM3_MerkleLog::verify_inclusion(log.leaf_at(index), index, count, proof, root)) {
+            std::cout << "✗ Inclusion proof for leaf " << index << " failed" << std::endl;
+            return 1;
+        }
+    }
+    seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::cout << proofs << " inclusion proofs built and verified: " << std::setprecision(2)
+              << seconds / proofs * 1e6 << " us each, " << std::setprecision(1) << double(proof_nodes) / proofs
+              << " nodes per proof" << std::endl;
+    return 0;
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "opt6_vector_expand.h"
+#include "sm3_fixed.h"
+
+/**
+ * Append-only Merkle tree over SM3 for audit logs, with RFC 6962 / RFC 9162 semantics:
+ * leaf = SM3(0x00 || entry), node = SM3(0x01 || left || right), and the root of n leaves
+ * splits at the largest power of two below n. Inclusion and consistency proofs are the
+ * RFC audit paths, so any RFC 9162 verifier with SM3 as the hash accepts them.
+ *
+ *     SM3_MerkleLog log("audit.mlog");          // created or reopened
+ *     uint64_t index = log.append(entry, len);
+ *     auto proof = log.inclusion_proof(index, log.size());
+ *
+ * Only the perfect subtrees are stored, in post-order, in one flat array of 32-byte
+ * digests: leaf i is followed by the roots its append completes, so appending leaf i
+ * writes 1 + trailing_ones(i) nodes and hashes only those (two on average, log2(n) at
+ * most). A log of n leaves holds 2n - popcount(n) nodes. The root and the proofs bag
+ * the O(log n) perfect subtrees ("peaks") on demand, and historical roots and proofs for
+ * any earlier size come from the same array, because appends never rewrite a node.
+ *
+ * A file-backed log is a 64-byte header followed by the node array, mapped MAP_SHARED
+ * and grown by doubling. The leaf count in the header is written after the nodes, so a
+ * crash mid-append reopens as the log before that append. sync() flushes to disk.
+ */
+class SM3_MerkleLog {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr size_t HEADER_BYTES = 64;
+    static constexpr size_t NODE_BYTES = 32;
+
+    struct Stats {
+        uint64_t appends = 0;
+        uint64_t node_hashes = 0;  // interior nodes hashed by appends
+        uint64_t remaps = 0;
+    };
+
+    // In-memory log backed by an anonymous mapping.
+    SM3_MerkleLog() {
+        map_region(-1, HEADER_BYTES + INITIAL_NODES * NODE_BYTES);
+        write_header(0);
+    }
+
+    // Opens the log at path, creating an empty one if the file does not exist.
+    explicit SM3_MerkleLog(const std::string& path) : path(path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        // The destructor does not run for a constructor that throws.
+        try {
+            open_file();
+        } catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~SM3_MerkleLog() {
+        release();
+    }
+
+    SM3_MerkleLog(const SM3_MerkleLog&) = delete;
+    SM3_MerkleLog& operator=(const SM3_MerkleLog&) = delete;
+
+    uint64_t size() const {
+        return leaves;
+    }
+
+    // Nodes stored for n leaves.
+    static uint64_t node_count(uint64_t n) {
+        return 2 * n - static_cast<uint64_t>(__builtin_popcountll(n));
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    static Digest leaf_hash(const uint8_t* entry, size_t length) {
+        const uint8_t prefix = 0x00;
+        SM3_VectorExpand h;
+        h.update(&prefix, 1);
+        h.update(entry, length);
+        Digest d;
+        h.finalize(d.data());
+        return d;
+    }
+
+    static Digest node_hash(const Digest& left, const Digest& right) {
+        uint8_t in[1 + 2 * NODE_BYTES];
+        in[0] = 0x01;
+        std::memcpy(in + 1, left.data(), NODE_BYTES);
+        std::memcpy(in + 1 + NODE_BYTES, right.data(), NODE_BYTES);
+        Digest d;
+        SM3_Fixed<sizeof(in)>::hash(in, d.data());
+        return d;
+    }
+
+    // Returns the index of the new leaf.
+    uint64_t append(const uint8_t* entry, size_t length) {
+        return append_leaf_hash(leaf_hash(entry, length));
+    }
+
+    uint64_t append_leaf_hash(const Digest& leaf) {
+        uint64_t index = leaves;
+        uint64_t pos = node_count(index);
+        unsigned merges = static_cast<unsigned>(__builtin_ctzll(~index));  // trailing ones
+        reserve(pos + 1 + merges);
+
+        Digest current = leaf;
+        store_node(pos++, current);
+        for (unsigned h = 0; h < merges; h++) {
+            // The left sibling of a height-h root is the node just before that root's subtree.
+            Digest left = load_node(pos - 1 - subtree_nodes(h));
+            current = node_hash(left, current);
+            store_node(pos++, current);
+        }
+        stats.node_hashes += merges;
+        stats.appends++;
+
+        leaves = index + 1;
+        write_header(leaves);
+        return index;
+    }
+
+    Digest root() const {
+        return root(leaves);
+    }
+
+    // Root of the first tree_size leaves, i.e. the root the log had at that size.
+    Digest root(uint64_t tree_size) const {
+        check_size(tree_size);
+        if (tree_size == 0) {
+            Digest d;
+            SM3_Fixed<0>::hash(nullptr, d.data());
+            return d;
+        }
+        return range_hash(0, tree_size);
+    }
+
+    // RFC 6962 PATH(index, D[0:tree_size]), leaf-to-root order.
+    std::vector<Digest> inclusion_proof(uint64_t index, uint64_t tree_size) const {
+        check_size(tree_size);
+        if (index >= tree_size) {
+            throw std::out_of_range("SM3_MerkleLog: leaf index outside the tree");
+        }
+        std::vector<Digest> proof;
+        audit_path(index, 0, tree_size, proof);
+        return proof;
+    }
+
+    // RFC 6962 PROOF(old_size, D[0:new_size]).
+    std::vector<Digest> consistency_proof(uint64_t old_size, uint64_t new_size) const {
+        check_size(new_size);
+        if (old_size > new_size) {
+            throw std::out_of_range("SM3_MerkleLog: old size larger than new size");
+        }
+        std::vector<Digest> proof;
+        if (old_size > 0 && old_size < new_size) {
+            subproof(old_size, 0, new_size, true, proof);
+        }
+        return proof;
+    }
+
+    Digest leaf_at(uint64_t index) const {
+        if (index >= leaves) {
+            throw std::out_of_range("SM3_MerkleLog: leaf index outside the log");
+        }
+        return load_node(node_count(index));
+    }
+
+    // RFC 9162 section 2.1.3.2.
+    static bool verify_inclusion(const Digest& leaf, uint64_t index, uint64_t tree_size,
+                                 const std::vector<Digest>& proof, const Digest& root) {
+        if (index >= tree_size) {
+            return false;
+        }
+        uint64_t fn = index, sn = tree_size - 1;
+        Digest r = leaf;
+        for (const Digest& p : proof) {
+            if (sn == 0) {
+                return false;
+            }
+            if ((fn & 1) || fn == sn) {
+                r = node_hash(p, r);
+                while (!(fn & 1) && fn != 0) {
+                    fn >>= 1;
+                    sn >>= 1;
+                }
+            } else {
+                r = node_hash(r, p);
+            }
+            fn >>= 1;
+            sn >>= 1;
+        }
+        return sn == 0 && r == root;
+    }
+
+    // RFC 9162 section 2.1.4.2.
+    static bool verify_consistency(uint64_t old_size, uint64_t new_size, const Digest& old_root,
+                                   const Digest& new_root, const std::vector<Digest>& proof) {
+        if (old_size > new_size) {
+            return false;
+        }
+        if (old_size == new_size) {
+            return proof.empty() && old_root == new_root;
+        }
+        if (old_size == 0) {
+            return proof.empty();
+        }
+        if (proof.empty()) {
+            return false;
+        }
+        std::vector<Digest> path;
+        if ((old_size & (old_size - 1)) == 0) {
+            path.push_back(old_root);
+        }
+        path.insert(path.end(), proof.begin(), proof.end());
+
+        uint64_t fn = old_size - 1, sn = new_size - 1;
+        while (fn & 1) {
+            fn >>= 1;
+            sn >>= 1;
+        }
+        Digest fr = path[0], sr = path[0];
+        for (size_t i = 1; i < path.size(); i++) {
+            const Digest& c = path[i];
+            if (sn == 0) {
+                return false;
+            }
+            if ((fn & 1) || fn == sn) {
+                fr = node_hash(c, fr);
+                sr = node_hash(c, sr);
+                while (!(fn & 1) && fn != 0) {
+                    fn >>= 1;
+                    sn >>= 1;
+                }
+            } else {
+                sr = node_hash(sr, c);
+            }
+            fn >>= 1;
+            sn >>= 1;
+        }
+        return fr == old_root && sr == new_root && sn == 0;
+    }
+
+    // Flushes a file-backed log to disk.
+    void sync() {
+        if (fd >= 0 && msync(base, mapped_bytes, MS_SYNC) != 0) {
+            fail_errno();
+        }
+    }
+
+    static std::string to_hex(const Digest& digest) {
+        std::stringstream ss;
+        for (uint8_t b : digest) {
+            ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
+        }
+        return ss.str();
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'S', 'M', '3', 'M', 'L', 'O', 'G', '\0'};
+    static constexpr uint64_t INITIAL_NODES = 1024;
+
+    // Nodes in a perfect subtree of height h.
+    static uint64_t subtree_nodes(unsigned h) {
+        return (uint64_t(2) << h) - 1;
+    }
+
+    // Post-order position of the root of the perfect subtree over leaves [first, first + 2^h).
+    static uint64_t subtree_root(uint64_t first, unsigned h) {
+        uint64_t end = first + (uint64_t(1) << h);
+        unsigned above = static_cast<unsigned>(__builtin_ctzll(end)) - h;  // merges after this root
+        return node_count(end) - 1 - above;
+    }
+
+    static uint64_t largest_power_below(uint64_t n) {
+        return uint64_t(1) << (63 - __builtin_clzll(n - 1));
+    }
+
+    // MTH(D[first:end]); first is always a multiple of the largest power of two below
+    // the range length, so a power-of-two range is one stored node.
+    Digest range_hash(uint64_t first, uint64_t end) const {
+        uint64_t n = end - first;
+        if ((n & (n - 1)) == 0) {
+            return load_node(subtree_root(first, static_cast<unsigned>(__builtin_ctzll(n))));
+        }
+        uint64_t k = largest_power_below(n);
+        return node_hash(range_hash(first, first + k), range_hash(first + k, end));
+    }
+
+    void audit_path(uint64_t m, uint64_t first, uint64_t end, std::vector<Digest>& proof) const {
+        uint64_t n = end - first;
+        if (n == 1) {
+            return;
+        }
+        uint64_t k = largest_power_below(n);
+        if (m < k) {
+            audit_path(m, first, first + k, proof);
+            proof.push_back(range_hash(first + k, end));
+        } else {
+            audit_path(m - k, first + k, end, proof);
+            proof.push_back(range_hash(first, first + k));
+        }
+    }
+
+    void subproof(uint64_t m, uint64_t first, uint64_t end, bool complete, std::vector<Digest>& proof) const {
+        uint64_t n = end - first;
+        if (m == n) {
+            if (!complete) {
+                proof.push_back(range_hash(first, end));
+            }
+            return;
+        }
+        uint64_t k = largest_power_below(n);
+        if (m <= k) {
+            subproof(m, first, first + k, complete, proof);
+            proof.push_back(range_hash(first + k, end));
+        } else {
+            subproof(m - k, first + k, end, false, proof);
+            proof.push_back(range_hash(first, first + k));
+        }
+    }
+
+    void check_size(uint64_t tree_size) const {
+        if (tree_size > leaves) {
+            throw std::out_of_range("SM3_MerkleLog: tree size larger than the log");
+        }
+    }
+
+    uint64_t capacity_nodes() const {
+        return (mapped_bytes - HEADER_BYTES) / NODE_BYTES;
+    }
+
+    Digest load_node(uint64_t pos) const {
+        Digest d;
+        std::memcpy(d.data(), base + HEADER_BYTES + pos * NODE_BYTES, NODE_BYTES);
+        return d;
+    }
+
+    void store_node(uint64_t pos, const Digest& d) {
+        std::memcpy(base + HEADER_BYTES + pos * NODE_BYTES, d.data(), NODE_BYTES);
+    }
+
+    void reserve(uint64_t nodes) {
+        if (nodes <= capacity_nodes()) {
+            return;
+        }
+        uint64_t capacity = capacity_nodes();
+        while (capacity < nodes) {
+            capacity *= 2;
+        }
+        size_t bytes = HEADER_BYTES + capacity * NODE_BYTES;
+        if (fd >= 0) {
+            grow_file(bytes);
+        }
+        void* p = mremap(base, mapped_bytes, bytes, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED) {
+            fail_errno();
+        }
+        base = static_cast<uint8_t*>(p);
+        mapped_bytes = bytes;
+        stats.remaps++;
+    }
+
+    void open_file() {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            fail_errno();
+        }
+        if (st.st_size == 0) {
+            grow_file(HEADER_BYTES + INITIAL_NODES * NODE_BYTES);
+            map_region(fd, HEADER_BYTES + INITIAL_NODES * NODE_BYTES);
+            write_header(0);
+            return;
+        }
+        size_t file_bytes = static_cast<size_t>(st.st_size);
+        if (file_bytes < HEADER_BYTES || (file_bytes - HEADER_BYTES) % NODE_BYTES != 0) {
+            fail("not an SM3 Merkle log");
+        }
+        map_region(fd, file_bytes);
+        if (std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0 || load_le32(base + 8) != FORMAT_VERSION) {
+            fail("not an SM3 Merkle log of format version 1");
+        }
+        leaves = load_le64(base + 16);
+        // node_count(n) >= n, and bounding n first keeps 2n from wrapping.
+        if (leaves > capacity_nodes() || node_count(leaves) > capacity_nodes()) {
+            fail("leaf count exceeds the stored nodes");
+        }
+    }
+
+    void release() {
+        if (base) {
+            munmap(base, mapped_bytes);
+            base = nullptr;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    void map_region(int file, size_t bytes) {
+        int flags = file >= 0 ? MAP_SHARED : MAP_PRIVATE | MAP_ANONYMOUS;
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, file, 0);
+        if (p == MAP_FAILED) {
+            fail_errno();
+        }
+        base = static_cast<uint8_t*>(p);
+        mapped_bytes = bytes;
+    }
+
+    void grow_file(size_t bytes) {
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            fail_errno();
+        }
+    }
+
+    // The header is little-endian: magic, u32 version, u32 header size, u64 leaf count.
+    void write_header(uint64_t leaf_count) {
+        std::memcpy(base, MAGIC, sizeof(MAGIC));
+        store_le32(base + 8, FORMAT_VERSION);
+        store_le32(base + 12, HEADER_BYTES);
+        // Nodes are written before the count that makes them part of the log.
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        store_le64(base + 16, leaf_count);
+    }
+
+    static void store_le32(uint8_t* p, uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            p[i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+    }
+
+    static void store_le64(uint8_t* p, uint64_t v) {
+        for (int i = 0; i < 8; i++) {
+            p[i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+    }
+
+    static uint32_t load_le32(const uint8_t* p) {
+        uint32_t v = 0;
+        for (int i = 3; i >= 0; i--) {
+            v = v << 8 | p[i];
+        }
+        return v;
+    }
+
+    static uint64_t load_le64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; i--) {
+            v = v << 8 | p[i];
+        }
+        return v;
+    }
+
+    [[noreturn]] void fail_errno() {
+        throw std::system_error(errno, std::generic_category(), path.empty() ? "SM3_MerkleLog" : path);
+    }
+
+    [[noreturn]] void fail(const std::string& what) {
+        throw std::runtime_error(path + ": " + what);
+    }
+
+    std::string path;
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t mapped_bytes = 0;
+    uint64_t leaves = 0;
+    Stats stats;
+};
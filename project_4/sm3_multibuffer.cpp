@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "sm3.h"
+#include "opt1_unroll.h"
+#include "opt2_regalloc.h"
+#include "opt3_simd.h"
+#include "opt4_on_the_fly.h"
+#include "opt5_flatten.h"
+#include "sm3_multibuffer.h"
+
+/**
+ * Checks SM3_MultiBuffer against the reference SM3 class for every length 0..300 and a
+ * random mix, then compares aggregate throughput on many small messages with each
+ * single-stream variant.
+ *
+ * Usage: sm3_multibuffer.elf [num_messages]   (default 100000, lengths 1..256 bytes)
+ */
+
+using Clock = std::chrono::steady_clock;
+
+struct Corpus {
+    std::vector<uint8_t> bytes;
+    std::vector<std::pair<size_t, size_t>> messages;  // offset, length
+};
+
+static Corpus make_corpus(size_t count, size_t min_len, size_t max_len, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> len_dist(min_len, max_len);
+    Corpus corpus;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = len_dist(rng);
+        corpus.messages.emplace_back(corpus.bytes.size(), len);
+        for (size_t j = 0; j < len; j++) {
+            corpus.bytes.push_back(static_cast<uint8_t>(rng()));
+        }
+    }
+    return corpus;
+}
+
+static bool check_against_reference() {
+    Corpus corpus;
+    for (size_t len = 0; len <= 300; len++) {
+        corpus.messages.emplace_back(corpus.bytes.size(), len);
+        for (size_t j = 0; j < len; j++) {
+            corpus.bytes.push_back(static_cast<uint8_t>(len * 31 + j));
+        }
+    }
+    Corpus mixed = make_corpus(1000, 0, 4096, 7);
+    for (auto& m : mixed.messages) {
+        corpus.messages.emplace_back(corpus.bytes.size(), m.second);
+        corpus.bytes.insert(corpus.bytes.end(), mixed.bytes.begin() + m.first, mixed.bytes.begin() + m.first + m.second);
+    }
+
+    std::vector<uint8_t> digests(corpus.messages.size() * 32);
+    SM3_MultiBuffer mb;
+    for (size_t i = 0; i < corpus.messages.size(); i++) {
+        mb.submit(corpus.bytes.data() + corpus.messages[i].first, corpus.messages[i].second, &digests[i * 32]);
+    }
+    mb.flush();
+
+    for (size_t i = 0; i < corpus.messages.size(); i++) {
+        const uint8_t* p = corpus.bytes.data() + corpus.messages[i].first;
+        std::vector<uint8_t> message(p, p + corpus.messages[i].second);
+        if (SM3_MultiBuffer::to_hex(&digests[i * 32]) != SM3::hash(message)) {
+            std::cout << "✗ Multi-buffer digest differs for message " << i << " (" << message.size() << " bytes)"
+                      << std::endl;
+            return false;
+        }
+    }
+    std::cout << "✓ Multi-buffer digests match SM3 for " << corpus.messages.size() << " messages" << std::endl;
+    return true;
+}
+
+template <typename Variant>
+static double time_single(const Corpus& corpus) {
+    auto t0 = Clock::now();
+    volatile size_t sink = 0;
+    for (auto& m : corpus.messages) {
+        Variant h;
+        h.update(corpus.bytes.data() + m.first, m.second);
+        sink += h.finalize()[0];
+    }
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static double time_multibuffer(const Corpus& corpus, SM3_MultiBuffer::Stats& stats) {
+    std::vector<uint8_t> digests(corpus.messages.size() * 32);
+    auto t0 = Clock::now();
+    SM3_MultiBuffer mb;
+    for (size_t i = 0; i < corpus.messages.size(); i++) {
+        mb.submit(corpus.bytes.data() + corpus.messages[i].first, corpus.messages[i].second, &digests[i * 32]);
+    }
+    mb.flush();
+    double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    stats = mb.get_stats();
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+    if (!SM3_MultiBuffer::is_supported()) {
+        std::cout << "AVX2 not supported on this CPU" << std::endl;
+        return 0;
+    }
+    if (!check_against_reference()) {
+        return 1;
+    }
+
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    Corpus corpus = make_corpus(count, 1, 256, 42);
+    double mb_total = corpus.bytes.size() / 1e6;
+
+    struct Row {
+        const char* name;
+        std::function<double(const Corpus&)> run;
+    };
+    std::vector<Row> rows = {
+        {"sm3", time_single<SM3>},
+        {"opt1_unroll", time_single<SM3_Unrolled>},
+        {"opt2_regalloc", time_single<SM3_RegAlloc>},
+        {"opt3_simd", time_single<SM3_SIMD>},
+        {"opt4_on_the_fly", time_single<SM3_OnTheFly>},
+        {"opt5_flatten", time_single<SM3_Flatten>},
+    };
+
+    std::cout << count << " messages, 1..256 bytes, " << std::fixed << std::setprecision(1) << mb_total << " MB"
+              << std::endl;
+    double best = 1e30;
+    for (auto& row : rows) {
+        double s = row.run(corpus);
+        best = std::min(best, s);
+        std::cout << "  " << std::left << std::setw(18) << row.name << std::right << std::setw(8) << mb_total / s
+                  << " MB/s" << std::setw(12) << count / s / 1e6 << " Mmsg/s" << std::endl;
+    }
+
+    SM3_MultiBuffer::Stats stats;
+    double s = time_multibuffer(corpus, stats);
+    std::cout << "  " << std::left << std::setw(18) << "multibuffer x8" << std::right << std::setw(8) << mb_total / s
+              << " MB/s" << std::setw(12) << count / s / 1e6 << " Mmsg/s" << std::endl;
+    std::cout << "Lane utilization: " << std::setprecision(1) << stats.lane_utilization() * 100 << "%, speedup over best single-stream: "
+              << std::setprecision(2) << best / s << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <immintrin.h>
+
+#include "sm3_round_engine.h"
+
+/**
+ * 8-lane AVX2 multi-buffer SM3.
+ *
+ * One SM3 compression is a serial chain of 64 rounds, so a single message cannot use
+ * more than a few ALU ports. For many independent messages the engine instead runs 8
+ * of them side by side: lane l of every __m256i holds message l, for the working
+ * variables A..H, the chaining value and the expanded W schedule.
+ *
+ * Messages are queued with submit() and hashed by flush(). Each lane walks its own
+ * message: full blocks are read straight from the caller's memory, and the padded
+ * final one or two blocks come from a per-lane tail buffer. When a lane finishes, its
+ * digest is written out and the lane immediately takes the next queued message, so
+ * messages of different lengths keep the lanes busy until the queue runs dry. Lanes
+ * with nothing to do compress a dummy block whose result is discarded.
+ *
+ * The round constants and FF / GG come from the single-stream engine
+ * (sm3_round_engine.h); only the rotations, and P0 / P1 built on them, are lane-wise
+ * AVX2 code, since __m256i has no 32-bit rotate operator.
+ */
+class SM3_MultiBuffer {
+public:
+    static constexpr size_t LANES = 8;
+    static constexpr size_t DIGEST_BYTES = 32;
+
+    struct Stats {
+        uint64_t messages = 0;
+        uint64_t kernel_calls = 0;      // 8-lane compressions
+        uint64_t busy_lane_blocks = 0;  // lane slots that carried a real block
+
+        double lane_utilization() const {
+            return kernel_calls ? static_cast<double>(busy_lane_blocks) / (kernel_calls * LANES) : 0.0;
+        }
+    };
+
+    static bool is_supported() {
+        return __builtin_cpu_supports("avx2");
+    }
+
+    // The message must stay valid until flush() returns; the digest is written then.
+    void submit(const uint8_t* data, size_t length, uint8_t digest[DIGEST_BYTES]) {
+        queue.push_back(Job{data, length, digest, IV, 0});
+    }
+
+    // As submit(), for a message whose first prefix_bytes (a multiple of 64) are already
+    // folded into the chaining value start, which must also stay valid until flush().
+    void submit_from(const uint32_t start[8], uint64_t prefix_bytes, const uint8_t* data, size_t length,
+                     uint8_t digest[DIGEST_BYTES]) {
+        queue.push_back(Job{data, length, digest, start, prefix_bytes});
+    }
+
+    void flush() {
+        while (true) {
+            size_t active = 0;
+            for (size_t l = 0; l < LANES; l++) {
+                if (!lanes[l].active && !queue.empty()) {
+                    assign(l, queue.front());
+                    queue.pop_front();
+                }
+                active += lanes[l].active;
+            }
+            if (active == 0) {
+                break;
+            }
+
+            const uint8_t* blocks[LANES];
+            for (size_t l = 0; l < LANES; l++) {
+                blocks[l] = lanes[l].active ? next_block(lanes[l]) : ZERO_BLOCK;
+            }
+            compress(state, blocks);
+            stats.kernel_calls++;
+            stats.busy_lane_blocks += active;
+
+            for (size_t l = 0; l < LANES; l++) {
+                Lane& lane = lanes[l];
+                if (lane.active && lane.remaining == 0 && lane.tail_next == lane.tail_blocks) {
+                    for (int i = 0; i < 8; i++) {
+                        uint32_t h = state[i][l];
+                        lane.digest[4 * i + 0] = static_cast<uint8_t>(h >> 24);
+                        lane.digest[4 * i + 1] = static_cast<uint8_t>(h >> 16);
+                        lane.digest[4 * i + 2] = static_cast<uint8_t>(h >> 8);
+                        lane.digest[4 * i + 3] = static_cast<uint8_t>(h);
+                    }
+                    lane.active = false;
+                    stats.messages++;
+                }
+            }
+        }
+    }
+
+    const Stats& get_stats() const {
+        return stats;
+    }
+
+    static std::string to_hex(const uint8_t digest[DIGEST_BYTES]) {
+        std::stringstream ss;
+        for (size_t i = 0; i < DIGEST_BYTES; i++) {
+            ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(digest[i]);
+        }
+        return ss.str();
+    }
+
+    /**
+     * One compression of 8 independent blocks. state[i][l] is chaining word i of lane l;
+     * blocks[l] points at lane l's 64-byte block.
+     */
+    static void compress(uint32_t state[8][LANES], const uint8_t* const blocks[LANES]) {
+        __m256i W[68];
+        load_message(blocks, W);
+        compress_words(state, W);
+    }
+
+    /**
+     * The same compression for blocks already given as message words: W[i] holds word i
+     * of every lane for i < 16, and W[16..67] is scratch. Callers that build blocks from
+     * chaining values, such as PBKDF2 iterations, skip the byte transpose this way.
+     */
+    static void compress_words(uint32_t state[8][LANES], __m256i W[68]) {
+        for (int j = 16; j < 68; j++) {
+            W[j] = P1(W[j - 16] ^ W[j - 9] ^ rotl(W[j - 3], 15)) ^ rotl(W[j - 13], 7) ^ W[j - 6];
+        }
+
+        __m256i A = load_row(state[0]), B = load_row(state[1]), C = load_row(state[2]), D = load_row(state[3]);
+        __m256i E = load_row(state[4]), F = load_row(state[5]), G = load_row(state[6]), H = load_row(state[7]);
+
+        for (int j = 0; j < 16; j++) {
+            round<true>(A, B, C, D, E, F, G, H, W[j], W[j] ^ W[j + 4], sm3_engine::T_ROTATED[j]);
+        }
+        for (int j = 16; j < 64; j++) {
+            round<false>(A, B, C, D, E, F, G, H, W[j], W[j] ^ W[j + 4], sm3_engine::T_ROTATED[j]);
+        }
+
+        store_row(state[0], load_row(state[0]) ^ A);
+        store_row(state[1], load_row(state[1]) ^ B);
+        store_row(state[2], load_row(state[2]) ^ C);
+        store_row(state[3], load_row(state[3]) ^ D);
+        store_row(state[4], load_row(state[4]) ^ E);
+        store_row(state[5], load_row(state[5]) ^ F);
+        store_row(state[6], load_row(state[6]) ^ G);
+        store_row(state[7], load_row(state[7]) ^ H);
+    }
+
+private:
+    static const uint32_t IV[8];
+    alignas(64) static const uint8_t ZERO_BLOCK[64];
+
+    struct Job {
+        const uint8_t* data;
+        size_t length;
+        uint8_t* digest;
+        const uint32_t* start;
+        uint64_t prefix_bytes;
+    };
+
+    struct Lane {
+        const uint8_t* data = nullptr;
+        size_t remaining = 0;  // bytes of full message blocks left to read from data
+        alignas(64) uint8_t tail[128];
+        size_t tail_blocks = 0;
+        size_t tail_next = 0;
+        uint8_t* digest = nullptr;
+        bool active = false;
+    };
+
+    static __m256i rotl(__m256i x, int n) {
+        return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+    }
+
+    static __m256i P0(__m256i x) {
+        return x ^ rotl(x, 9) ^ rotl(x, 17);
+    }
+
+    static __m256i P1(__m256i x) {
+        return x ^ rotl(x, 15) ^ rotl(x, 23);
+    }
+
+    static __m256i load_row(const uint32_t* row) {
+        return _mm256_load_si256(reinterpret_cast<const __m256i*>(row));
+    }
+
+    static void store_row(uint32_t* row, __m256i x) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(row), x);
+    }
+
+    // The engine's round on 8 lanes; FF and GG are the engine's, applied lane-wise.
+    template <bool Early>
+    static inline void round(__m256i& A, __m256i& B, __m256i& C, __m256i& D, __m256i& E, __m256i& F,
+                             __m256i& G, __m256i& H, __m256i w, __m256i w_prime, uint32_t t_rot) {
+        __m256i ff = sm3_engine::FF<Early>(A, B, C);
+        __m256i gg = sm3_engine::GG<Early>(E, F, G);
+        __m256i a12 = rotl(A, 12);
+        __m256i ss1 = rotl(_mm256_add_epi32(_mm256_add_epi32(a12, E), _mm256_set1_epi32(static_cast<int>(t_rot))), 7);
+        __m256i ss2 = ss1 ^ a12;
+        __m256i tt1 = _mm256_add_epi32(_mm256_add_epi32(ff, D), _mm256_add_epi32(ss2, w_prime));
+        __m256i tt2 = _mm256_add_epi32(_mm256_add_epi32(gg, H), _mm256_add_epi32(ss1, w));
+        D = C;
+        C = rotl(B, 9);
+        B = A;
+        A = tt1;
+        H = G;
+        G = rotl(F, 19);
+        F = E;
+        E = P0(tt2);
+    }
+
+    // 8x8 transpose of 32-bit words: row l (lane l's words k..k+7) becomes word k+i
+    // of every lane in r[i].
+    static void transpose8(__m256i r[8]) {
+        __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]), t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+        __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]), t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+        __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]), t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+        __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]), t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+        __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+        __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+        __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+        __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+        r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+        r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+        r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+        r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+        r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+        r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+        r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+        r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+    }
+
+    static void load_message(const uint8_t* const blocks[LANES], __m256i W[68]) {
+        const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                               3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        for (int half = 0; half < 2; half++) {
+            __m256i* r = W + 8 * half;
+            for (size_t l = 0; l < LANES; l++) {
+                r[l] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[l] + 32 * half));
+            }
+            transpose8(r);
+            for (int i = 0; i < 8; i++) {
+                r[i] = _mm256_shuffle_epi8(r[i], bswap);
+            }
+        }
+    }
+
+    void assign(size_t l, const Job& job) {
+        Lane& lane = lanes[l];
+        size_t full = job.length & ~size_t(63);
+        size_t rest = job.length - full;
+        lane.data = job.data;
+        lane.remaining = full;
+        lane.digest = job.digest;
+
+        std::memset(lane.tail, 0, sizeof(lane.tail));
+        if (rest > 0) {
+            std::memcpy(lane.tail, job.data + full, rest);
+        }
+        lane.tail[rest] = 0x80;
+        lane.tail_blocks = rest + 9 > 64 ? 2 : 1;
+        uint64_t bit_length = (job.prefix_bytes + job.length) * 8;
+        uint8_t* len_field = lane.tail + 64 * lane.tail_blocks - 8;
+        for (int i = 0; i < 8; i++) {
+            len_field[i] = static_cast<uint8_t>(bit_length >> ((7 - i) * 8));
+        }
+        lane.tail_next = 0;
+        lane.active = true;
+
+        for (int i = 0; i < 8; i++) {
+            state[i][l] = job.start[i];
+        }
+    }
+
+    static const uint8_t* next_block(Lane& lane) {
+        if (lane.remaining > 0) {
+            const uint8_t* block = lane.data;
+            lane.data += 64;
+            lane.remaining -= 64;
+            return block;
+        }
+        return lane.tail + 64 * lane.tail_next++;
+    }
+
+    alignas(32) uint32_t state[8][LANES] = {};
+    Lane lanes[LANES];
+    std::deque<Job> queue;
+    Stats stats;
+};
+
+inline const uint32_t SM3_MultiBuffer::IV[8] = {
+    0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600,
+    0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e
+};
+
+alignas(64) inline const uint8_t SM3_MultiBuffer::ZERO_BLOCK[64] = {};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "opt6_vector_expand.h"
+#include "sm3_hmac.h"
+#include "sm3_multibuffer.h"
+
+/**
+ * PBKDF2-HMAC-SM3 (RFC 8018) with the iterations of up to 8 output blocks run side by
+ * side on the multi-buffer SM3 kernel.
+ *
+ *     uint8_t key[32];
+ *     SM3_PBKDF2::derive(password, password_len, salt, salt_len, 100000, key, sizeof(key));
+ *
+ *     std::vector<SM3_PBKDF2::Job> logins = ...;   // several users at once
+ *     SM3_PBKDF2::derive_many(logins.data(), logins.size());
+ *
+ * Output block T_i = U_1 ^ ... ^ U_c with U_1 = HMAC(P, S || INT(i)) and U_j =
+ * HMAC(P, U_{j-1}). After U_1, every iteration is exactly two compressions: the inner one
+ * from the cached K^ipad state over U || padding, the outer one from the K^opad state
+ * over the inner digest || padding. Both messages are 96 bytes in total, so the second
+ * half of each block is a constant (0x80, zeros, bit length 768) and the first half is
+ * the previous chaining value, which never leaves word form.
+ *
+ * Every output block of every job is one task. Tasks run in the 8 lanes in lockstep, one
+ * iteration per step; a lane that finishes writes its block and takes the next task, so
+ * jobs with different iteration counts or output lengths keep the lanes full. A single
+ * task, or a CPU without AVX2, runs the same two-block iteration on the single-stream
+ * kernel instead.
+ */
+class SM3_PBKDF2 {
+public:
+    static constexpr size_t LANES = SM3_MultiBuffer::LANES;
+    static constexpr size_t BLOCK_OUTPUT_BYTES = 32;
+
+    struct Job {
+        const uint8_t* password;
+        size_t password_length;
+        const uint8_t* salt;
+        size_t salt_length;
+        uint32_t iterations;
+        uint8_t* out;
+        size_t out_length;
+    };
+
+    struct Stats {
+        uint64_t tasks = 0;
+        uint64_t lane_steps = 0;  // 8-lane iterations
+        uint64_t busy_lane_steps = 0;
+    };
+
+    static void derive(const uint8_t* password, size_t password_length, const uint8_t* salt, size_t salt_length,
+                       uint32_t iterations, uint8_t* out, size_t out_length) {
+        Job job{password, password_length, salt, salt_length, iterations, out, out_length};
+        derive_many(&job, 1);
+    }
+
+    // Throws std::invalid_argument for zero iterations or an impossible output length.
+    static Stats derive_many(const Job* jobs, size_t count) {
+        std::vector<SM3_HMAC> keys;
+        std::vector<Task> tasks;
+        keys.reserve(count);
+        for (size_t j = 0; j < count; j++) {
+            if (jobs[j].iterations == 0 || jobs[j].out_length == 0 ||
+                jobs[j].out_length > uint64_t(0xffffffff) * BLOCK_OUTPUT_BYTES) {
+                throw std::invalid_argument("SM3_PBKDF2: iterations and output length must be positive");
+            }
+            keys.emplace_back(jobs[j].password, jobs[j].password_length);
+            size_t blocks = (jobs[j].out_length + BLOCK_OUTPUT_BYTES - 1) / BLOCK_OUTPUT_BYTES;
+            for (size_t b = 1; b <= blocks; b++) {
+                tasks.push_back(Task{j, static_cast<uint32_t>(b)});
+            }
+        }
+
+        Stats stats;
+        stats.tasks = tasks.size();
+        if (tasks.size() == 1 || !SM3_MultiBuffer::is_supported()) {
+            for (const Task& t : tasks) {
+                run_scalar(jobs[t.job], keys[t.job], t.block);
+            }
+        } else {
+            run_lanes(jobs, keys, tasks, stats);
+        }
+        return stats;
+    }
+
+private:
+    struct Task {
+        size_t job;
+        uint32_t block;  // 1-based, as in INT(i)
+    };
+
+    // Bit length of a 96-byte message: one key block plus 32 bytes.
+    static constexpr uint32_t MESSAGE_BITS = (64 + 32) * 8;
+
+    static void first_u(const Job& job, const SM3_HMAC& key, uint32_t block, uint32_t u[8]) {
+        std::vector<uint8_t> msg(job.salt, job.salt + job.salt_length);
+        for (int i = 3; i >= 0; i--) {
+            msg.push_back(static_cast<uint8_t>(block >> (8 * i)));
+        }
+        SM3_HMAC::Tag t = key.mac(msg.data(), msg.size());
+        for (int i = 0; i < 8; i++) {
+            u[i] = uint32_t(t[4 * i]) << 24 | uint32_t(t[4 * i + 1]) << 16 | uint32_t(t[4 * i + 2]) << 8 | t[4 * i + 3];
+        }
+    }
+
+    static void store_words(const uint32_t w[8], uint8_t out[32]) {
+        for (int i = 0; i < 8; i++) {
+            out[4 * i + 0] = static_cast<uint8_t>(w[i] >> 24);
+            out[4 * i + 1] = static_cast<uint8_t>(w[i] >> 16);
+            out[4 * i + 2] = static_cast<uint8_t>(w[i] >> 8);
+            out[4 * i + 3] = static_cast<uint8_t>(w[i]);
+        }
+    }
+
+    static void store_output(const Job& job, uint32_t block, const uint32_t t[8]) {
+        uint8_t bytes[BLOCK_OUTPUT_BYTES];
+        store_words(t, bytes);
+        size_t offset = size_t(block - 1) * BLOCK_OUTPUT_BYTES;
+        std::memcpy(job.out + offset, bytes, std::min(BLOCK_OUTPUT_BYTES, job.out_length - offset));
+    }
+
+    static void run_scalar(const Job& job, const SM3_HMAC& key, uint32_t block) {
+        uint32_t u[8], t[8];
+        first_u(job, key, block, u);
+        std::memcpy(t, u, sizeof(t));
+
+        uint8_t msg[64] = {};
+        msg[32] = 0x80;
+        msg[62] = static_cast<uint8_t>(MESSAGE_BITS >> 8);
+        msg[63] = static_cast<uint8_t>(MESSAGE_BITS);
+        uint32_t s[8];
+        for (uint32_t it = 1; it < job.iterations; it++) {
+            store_words(u, msg);
+            std::memcpy(s, key.inner_chaining_value(), sizeof(s));
+            SM3_VectorExpand::compress(s, msg);
+            store_words(s, msg);
+            std::memcpy(u, key.outer_chaining_value(), sizeof(u));
+            SM3_VectorExpand::compress(u, msg);
+            for (int i = 0; i < 8; i++) {
+                t[i] ^= u[i];
+            }
+        }
+        store_output(job, block, t);
+    }
+
+    static void run_lanes(const Job* jobs, const std::vector<SM3_HMAC>& keys, const std::vector<Task>& tasks,
+                          Stats& stats) {
+        alignas(32) uint32_t inner[8][LANES] = {}, outer[8][LANES] = {};
+        alignas(32) uint32_t u[8][LANES] = {}, t[8][LANES] = {}, state[8][LANES];
+        uint32_t left[LANES] = {};
+        size_t lane_task[LANES] = {};
+        size_t next = 0;
+
+        const __m256i pad_word = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+        const __m256i length_word = _mm256_set1_epi32(static_cast<int>(MESSAGE_BITS));
+        __m256i W[68];
+
+        while (true) {
+            size_t active = 0;
+            for (size_t l = 0; l < LANES; l++) {
+                while (left[l] == 0 && next < tasks.size()) {
+                    const Task& task = tasks[next];
+                    const SM3_HMAC& key = keys[task.job];
+                    uint32_t u1[8];
+                    first_u(jobs[task.job], key, task.block, u1);
+                    for (int i = 0; i < 8; i++) {
+                        inner[i][l] = key.inner_chaining_value()[i];
+                        outer[i][l] = key.outer_chaining_value()[i];
+                        u[i][l] = t[i][l] = u1[i];
+                    }
+                    lane_task[l] = next++;
+                    left[l] = jobs[task.job].iterations - 1;
+                    if (left[l] == 0) {
+                        store_lane(jobs, tasks[lane_task[l]], t, l);
+                    }
+                }
+                active += left[l] != 0;
+            }
+            if (active == 0) {
+                break;
+            }
+
+            // Inner: K^ipad state over U || padding; outer: K^opad state over that digest.
+            std::memcpy(state, inner, sizeof(state));
+            for (int i = 0; i < 8; i++) {
+                W[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(u[i]));
+            }
+            W[8] = pad_word;
+            for (int i = 9; i < 15; i++) {
+                W[i] = _mm256_setzero_si256();
+            }
+            W[15] = length_word;
+            SM3_MultiBuffer::compress_words(state, W);
+
+            for (int i = 0; i < 8; i++) {
+                W[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[i]));
+            }
+            W[8] = pad_word;
+            for (int i = 9; i < 15; i++) {
+                W[i] = _mm256_setzero_si256();
+            }
+            W[15] = length_word;
+            std::memcpy(u, outer, sizeof(u));
+            SM3_MultiBuffer::compress_words(u, W);
+
+            for (int i = 0; i < 8; i++) {
+                __m256i acc = _mm256_load_si256(reinterpret_cast<const __m256i*>(t[i]));
+                __m256i ui = _mm256_load_si256(reinterpret_cast<const __m256i*>(u[i]));
+                _mm256_store_si256(reinterpret_cast<__m256i*>(t[i]), _mm256_xor_si256(acc, ui));
+            }
+            stats.lane_steps++;
+            stats.busy_lane_steps += active;
+
+            for (size_t l = 0; l < LANES; l++) {
+                if (left[l] != 0 && --left[l] == 0) {
+                    store_lane(jobs, tasks[lane_task[l]], t, l);
+                }
+            }
+        }
+    }
+
+    static void store_lane(const Job* jobs, const Task& task, const uint32_t t[8][LANES], size_t l) {
+        uint32_t column[8];
+        for (int i = 0; i < 8; i++) {
+            column[i] = t[i][l];
+        }
+        store_output(jobs[task.job], task.block, column);
+    }
+};
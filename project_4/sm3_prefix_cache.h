@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "opt6_vector_expand.h"
+
+/**
+ * LRU cache of SM3 states after common message prefixes, so that messages sharing a
+ * long fixed header only compress their own suffix.
+ *
+ *     SM3_PrefixCache<> cache;
+ *     SM3_VectorExpand h = cache.begin(header, header_len);   // prefix already absorbed
+ *     h.update(body, body_len);
+ *     std::string digest = h.finalize();
+ *
+ * The snapshot is simply a copy of the hasher: the SM3 classes are plain values holding
+ * the chaining value, the partial-block carry and the length, so copying one forks the
+ * computation at that point (export_state() gives the same thing as bytes). The cache
+ * is keyed by the prefix bytes themselves, so a lookup costs one std::hash of the prefix
+ * and one compare, and a hit can never return the state of a different prefix.
+ *
+ * Only whole 64-byte blocks of a prefix are work that can be saved; a prefix shorter than
+ * one block (such as SM2's 32-byte Z_A) is only copied into the carry either way.
+ * Thread-safe; the lock covers the lookup and the copy-out, not the hashing of a miss.
+ */
+template <typename Hasher = SM3_VectorExpand>
+class SM3_PrefixCache {
+public:
+    struct Config {
+        size_t capacity = 1024;          // prefixes kept
+        size_t min_prefix_bytes = 64;    // shorter prefixes are hashed, not cached
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t bytes_skipped = 0;  // prefix bytes not re-hashed thanks to hits
+    };
+
+    SM3_PrefixCache() : SM3_PrefixCache(Config()) {}
+    explicit SM3_PrefixCache(Config config) : config(config) {}
+
+    // A hasher that has absorbed prefix, cloned from the cache when the prefix is known.
+    Hasher begin(const uint8_t* prefix, size_t length) {
+        if (length < config.min_prefix_bytes || config.capacity == 0) {
+            Hasher h;
+            h.update(prefix, length);
+            return h;
+        }
+        std::string_view key(reinterpret_cast<const char*>(prefix), length);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end()) {
+                entries.splice(entries.begin(), entries, it->second);
+                stats.hits++;
+                stats.bytes_skipped += length;
+                return it->second->second;
+            }
+            stats.misses++;
+        }
+
+        Hasher h;
+        h.update(prefix, length);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.find(key) == index.end()) {
+            entries.emplace_front(std::string(key), h);
+            index.emplace(entries.front().first, entries.begin());
+            if (entries.size() > config.capacity) {
+                index.erase(entries.back().first);
+                entries.pop_back();
+                stats.evictions++;
+            }
+        }
+        return h;
+    }
+
+    std::string hash(const uint8_t* prefix, size_t prefix_length, const uint8_t* suffix, size_t suffix_length) {
+        Hasher h = begin(prefix, prefix_length);
+        h.update(suffix, suffix_length);
+        return h.finalize();
+    }
+
+    bool contains(const uint8_t* prefix, size_t length) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return index.count(std::string_view(reinterpret_cast<const char*>(prefix), length)) != 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    Stats get_stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        index.clear();
+        entries.clear();
+    }
+
+private:
+    // Most recently used first; the index keys view the strings owned by the list.
+    using Entry = std::pair<std::string, Hasher>;
+
+    Config config;
+    mutable std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_map<std::string_view, typename std::list<Entry>::iterator> index;
+    Stats stats;
+};
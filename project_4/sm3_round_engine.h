@@ -0,0 +1,350 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "sm3_stage_timing.h"
+
+/**
+ * The SM3 compression function generated at compile time, shared by every single-stream
+ * variant in this directory.
+ *
+ *     sm3_engine::Precomputed<sm3_engine::WPrime::Array> w(block);
+ *     sm3_engine::compress<64>(H, w);          // 64 rounds of straight-line code
+ *
+ * The rounds are expanded from a std::index_sequence, so wherever the unroll factor
+ * allows, the round index j is a template argument: FF and GG are chosen with if
+ * constexpr (XOR for rounds 0..15, majority / choose for 16..63) and Tj <<< (j mod 32)
+ * is read from a constexpr table of the 64 pre-rotated constants.
+ *
+ * A variant is two policies:
+ * - the message schedule, which decides where W[j] and W'[j] = W[j] ^ W[j+4] come from
+ *   and when they are computed: all before round 0, a few rounds ahead in a 16-word
+ *   window, or on vectors alongside the rounds. Schedules provide prepare(j), called before round j, and
+ *   w(j) / w_prime(j);
+ * - Unroll, the number of rounds emitted per loop iteration: 1, 2, 4, 8, 16 or 64. 64 is
+ *   straight-line code with every constant folded in; smaller factors give smaller code
+ *   that reads Tj from the table by a loop index. Groups never straddle round 16, so
+ *   FF and GG stay compile-time choices at every factor.
+ *
+ * With -DSM3_STAGE_TIMING the expansion, the W' array and the rounds are timed as
+ * separate stages (sm3_stage_timing.h); without it the scopes compile to nothing.
+ */
+namespace sm3_engine {
+
+// Masked so that a rotation by 0 stays defined.
+constexpr uint32_t rotl(uint32_t x, int n) {
+    return (x << (n & 31)) | (x >> ((32 - n) & 31));
+}
+
+constexpr uint32_t P0(uint32_t x) {
+    return x ^ rotl(x, 9) ^ rotl(x, 17);
+}
+
+constexpr uint32_t P1(uint32_t x) {
+    return x ^ rotl(x, 15) ^ rotl(x, 23);
+}
+
+constexpr std::array<uint32_t, 64> rotated_round_constants() {
+    std::array<uint32_t, 64> t{};
+    for (int j = 0; j < 64; j++) {
+        t[j] = rotl(j < 16 ? 0x79cc4519U : 0x7a879d8aU, j % 32);
+    }
+    return t;
+}
+
+// Tj <<< (j mod 32) for j = 0..63.
+inline constexpr std::array<uint32_t, 64> T_ROTATED = rotated_round_constants();
+
+// W[j] = P1(W[j-16] ^ W[j-9] ^ (W[j-3] <<< 15)) ^ (W[j-13] <<< 7) ^ W[j-6]
+inline uint32_t expand(const uint32_t* W, int j) {
+    return P1(W[j - 16] ^ W[j - 9] ^ rotl(W[j - 3], 15)) ^ rotl(W[j - 13], 7) ^ W[j - 6];
+}
+
+inline void load_words(const uint8_t* block, uint32_t W[16]) {
+    for (int i = 0; i < 16; i++) {
+        uint32_t v;
+        std::memcpy(&v, block + 4 * i, sizeof(v));
+        W[i] = __builtin_bswap32(v);
+    }
+}
+
+struct State {
+    uint32_t A, B, C, D, E, F, G, H;
+};
+
+// The boolean functions; Early selects the XOR forms used in rounds 0..15. They use
+// bitwise operators only, so they also apply lane-wise to vector words (the 8-lane
+// engine in sm3_multibuffer.h).
+template <bool Early, typename Word>
+inline __attribute__((always_inline)) Word FF(Word x, Word y, Word z) {
+    if constexpr (Early) {
+        return x ^ y ^ z;
+    } else {
+        return (x & y) | ((x | y) & z);
+    }
+}
+
+template <bool Early, typename Word>
+inline __attribute__((always_inline)) Word GG(Word x, Word y, Word z) {
+    if constexpr (Early) {
+        return x ^ y ^ z;
+    } else {
+        return (x & y) | (~x & z);
+    }
+}
+
+// One round; Early selects the XOR forms of FF and GG used in rounds 0..15.
+template <bool Early>
+inline __attribute__((always_inline)) void round(State& s, uint32_t t, uint32_t w, uint32_t w_prime) {
+    uint32_t rot_A_12 = rotl(s.A, 12);
+    uint32_t SS1 = rotl(rot_A_12 + s.E + t, 7);
+    uint32_t SS2 = SS1 ^ rot_A_12;
+    uint32_t TT1 = FF<Early>(s.A, s.B, s.C) + s.D + SS2 + w_prime;
+    uint32_t TT2 = GG<Early>(s.E, s.F, s.G) + s.H + SS1 + w;
+
+    s.D = s.C;
+    s.C = rotl(s.B, 9);
+    s.B = s.A;
+    s.A = TT1;
+    s.H = s.G;
+    s.G = rotl(s.F, 19);
+    s.F = s.E;
+    s.E = P0(TT2);
+}
+
+// Round J with every index a constant.
+template <int J, typename Schedule>
+inline __attribute__((always_inline)) void fixed_round(State& s, Schedule& w) {
+    w.prepare(J);
+    round<(J < 16)>(s, T_ROTATED[J], w.w(J), w.w_prime(J));
+}
+
+template <typename Schedule, size_t... J>
+inline __attribute__((always_inline)) void fixed_rounds(State& s, Schedule& w, std::index_sequence<J...>) {
+    (fixed_round<static_cast<int>(J)>(s, w), ...);
+}
+
+// Rounds base..base+sizeof(K)-1, all on the same side of round 16.
+template <bool Early, typename Schedule, size_t... K>
+inline __attribute__((always_inline)) void round_group(State& s, Schedule& w, int base,
+                                                       std::index_sequence<K...>) {
+    ((w.prepare(base + static_cast<int>(K)),
+      round<Early>(s, T_ROTATED[base + K], w.w(base + static_cast<int>(K)), w.w_prime(base + static_cast<int>(K)))),
+     ...);
+}
+
+template <size_t Unroll, typename Schedule>
+inline __attribute__((always_inline)) void compress(uint32_t H[8], Schedule& w) {
+    static_assert(Unroll == 1 || Unroll == 2 || Unroll == 4 || Unroll == 8 || Unroll == 16 || Unroll == 64,
+                  "Unroll must divide 16 rounds, or be 64");
+    SM3_STAGE_SCOPE(Rounds);
+    State s{H[0], H[1], H[2], H[3], H[4], H[5], H[6], H[7]};
+    if constexpr (Unroll == 64) {
+        fixed_rounds(s, w, std::make_index_sequence<64>());
+    } else {
+        for (int base = 0; base < 16; base += Unroll) {
+            round_group<true>(s, w, base, std::make_index_sequence<Unroll>());
+        }
+        for (int base = 16; base < 64; base += Unroll) {
+            round_group<false>(s, w, base, std::make_index_sequence<Unroll>());
+        }
+    }
+    H[0] ^= s.A; H[1] ^= s.B; H[2] ^= s.C; H[3] ^= s.D;
+    H[4] ^= s.E; H[5] ^= s.F; H[6] ^= s.G; H[7] ^= s.H;
+}
+
+// How W' reaches the rounds of a precomputed schedule.
+enum class WPrime {
+    OnUse,  // W[j] ^ W[j+4] at the round, no W' array
+    Array,  // W'[0..63] filled before round 0
+    Simd,   // the same array, four words per SSE XOR
+};
+
+// The textbook order: W[0..67], and W' unless OnUse, computed before round 0. Flat
+// writes the 52 expansion steps out as separate statements instead of a loop; GCC
+// vectorizes the loop form across the distance-3 dependence and stalls on the stores
+// it has to forward, so the loop form runs markedly slower.
+template <WPrime Prime = WPrime::Array, bool Flat = false>
+class Precomputed {
+public:
+    explicit Precomputed(const uint8_t* block) {
+        expand_block(block);
+        if constexpr (Prime == WPrime::Array) {
+            SM3_STAGE_SCOPE(WPrime);
+            for (int j = 0; j < 64; j++) {
+                W_prime[j] = W[j] ^ W[j + 4];
+            }
+        } else if constexpr (Prime == WPrime::Simd) {
+            SM3_STAGE_SCOPE(WPrime);
+            for (int j = 0; j < 64; j += 4) {
+                __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(W + j));
+                __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(W + j + 4));
+                _mm_store_si128(reinterpret_cast<__m128i*>(W_prime + j), _mm_xor_si128(a, b));
+            }
+        }
+    }
+
+    void prepare(int) {}
+
+    uint32_t w(int j) const {
+        return W[j];
+    }
+
+    uint32_t w_prime(int j) const {
+        if constexpr (Prime == WPrime::OnUse) {
+            return W[j] ^ W[j + 4];
+        } else {
+            return W_prime[j];
+        }
+    }
+
+private:
+    inline __attribute__((always_inline)) void expand_block(const uint8_t* block) {
+        SM3_STAGE_SCOPE(Expansion);
+        load_words(block, W);
+        if constexpr (Flat) {
+            expand_all(std::make_index_sequence<52>());
+        } else {
+            for (int j = 16; j < 68; j++) {
+                W[j] = expand(W, j);
+            }
+        }
+    }
+
+    template <size_t... K>
+    inline __attribute__((always_inline)) void expand_all(std::index_sequence<K...>) {
+        ((W[16 + K] = expand(W, 16 + static_cast<int>(K))), ...);
+    }
+
+    alignas(16) uint32_t W[68];
+    alignas(16) uint32_t W_prime[Prime == WPrime::OnUse ? 1 : 64];
+};
+
+// On-the-fly expansion in a 16-word circular window: slot j % 16 holds W[j], and the
+// word Lead rounds ahead, W[j+Lead], is expanded before round j into the slot of
+// W[j+Lead-16], which no later round reads. Lead = 4 is just in time (W[j+4] is first
+// read by round j); a larger lead software-pipelines the schedule, so each expansion
+// has Lead - 4 rounds to finish before the round that needs it and its chain never
+// stalls the A..H chain. With Unroll = 64 every slot index is a constant and the window
+// lives in registers; no 68-word array exists.
+template <int Lead = 8>
+class RollingWindow {
+public:
+    static_assert(Lead >= 4 && Lead <= 15, "the window holds W[j] through W[j+Lead]");
+
+    explicit RollingWindow(const uint8_t* block) {
+        SM3_STAGE_SCOPE(Expansion);
+        load_words(block, W);
+    }
+
+    inline __attribute__((always_inline)) void prepare(int j) {
+        int k = j + Lead;
+        if (k >= 16 && k < 68) {
+            W[k & 15] = P1(W[k & 15] ^ W[(k - 9) & 15] ^ rotl(W[(k - 3) & 15], 15)) ^ rotl(W[(k - 13) & 15], 7) ^
+                        W[(k - 6) & 15];
+        }
+    }
+
+    uint32_t w(int j) const {
+        return W[j & 15];
+    }
+
+    uint32_t w_prime(int j) const {
+        return W[j & 15] ^ W[(j + 4) & 15];
+    }
+
+private:
+    uint32_t W[16];
+};
+
+// W[16..67] three words per 128-bit step, one step every three rounds (see
+// opt6_vector_expand.h for why three and how far ahead).
+class Interleaved {
+public:
+    explicit Interleaved(const uint8_t* block) {
+        const __m128i m[4] = {_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16)),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32)),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48))};
+        load(m);
+    }
+
+    // A block already in registers, four 16-byte chunks in message byte order.
+    explicit Interleaved(const __m128i m[4]) {
+        load(m);
+    }
+
+    void prepare(int j) {
+        if (j % 3 == 0 && j < 51) {
+            expand3(19 + j);
+        }
+    }
+
+    uint32_t w(int j) const {
+        return W[j];
+    }
+
+    uint32_t w_prime(int j) const {
+        return W[j] ^ W[j + 4];
+    }
+
+private:
+    static inline __m128i rotl_epi32(__m128i x, int n) {
+        return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+    }
+
+    void load(const __m128i m[4]) {
+        SM3_STAGE_SCOPE(Expansion);
+        const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+        for (int i = 0; i < 4; i++) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(W + 4 * i), _mm_shuffle_epi8(m[i], bswap));
+        }
+        expand3(16);
+    }
+
+    // W[j..j+2]; the fourth lane reads the unfinished W[j] and is overwritten by the
+    // next step.
+    inline __attribute__((always_inline)) void expand3(int j) {
+        __m128i w16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(W + j - 16));
+        __m128i w13 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(W + j - 13));
+        __m128i w9 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(W + j - 9));
+        __m128i w6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(W + j - 6));
+        __m128i w3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(W + j - 3));
+
+        __m128i x = _mm_xor_si128(_mm_xor_si128(w16, w9), rotl_epi32(w3, 15));
+        x = _mm_xor_si128(x, _mm_xor_si128(rotl_epi32(x, 15), rotl_epi32(x, 23)));
+        x = _mm_xor_si128(x, _mm_xor_si128(rotl_epi32(w13, 7), w6));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(W + j), x);
+    }
+
+    // 68 words plus room for the discarded fourth lane of the last step.
+    alignas(16) uint32_t W[72];
+};
+
+// A schedule that is already complete, such as a constant padding block expanded at
+// compile time.
+class Given {
+public:
+    explicit Given(const uint32_t W[68]) : W(W) {}
+
+    void prepare(int) {}
+
+    uint32_t w(int j) const {
+        return W[j];
+    }
+
+    uint32_t w_prime(int j) const {
+        return W[j] ^ W[j + 4];
+    }
+
+private:
+    const uint32_t* W;
+};
+
+}  // namespace sm3_engine
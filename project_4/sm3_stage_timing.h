@@ -0,0 +1,96 @@
+#pragma once
+
+#include <x86intrin.h>
+
+#include <cstdint>
+
+/**
+ * Per-stage cycle accounting for the single-stream SM3 variants, compiled in only with
+ * -DSM3_STAGE_TIMING.
+ *
+ *     sm3_stage::reset();
+ *     h.update(data, length);
+ *     h.finalize(digest);
+ *     sm3_stage::Counters c = sm3_stage::read();   // c.cycles[sm3_stage::Rounds], ...
+ *
+ * SM3_STAGE_SCOPE(stage) charges the TSC cycles until the end of the enclosing block to
+ * a stage of the calling thread. Time is exclusive: a scope nested in another (the
+ * rounds inside update()) is taken out of the outer one, so the stages add up to the
+ * time spent inside any scope. The engine marks the message expansion, the W' array and
+ * the 64 rounds; the variant classes mark update() and padding as buffer management.
+ * Schedules that expand inside the rounds (the rolling window, the interleaved vector
+ * schedule, W' on use) are charged to Rounds for that work.
+ *
+ * Without the flag SM3_STAGE_SCOPE expands to nothing, ENABLED is false and read()
+ * returns zeros, so the instrumented code is the same code.
+ */
+namespace sm3_stage {
+
+enum Stage : int { Expansion, WPrime, Rounds, Buffering, STAGES };
+
+inline constexpr const char* NAMES[STAGES] = {"expansion", "w_prime", "rounds", "buffering"};
+
+struct Counters {
+    uint64_t cycles[STAGES] = {};
+    uint64_t calls[STAGES] = {};
+};
+
+#ifdef SM3_STAGE_TIMING
+
+inline constexpr bool ENABLED = true;
+
+namespace detail {
+inline thread_local Counters counters;
+inline thread_local uint64_t nested = 0;  // cycles of scopes closed inside the open one
+}  // namespace detail
+
+class Scope {
+public:
+    explicit Scope(Stage stage) : stage(stage), outer_nested(detail::nested), start(__rdtsc()) {
+        detail::nested = 0;
+    }
+
+    ~Scope() {
+        uint64_t elapsed = __rdtsc() - start;
+        detail::counters.cycles[stage] += elapsed - detail::nested;
+        detail::counters.calls[stage]++;
+        detail::nested = outer_nested + elapsed;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Stage stage;
+    uint64_t outer_nested;
+    uint64_t start;
+};
+
+inline Counters read() {
+    return detail::counters;
+}
+
+inline void reset() {
+    detail::counters = Counters();
+    detail::nested = 0;
+}
+
+#define SM3_STAGE_CONCAT_(a, b) a##b
+#define SM3_STAGE_CONCAT(a, b) SM3_STAGE_CONCAT_(a, b)
+#define SM3_STAGE_SCOPE(stage) ::sm3_stage::Scope SM3_STAGE_CONCAT(sm3_stage_scope_, __LINE__)(::sm3_stage::stage)
+
+#else
+
+inline constexpr bool ENABLED = false;
+
+inline Counters read() {
+    return Counters();
+}
+
+inline void reset() {}
+
+#define SM3_STAGE_SCOPE(stage) static_cast<void>(0)
+
+#endif
+
+}  // namespace sm3_stage
@@ -0,0 +1,157 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "opt6_vector_expand.h"
+#include "sm3.h"
+#include "sm3_file.h"
+#include "sm3_state.h"
+
+/**
+ * SM3 mid-state export/import self-test:
+ * - a message split at any point and carried across export_state()/import_state()
+ *   hashes to the one-shot digest, including between SM3 and SM3_VectorExpand;
+ * - the encoding of a known state matches the documented version 1 layout;
+ * - truncated, foreign, future-version and inconsistent states are rejected;
+ * - a checkpointed file job that dies part-way resumes from its last checkpoint and
+ *   produces the digest of an uninterrupted run.
+ *
+ * Usage: sm3_state.elf [size_mib]   (default 64)
+ */
+
+static bool check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+static std::vector<uint8_t> pattern(size_t n) {
+    std::vector<uint8_t> data(n);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+    return data;
+}
+
+template <typename From, typename To>
+static bool split_round_trips(const std::vector<uint8_t>& msg, const std::string& expected) {
+    for (size_t split = 0; split <= msg.size(); split++) {
+        From first;
+        first.update(msg.data(), split);
+        std::vector<uint8_t> state = first.export_state();
+        To second;
+        second.import_state(state.data(), state.size());
+        second.update(msg.data() + split, msg.size() - split);
+        if (state.size() != sm3_state::HEADER_BYTES + split % 64 || second.finalize() != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool round_trips() {
+    std::vector<uint8_t> msg = pattern(300);
+    std::string expected = SM3::hash(msg);
+    bool ok = split_round_trips<SM3, SM3>(msg, expected) &&
+              split_round_trips<SM3_VectorExpand, SM3_VectorExpand>(msg, expected) &&
+              split_round_trips<SM3, SM3_VectorExpand>(msg, expected) &&
+              split_round_trips<SM3_VectorExpand, SM3>(msg, expected);
+    return check(ok, "Every split point of a 300-byte message resumes to the same digest, across classes");
+}
+
+static bool known_layout() {
+    SM3 h;
+    const uint8_t abc[] = {'a', 'b', 'c'};
+    h.update(abc, 3);
+    std::vector<uint8_t> state = h.export_state();
+    std::vector<uint8_t> expected = {'S', 'M', '3', 'S', 1, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3,
+                                     0x73, 0x80, 0x16, 0x6f, 0x49, 0x14, 0xb2, 0xb9, 0x17, 0x24, 0x42, 0xd7,
+                                     0xda, 0x8a, 0x06, 0x00, 0xa9, 0x6f, 0x30, 0xbc, 0x16, 0x31, 0x38, 0xaa,
+                                     0xe3, 0x8d, 0xee, 0x4d, 0xb0, 0xfb, 0x0e, 0x4e, 'a', 'b', 'c'};
+    return check(state == expected, "State after \"abc\" has the documented version 1 layout");
+}
+
+static bool rejected(std::vector<uint8_t> state) {
+    SM3 h;
+    try {
+        h.import_state(state.data(), state.size());
+        return false;
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+}
+
+static bool rejects_bad_states() {
+    SM3 h;
+    std::vector<uint8_t> msg = pattern(100);
+    h.update(msg.data(), msg.size());
+    const std::vector<uint8_t> good = h.export_state();
+
+    auto truncated = good, magic = good, version = good, length = good, tail = good, extra = good;
+    truncated.pop_back();
+    magic[0] = 'X';
+    version[4] = 2;
+    length[15] ^= 1;  // total no longer matches the tail length
+    tail[5] = 64;
+    extra.push_back(0);
+    bool ok = !rejected(good) && rejected(truncated) && rejected(magic) && rejected(version) && rejected(length) &&
+              rejected(tail) && rejected(extra) && rejected({});
+    return check(ok, "Truncated, foreign, future-version and inconsistent states are rejected");
+}
+
+// Dies once it has absorbed crash_after bytes, like a job killed part-way through.
+struct CrashingHasher : SM3_VectorExpand {
+    static inline uint64_t crash_after = 0;
+
+    void update(const uint8_t* data, size_t length) {
+        SM3_VectorExpand::update(data, length);
+        if (bytes_hashed() >= crash_after) {
+            throw std::runtime_error("simulated crash");
+        }
+    }
+};
+
+static bool resumes_after_crash(size_t size_mib) {
+    const uint64_t size = uint64_t(size_mib) << 20, every = size / 4;
+    std::vector<uint8_t> data = pattern(size + 12345);  // not a whole number of chunks
+    char path[] = "/tmp/sm3_state_XXXXXX";
+    int fd = mkstemp(path);
+    bool ok = fd >= 0 && write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    if (fd >= 0) {
+        close(fd);
+    }
+    std::string checkpoint = std::string(path) + ".ckpt";
+    std::string expected = sm3_file::hash_path<SM3_VectorExpand>(path);
+
+    CrashingHasher::crash_after = size * 7 / 10;
+    bool crashed = false;
+    try {
+        sm3_file::hash_path_resumable<CrashingHasher>(path, checkpoint, every);
+    } catch (const std::runtime_error&) {
+        crashed = true;
+    }
+    std::vector<uint8_t> state;
+    SM3 probe;
+    ok = ok && crashed && sm3_file::load_checkpoint(checkpoint, state);
+    if (ok) {
+        probe.import_state(state.data(), state.size());
+    }
+    uint64_t resumed_at = probe.bytes_hashed();
+
+    ok = ok && resumed_at >= size / 2 && sm3_file::hash_path_resumable<SM3>(path, checkpoint, every) == expected &&
+         !sm3_file::load_checkpoint(checkpoint, state);
+    unlink(path);
+    unlink(checkpoint.c_str());
+    return check(ok, "A " + std::to_string(size_mib) + " MiB job killed at 70% resumed from its checkpoint at " +
+                         std::to_string(resumed_at >> 20) + " MiB and matched an uninterrupted run");
+}
+
+int main(int argc, char** argv) {
+    size_t size_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64;
+    bool ok = round_trips();
+    ok = known_layout() && ok;
+    ok = rejects_bad_states() && ok;
+    ok = resumes_after_crash(std::max<size_t>(size_mib, 4)) && ok;
+    return ok ? 0 : 1;
+}
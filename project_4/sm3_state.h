@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Binary encoding of an SM3 mid-state, shared by the hasher classes' export_state() and
+ * import_state(). A state exported by one class can be imported into any other, in this
+ * or another process, and hashing continues as if the input had never been split.
+ *
+ * Version 1 layout, integers big-endian like SM3 itself (48 bytes + 0..63 tail bytes):
+ *
+ *     0   4   magic "SM3S"
+ *     4   1   version (1)
+ *     5   1   tail length t (0..63)
+ *     6   2   reserved, zero
+ *     8   8   total bytes absorbed so far
+ *     16  32  chaining value H[0..7]
+ *     48  t   unprocessed tail of the last partial block
+ *
+ * decode() rejects anything that is not a consistent version 1 state, so a truncated or
+ * stale checkpoint fails loudly instead of producing a wrong digest.
+ */
+namespace sm3_state {
+
+constexpr uint8_t FORMAT_VERSION = 1;
+constexpr size_t HEADER_BYTES = 48;
+constexpr size_t MAX_BYTES = HEADER_BYTES + 63;
+
+inline std::vector<uint8_t> encode(const uint32_t H[8], const uint8_t* tail, size_t tail_len, uint64_t total_length) {
+    std::vector<uint8_t> out(HEADER_BYTES + tail_len);
+    std::memcpy(out.data(), "SM3S", 4);
+    out[4] = FORMAT_VERSION;
+    out[5] = static_cast<uint8_t>(tail_len);
+    for (int i = 0; i < 8; i++) {
+        out[8 + i] = static_cast<uint8_t>(total_length >> (56 - 8 * i));
+    }
+    for (int w = 0; w < 8; w++) {
+        for (int i = 0; i < 4; i++) {
+            out[16 + 4 * w + i] = static_cast<uint8_t>(H[w] >> (24 - 8 * i));
+        }
+    }
+    std::memcpy(out.data() + HEADER_BYTES, tail, tail_len);
+    return out;
+}
+
+inline void decode(const uint8_t* in, size_t length, uint32_t H[8], uint8_t tail[64], size_t& tail_len,
+                   uint64_t& total_length) {
+    if (length < HEADER_BYTES || std::memcmp(in, "SM3S", 4) != 0) {
+        throw std::invalid_argument("sm3_state: not an SM3 state");
+    }
+    if (in[4] != FORMAT_VERSION) {
+        throw std::invalid_argument("sm3_state: unsupported state version " + std::to_string(in[4]));
+    }
+    uint64_t total = 0;
+    for (int i = 0; i < 8; i++) {
+        total = total << 8 | in[8 + i];
+    }
+    size_t t = in[5];
+    // The tail is whatever follows the last whole block, and the bit length must fit the
+    // 64-bit length field of the padding.
+    if (t > 63 || in[6] != 0 || in[7] != 0 || length != HEADER_BYTES + t || total % 64 != t || total >> 61 != 0) {
+        throw std::invalid_argument("sm3_state: corrupt SM3 state");
+    }
+    for (int w = 0; w < 8; w++) {
+        const uint8_t* p = in + 16 + 4 * w;
+        H[w] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+    }
+    std::memcpy(tail, in + HEADER_BYTES, t);
+    tail_len = t;
+    total_length = total;
+}
+
+}  // namespace sm3_state
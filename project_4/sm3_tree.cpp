@@ -0,0 +1,245 @@
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "sm3.h"
+#include "sm3_tree.h"
+
+/**
+ * SM3 tree hash (format v1) self-test and scaling benchmark:
+ * - known answers from an independent model of the v1 definition;
+ * - the level-by-level root equals the recursive RFC 6962 definition for 1..64 leaves;
+ * - the same digest for 1, 2, 3 and 8 threads, from memory, a mapped file and a pipe;
+ * - pipes with leaves larger than the read buffer, up to 1 GiB, hash in bounded memory;
+ * - verify() accepts the digest and rejects a one-byte change;
+ * - throughput of plain single-stream SM3 vs. the tree hash with 1, 2, 4, ... threads.
+ *
+ * Usage: sm3_tree.elf [size_mib]   (default 256)
+ */
+
+using Clock = std::chrono::steady_clock;
+using Digest = SM3_TreeHash::Digest;
+
+static std::vector<uint8_t> pattern(size_t n) {
+    std::vector<uint8_t> data(n);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    return data;
+}
+
+static bool check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << std::endl;
+    return ok;
+}
+
+static bool known_answers() {
+    SM3_TreeHash::Config config;
+    config.leaf_shift = 12;
+    SM3_TreeHash tree(config);
+    std::vector<uint8_t> data = pattern(5 * 4096 + 100);
+    std::vector<uint8_t> abc = {'a', 'b', 'c'};
+    // 16000 leaves: the interior levels are hashed on the pool as well.
+    SM3_TreeHash::Config small_leaves;
+    small_leaves.leaf_shift = 6;
+    std::vector<uint8_t> many = pattern(1000 * 1024 + 333);
+    return check(SM3_TreeHash::to_hex(tree.hash(data.data(), data.size())) ==
+                         "8ff774518149ecdef441e1b7927b2548e2028231be1f023a11ed772b21753a07" &&
+                     SM3_TreeHash::to_hex(tree.hash(nullptr, 0)) ==
+                         "508c5347975080bdb32b323ddfae9760c0a4a7c24c0ad5e99a4557d072f7755c" &&
+                     SM3_TreeHash::to_hex(tree.hash(data.data(), 4 * 4096)) ==
+                         "1ca0e7b803d1b7d30c47a071454a545ed9f4f53bc0af4c3475d2025562ba109c" &&
+                     SM3_TreeHash().format(SM3_TreeHash().hash(abc.data(), abc.size())) ==
+                         "sm3tree-v1-20:edc557905b97cfab85aa6514f7b0c2f0dc2d3666732b2b9c59546f3147b50c41" &&
+                     SM3_TreeHash::to_hex(SM3_TreeHash(small_leaves).hash(many.data(), many.size())) ==
+                         "baea0917c6b3af17f40d93f8f5ec5d5a6a75f19ce4bc8c58e07af07a7839f68e",
+                 "Tree hash v1 known answers");
+}
+
+// MTH(d[0..n)) straight from the recursive definition, with the reference SM3 class.
+static Digest reference_mth(const std::vector<Digest>& d, size_t begin, size_t end) {
+    if (end - begin == 1) {
+        return d[begin];
+    }
+    size_t m = 1;
+    while (2 * m < end - begin) {
+        m *= 2;
+    }
+    Digest left = reference_mth(d, begin, begin + m), right = reference_mth(d, begin + m, end);
+    std::vector<uint8_t> in = {0x01};
+    in.insert(in.end(), left.begin(), left.end());
+    in.insert(in.end(), right.begin(), right.end());
+    std::string hex = SM3::hash(in);
+    Digest out;
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = static_cast<uint8_t>(std::stoi(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    return out;
+}
+
+static bool root_matches_recursive_definition() {
+    SM3_TreeHash tree;
+    std::mt19937_64 rng(9);
+    std::vector<Digest> leaves;
+    for (size_t n = 1; n <= 64; n++) {
+        Digest d;
+        for (auto& b : d) {
+            b = static_cast<uint8_t>(rng());
+        }
+        leaves.push_back(d);
+        if (tree.root(leaves) != reference_mth(leaves, 0, leaves.size())) {
+            return check(false, "Level-by-level root differs from RFC 6962 for " + std::to_string(n) + " leaves");
+        }
+    }
+    return check(true, "Level-by-level root matches RFC 6962 for 1..64 leaves");
+}
+
+static Digest hash_through_pipe(SM3_TreeHash& tree, const std::vector<uint8_t>& data) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("pipe failed");
+    }
+    std::thread writer([&] {
+        size_t off = 0;
+        while (off < data.size()) {
+            ssize_t n = write(fds[1], data.data() + off, std::min<size_t>(data.size() - off, 65536));
+            if (n <= 0) {
+                break;
+            }
+            off += static_cast<size_t>(n);
+        }
+        close(fds[1]);
+    });
+    Digest d = tree.hash_fd(fds[0], "pipe");
+    writer.join();
+    close(fds[0]);
+    return d;
+}
+
+static bool thread_count_independent() {
+    // Not a whole number of leaves or of 256-leaf windows.
+    std::vector<uint8_t> data = pattern(1000 * 1024 + 333);
+    char path[] = "/tmp/sm3_tree_XXXXXX";
+    int fd = mkstemp(path);
+    bool written = fd >= 0 && write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    bool ok = written;
+    for (unsigned shift : {6u, 10u}) {
+        Digest expected{};
+        for (unsigned threads : {1u, 2u, 3u, 8u}) {
+            SM3_TreeHash::Config config;
+            config.leaf_shift = shift;
+            config.threads = threads;
+            SM3_TreeHash tree(config);
+            Digest from_memory = tree.hash(data.data(), data.size());
+            if (threads == 1) {
+                expected = from_memory;
+            }
+            ok = ok && from_memory == expected && tree.hash_path(path) == expected &&
+                 hash_through_pipe(tree, data) == expected;
+        }
+    }
+    unlink(path);
+    return check(ok, "Same digest for 1/2/3/8 threads from memory, mmap and a pipe");
+}
+
+static bool large_leaves_through_pipe() {
+    // 8 MiB leaves are two read buffers each: a full leaf, then a short last one.
+    std::vector<uint8_t> data = pattern(9 * 1024 * 1024 + 5);
+    std::vector<uint8_t> abc = {'a', 'b', 'c'};
+    bool ok = true;
+    for (unsigned shift : {23u, 30u}) {
+        SM3_TreeHash::Config config;
+        config.leaf_shift = shift;
+        SM3_TreeHash tree(config);
+        ok = ok && hash_through_pipe(tree, data) == tree.hash(data.data(), data.size()) &&
+             hash_through_pipe(tree, abc) == tree.hash(abc.data(), abc.size()) &&
+             hash_through_pipe(tree, {}) == tree.hash(nullptr, 0);
+    }
+    return check(ok, "Pipes with 8 MiB and 1 GiB leaves match the in-memory digest");
+}
+
+static bool verify_detects_change() {
+    SM3_TreeHash tree;
+    std::vector<uint8_t> data = pattern(3 * 1024 * 1024 + 17);
+    Digest d = tree.hash(data.data(), data.size());
+
+    unsigned shift;
+    Digest parsed;
+    bool ok = SM3_TreeHash::parse(tree.format(d), shift, parsed) && shift == 20 && parsed == d &&
+              tree.verify(data.data(), data.size(), parsed);
+    data[2 * 1024 * 1024 + 5] ^= 1;
+    ok = ok && !tree.verify(data.data(), data.size(), parsed);
+    ok = ok && !SM3_TreeHash::parse("sm3tree-v2-20:" + SM3_TreeHash::to_hex(d), shift, parsed);
+    return check(ok, "verify() accepts the digest and rejects a modified input");
+}
+
+template <typename Fn>
+static double best_seconds(Fn fn) {
+    double best = 1e30;
+    for (int pass = 0; pass < 3; pass++) {
+        auto t0 = Clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    bool ok = known_answers();
+    ok = root_matches_recursive_definition() && ok;
+    ok = thread_count_independent() && ok;
+    ok = large_leaves_through_pipe() && ok;
+    ok = verify_detects_change() && ok;
+    if (!ok) {
+        return 1;
+    }
+
+    size_t size_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+    std::vector<uint8_t> data(size_mib << 20);
+    std::mt19937_64 rng(1);
+    for (auto& b : data) {
+        b = static_cast<uint8_t>(rng());
+    }
+    double gb = data.size() / 1e9;
+
+    double plain = best_seconds([&] {
+        SM3_VectorExpand h;
+        h.update(data.data(), data.size());
+        h.finalize();
+    });
+    std::cout << size_mib << " MiB, 1 MiB leaves" << std::endl;
+    std::cout << "  plain SM3 (1 thread)  " << std::fixed << std::setprecision(2) << gb / plain << " GB/s"
+              << std::endl;
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < cores; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(cores);
+    Digest first{};
+    for (unsigned threads : counts) {
+        SM3_TreeHash::Config config;
+        config.threads = threads;
+        SM3_TreeHash tree(config);
+        Digest d;
+        double s = best_seconds([&] { d = tree.hash(data.data(), data.size()); });
+        if (threads == 1) {
+            first = d;
+        } else if (d != first) {
+            std::cout << "✗ Digest changed with " << threads << " threads" << std::endl;
+            return 1;
+        }
+        std::cout << "  tree, " << std::setw(3) << threads << " thread(s)  " << gb / s << " GB/s  (" << plain / s
+                  << "x plain)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../project_1/crypto_runtime/buffer_pool.h"
+#include "../project_1/crypto_runtime/work_stealing_pool.h"
+#include "opt6_vector_expand.h"
+#include "sm3_file.h"
+#include "sm3_x2.h"
+
+/**
+ * Parallel tree hash over SM3 for very large single inputs, format version 1.
+ *
+ *     SM3_TreeHash tree;                       // 1 MiB leaves, all cores
+ *     std::string tag = tree.format(tree.hash_path("disk.img"));
+ *     // "sm3tree-v1-20:<64 hex digits>", where 20 = log2(leaf size)
+ *
+ * Definition (version 1, leaf size L = 2^k bytes, 6 <= k <= 30):
+ * - The input is split into n = max(1, ceil(len / L)) leaves; only the last may be
+ *   short, and an empty input is one empty leaf.
+ * - leaf_i = SM3(P || data_i), where P is a 64-byte block of zeros except
+ *   P[0] = 0x00, P[1] = 0x01 (version), P[2] = k.
+ * - Leaves are combined as in RFC 6962: MTH(d[0..n)) = SM3(0x01 || MTH(d[0..m)) ||
+ *   MTH(d[m..n))), with m the largest power of two below n, and MTH of one leaf being
+ *   the leaf digest itself.
+ * - The result is SM3(0x02 || 0x01 || k || be64(len) || MTH), binding the version, leaf
+ *   size and length to the root.
+ *
+ * The digest depends only on the input and k, never on the thread count or on how the
+ * input is read. Leaves are hashed on a work-stealing pool with the single-stream
+ * vector-expansion kernel; P is one whole block, so leaf data is still compressed
+ * straight from the source. Interior nodes are hashed two at a time with the 2-way
+ * interleaved kernel. Files are mapped in windows of WINDOW_LEAVES leaves; pipes are read
+ * PIPE_BUFFER bytes at a time, a larger leaf being hashed as it arrives. Memory therefore
+ * grows only by one 32-byte digest per leaf, whatever the leaf size.
+ */
+class SM3_TreeHash {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t DIGEST_BYTES = 32;
+    static constexpr unsigned DEFAULT_LEAF_SHIFT = 20;  // 1 MiB
+    static constexpr unsigned MIN_LEAF_SHIFT = 6;
+    static constexpr unsigned MAX_LEAF_SHIFT = 30;
+    static constexpr size_t WINDOW_LEAVES = 256;
+    static constexpr size_t PIPE_BUFFER = size_t(4) << 20;
+
+    using Digest = std::array<uint8_t, DIGEST_BYTES>;
+
+    struct Config {
+        unsigned leaf_shift = DEFAULT_LEAF_SHIFT;
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    SM3_TreeHash() : SM3_TreeHash(Config()) {}
+    explicit SM3_TreeHash(Config config) : config(config), pool(config.threads) {
+        if (config.leaf_shift < MIN_LEAF_SHIFT || config.leaf_shift > MAX_LEAF_SHIFT) {
+            throw std::invalid_argument("SM3_TreeHash: leaf size must be 2^6 .. 2^30 bytes");
+        }
+    }
+
+    size_t leaf_bytes() const {
+        return size_t(1) << config.leaf_shift;
+    }
+
+    unsigned threads() const {
+        return pool.size();
+    }
+
+    Digest hash(const uint8_t* data, size_t length) {
+        std::vector<Digest> leaves;
+        append_leaves(data, length, leaves);
+        if (leaves.empty()) {
+            leaves.push_back(leaf_digest(data, 0));
+        }
+        return finish(leaves, length);
+    }
+
+    Digest hash_path(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            sm3_file::throw_errno(path);
+        }
+        try {
+            Digest d = hash_fd(fd, path);
+            close(fd);
+            return d;
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+
+    // Regular files are mapped window by window; anything else is read in bounded chunks.
+    Digest hash_fd(int fd, const std::string& name) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            sm3_file::throw_errno(name);
+        }
+        std::vector<Digest> leaves;
+        uint64_t length = 0;
+
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            const size_t window = WINDOW_LEAVES * leaf_bytes();
+            uint64_t size = static_cast<uint64_t>(st.st_size);
+            for (uint64_t offset = 0; offset < size; offset += window) {
+                size_t len = static_cast<size_t>(std::min<uint64_t>(window, size - offset));
+                void* map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+                if (map == MAP_FAILED) {
+                    sm3_file::throw_errno(name);
+                }
+                madvise(map, len, MADV_WILLNEED);
+                append_leaves(static_cast<const uint8_t*>(map), len, leaves);
+                munmap(map, len);
+            }
+            length = size;
+        } else {
+            length = read_leaves(fd, name, leaves);
+        }
+
+        if (leaves.empty()) {
+            leaves.push_back(leaf_digest(nullptr, 0));
+        }
+        return finish(leaves, length);
+    }
+
+    // Recomputes the tree hash and compares it with expected in constant time.
+    bool verify(const uint8_t* data, size_t length, const Digest& expected) {
+        return equal(hash(data, length), expected);
+    }
+
+    bool verify_path(const std::string& path, const Digest& expected) {
+        return equal(hash_path(path), expected);
+    }
+
+    // "sm3tree-v1-<k>:<hex>"; the prefix records everything needed to recompute it.
+    std::string format(const Digest& digest) const {
+        std::stringstream ss;
+        ss << "sm3tree-v" << static_cast<int>(VERSION) << "-" << config.leaf_shift << ":";
+        for (uint8_t b : digest) {
+            ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
+        }
+        return ss.str();
+    }
+
+    // Parses a format() string; returns false if it is malformed or another version.
+    static bool parse(const std::string& text, unsigned& leaf_shift, Digest& digest) {
+        const std::string prefix = "sm3tree-v1-";
+        size_t colon = text.find(':');
+        if (text.compare(0, prefix.size(), prefix) != 0 || colon == std::string::npos ||
+            text.size() != colon + 1 + 2 * DIGEST_BYTES || colon == prefix.size()) {
+            return false;
+        }
+        leaf_shift = 0;
+        for (size_t i = prefix.size(); i < colon; i++) {
+            if (text[i] < '0' || text[i] > '9' || leaf_shift > MAX_LEAF_SHIFT) {
+                return false;
+            }
+            leaf_shift = leaf_shift * 10 + static_cast<unsigned>(text[i] - '0');
+        }
+        if (leaf_shift < MIN_LEAF_SHIFT || leaf_shift > MAX_LEAF_SHIFT) {
+            return false;
+        }
+        for (size_t i = 0; i < DIGEST_BYTES; i++) {
+            int hi = hex_value(text[colon + 1 + 2 * i]);
+            int lo = hex_value(text[colon + 2 + 2 * i]);
+            if (hi < 0 || lo < 0) {
+                return false;
+            }
+            digest[i] = static_cast<uint8_t>(hi << 4 | lo);
+        }
+        return true;
+    }
+
+    // RFC 6962 root over leaf digests, computed level by level: pairing neighbours and
+    // carrying an odd last node up unchanged gives the same tree as the recursive split.
+    Digest root(std::vector<Digest> level) {
+        while (level.size() > 1) {
+            size_t parents = level.size() / 2;
+            std::vector<Digest> next((level.size() + 1) / 2);
+            size_t pairs_of_parents = (parents + 1) / 2;
+            auto body = [&](size_t p, unsigned) {
+                size_t a = 2 * p, b = 2 * p + 1;
+                uint8_t in_a[1 + 2 * DIGEST_BYTES], in_b[1 + 2 * DIGEST_BYTES];
+                node_input(level[2 * a], level[2 * a + 1], in_a);
+                if (b < parents) {
+                    node_input(level[2 * b], level[2 * b + 1], in_b);
+                    SM3_X2::hash2(in_a, sizeof(in_a), in_b, sizeof(in_b), next[a].data(), next[b].data());
+                } else {
+                    SM3_X2::hash1(in_a, sizeof(in_a), next[a].data());
+                }
+            };
+            if (pairs_of_parents >= PARALLEL_NODES) {
+                pool.parallel_for(pairs_of_parents, body);
+            } else {
+                for (size_t p = 0; p < pairs_of_parents; p++) {
+                    body(p, 0);
+                }
+            }
+            if (level.size() % 2 == 1) {
+                next.back() = level.back();
+            }
+            level.swap(next);
+        }
+        return level[0];
+    }
+
+    static std::string to_hex(const Digest& digest) {
+        std::stringstream ss;
+        for (uint8_t b : digest) {
+            ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(b);
+        }
+        return ss.str();
+    }
+
+    const crypto_runtime::WorkStealingPool::Stats& pool_stats() const {
+        return pool.get_stats();
+    }
+
+private:
+    // Below this many node pairs a level is cheaper to hash on the calling thread.
+    static constexpr size_t PARALLEL_NODES = 512;
+
+    // A hasher that has absorbed the leaf prefix block P.
+    SM3_VectorExpand leaf_hasher() const {
+        uint8_t prefix[64] = {0x00, VERSION, static_cast<uint8_t>(config.leaf_shift)};
+        SM3_VectorExpand h;
+        h.update(prefix, sizeof(prefix));
+        return h;
+    }
+
+    Digest leaf_digest(const uint8_t* data, size_t length) const {
+        SM3_VectorExpand h = leaf_hasher();
+        h.update(data, length);
+        Digest d;
+        h.finalize(d.data());
+        return d;
+    }
+
+    // Hashes the leaves of one contiguous span of the input. Every span but the last
+    // must be a whole number of leaves.
+    void append_leaves(const uint8_t* data, size_t length, std::vector<Digest>& leaves) {
+        const size_t leaf = leaf_bytes();
+        size_t count = (length + leaf - 1) / leaf;
+        size_t first = leaves.size();
+        leaves.resize(first + count);
+        pool.parallel_for(count, [&](size_t i, unsigned) {
+            size_t begin = i * leaf;
+            leaves[first + i] = leaf_digest(data + begin, std::min(leaf, length - begin));
+        });
+    }
+
+    // Reads non-seekable input to EOF one buffer at a time. Leaves of at most PIPE_BUFFER
+    // bytes are hashed in parallel, a buffer of whole leaves per call; a larger leaf is a
+    // whole number of buffers and is fed to one hasher buffer by buffer. Returns the
+    // input length.
+    uint64_t read_leaves(int fd, const std::string& name, std::vector<Digest>& leaves) {
+        const size_t leaf = leaf_bytes();
+        auto buffer = crypto_runtime::BufferPool::shared().acquire(PIPE_BUFFER);
+        SM3_VectorExpand open = leaf_hasher();
+        size_t in_leaf = 0;
+        uint64_t length = 0;
+        while (true) {
+            size_t got = read_full(fd, name, buffer.data(), PIPE_BUFFER);
+            length += got;
+            if (leaf <= PIPE_BUFFER) {
+                append_leaves(buffer.data(), got, leaves);
+            } else {
+                open.update(buffer.data(), got);
+                in_leaf += got;
+                if (in_leaf == leaf || (got < PIPE_BUFFER && in_leaf > 0)) {
+                    Digest d;
+                    open.finalize(d.data());
+                    leaves.push_back(d);
+                    open = leaf_hasher();
+                    in_leaf = 0;
+                }
+            }
+            if (got < PIPE_BUFFER) {
+                return length;
+            }
+        }
+    }
+
+    // Fills buf from fd; returns less than length only at EOF.
+    static size_t read_full(int fd, const std::string& name, uint8_t* buf, size_t length) {
+        size_t got = 0;
+        while (got < length) {
+            ssize_t n = read(fd, buf + got, length - got);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                sm3_file::throw_errno(name);
+            }
+            if (n == 0) {
+                break;
+            }
+            got += static_cast<size_t>(n);
+        }
+        return got;
+    }
+
+    static void node_input(const Digest& left, const Digest& right, uint8_t out[1 + 2 * DIGEST_BYTES]) {
+        out[0] = 0x01;
+        std::memcpy(out + 1, left.data(), DIGEST_BYTES);
+        std::memcpy(out + 1 + DIGEST_BYTES, right.data(), DIGEST_BYTES);
+    }
+
+    Digest finish(const std::vector<Digest>& leaves, uint64_t length) {
+        Digest top = root(leaves);
+        uint8_t in[3 + 8 + DIGEST_BYTES] = {0x02, VERSION, static_cast<uint8_t>(config.leaf_shift)};
+        for (int i = 0; i < 8; i++) {
+            in[3 + i] = static_cast<uint8_t>(length >> (56 - 8 * i));
+        }
+        std::memcpy(in + 11, top.data(), DIGEST_BYTES);
+        Digest d;
+        SM3_X2::hash1(in, sizeof(in), d.data());
+        return d;
+    }
+
+    static bool equal(const Digest& a, const Digest& b) {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < DIGEST_BYTES; i++) {
+            diff |= a[i] ^ b[i];
+        }
+        return diff == 0;
+    }
+
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    Config config;
+    crypto_runtime::WorkStealingPool pool;
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "sm3_round_engine.h"
+
+/**
+ * 2-way interleaved scalar SM3 for callers that always hash two things at once: two
+ * Merkle siblings, or the ipad and opad key blocks of two HMAC keys.
+ *
+ * A single compression is one serial A..H dependency chain, so the round code of
+ * opt2_regalloc keeps only a couple of ALU ports busy. compress2() advances two
+ * independent states in the same loop, round j of state a next to round j of state b,
+ * which gives the scheduler two chains to fill the idle ports with. Unlike the 8-lane
+ * AVX2 engine there is no transpose and no lane scheduling, so the latency of hashing a
+ * pair of short messages stays close to that of hashing one. The rounds are the
+ * engine's (sm3_round_engine.h), expanded over an index sequence for both states.
+ *
+ * Whether the second chain pays off depends on the core and on how much of the
+ * 16-word state spills. Measured with sm3_x2.elf (-O3 -march=native, default 200000
+ * pairs, five alternating runs) on a shared single-vCPU Xeon VM, compress2 took
+ * between 0.85x and 1.16x the time of two compress1 calls and 32-256 B pairs were not
+ * consistently faster than hashing the two messages one after the other; run the
+ * benchmark on the target host before preferring hash2 over two hash1 calls.
+ *
+ *     SM3_X2::hash2(left, 64, right, 64, digest_left, digest_right);
+ */
+class SM3_X2 {
+public:
+    static constexpr size_t DIGEST_BYTES = 32;
+
+    struct State {
+        uint32_t h[8];
+    };
+
+    static State initial_state() {
+        State s;
+        std::memcpy(s.h, IV, sizeof(s.h));
+        return s;
+    }
+
+    // One compression of block_a into a and block_b into b, interleaved round by round.
+    // Both kernels are kept out of line: fully unrolled they are several KiB each, and
+    // inlining them into hash2() next to each other costs more in i-cache than it saves.
+    __attribute__((noinline)) static void compress2(State& a, const uint8_t* block_a, State& b, const uint8_t* block_b) {
+        uint32_t Wa[68], Wb[68];
+        sm3_engine::load_words(block_a, Wa);
+        sm3_engine::load_words(block_b, Wb);
+        #pragma GCC unroll 52
+        for (int j = 16; j < 68; j++) {
+            Wa[j] = sm3_engine::expand(Wa, j);
+            Wb[j] = sm3_engine::expand(Wb, j);
+        }
+
+        sm3_engine::State sa = load_state(a), sb = load_state(b);
+        rounds2(sa, Wa, sb, Wb, std::make_index_sequence<64>());
+        feed_forward(a, sa);
+        feed_forward(b, sb);
+    }
+
+    // The same round code for one state, used once the shorter of two inputs runs out.
+    __attribute__((noinline)) static void compress1(State& s, const uint8_t* block) {
+        uint32_t W[68];
+        sm3_engine::load_words(block, W);
+        #pragma GCC unroll 52
+        for (int j = 16; j < 68; j++) {
+            W[j] = sm3_engine::expand(W, j);
+        }
+        sm3_engine::Given w(W);
+        sm3_engine::compress<64>(s.h, w);
+    }
+
+    static void hash1(const uint8_t* data, size_t length, uint8_t digest[DIGEST_BYTES]) {
+        Cursor c(data, length);
+        State s = initial_state();
+        while (c.has_next()) {
+            compress1(s, c.next());
+        }
+        store_digest(s, digest);
+    }
+
+    // Hashes two complete messages, compressing their blocks in pairs while both have one.
+    static void hash2(const uint8_t* data_a, size_t len_a, const uint8_t* data_b, size_t len_b,
+                      uint8_t digest_a[DIGEST_BYTES], uint8_t digest_b[DIGEST_BYTES]) {
+        Cursor ca(data_a, len_a), cb(data_b, len_b);
+        State a = initial_state(), b = initial_state();
+        while (ca.has_next() && cb.has_next()) {
+            compress2(a, ca.next(), b, cb.next());
+        }
+        while (ca.has_next()) {
+            compress1(a, ca.next());
+        }
+        while (cb.has_next()) {
+            compress1(b, cb.next());
+        }
+        store_digest(a, digest_a);
+        store_digest(b, digest_b);
+    }
+
+    static void store_digest(const State& s, uint8_t digest[DIGEST_BYTES]) {
+        for (int i = 0; i < 8; i++) {
+            digest[4 * i + 0] = static_cast<uint8_t>(s.h[i] >> 24);
+            digest[4 * i + 1] = static_cast<uint8_t>(s.h[i] >> 16);
+            digest[4 * i + 2] = static_cast<uint8_t>(s.h[i] >> 8);
+            digest[4 * i + 3] = static_cast<uint8_t>(s.h[i]);
+        }
+    }
+
+    static std::string to_hex(const uint8_t digest[DIGEST_BYTES]) {
+        std::stringstream ss;
+        for (size_t i = 0; i < DIGEST_BYTES; i++) {
+            ss << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(digest[i]);
+        }
+        return ss.str();
+    }
+
+private:
+    static const uint32_t IV[8];
+
+    // Walks a message block by block: full blocks from the caller's memory, then the
+    // padded final one or two blocks from a local tail.
+    class Cursor {
+    public:
+        Cursor(const uint8_t* data, size_t length)
+            : data(data), remaining(length & ~size_t(63)) {
+            size_t rest = length - remaining;
+            std::memset(tail, 0, sizeof(tail));
+            if (rest > 0) {
+                std::memcpy(tail, data + remaining, rest);
+            }
+            tail[rest] = 0x80;
+            tail_blocks = rest + 9 > 64 ? 2 : 1;
+            uint64_t bit_length = static_cast<uint64_t>(length) * 8;
+            uint8_t* len_field = tail + 64 * tail_blocks - 8;
+            for (int i = 0; i < 8; i++) {
+                len_field[i] = static_cast<uint8_t>(bit_length >> ((7 - i) * 8));
+            }
+        }
+
+        bool has_next() const {
+            return remaining > 0 || tail_next < tail_blocks;
+        }
+
+        const uint8_t* next() {
+            if (remaining > 0) {
+                const uint8_t* block = data;
+                data += 64;
+                remaining -= 64;
+                return block;
+            }
+            return tail + 64 * tail_next++;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t remaining;
+        uint8_t tail[128];
+        size_t tail_blocks;
+        size_t tail_next = 0;
+    };
+
+    static inline __attribute__((always_inline)) sm3_engine::State load_state(const State& s) {
+        return {s.h[0], s.h[1], s.h[2], s.h[3], s.h[4], s.h[5], s.h[6], s.h[7]};
+    }
+
+    static inline __attribute__((always_inline)) void feed_forward(State& s, const sm3_engine::State& v) {
+        s.h[0] ^= v.A; s.h[1] ^= v.B; s.h[2] ^= v.C; s.h[3] ^= v.D;
+        s.h[4] ^= v.E; s.h[5] ^= v.F; s.h[6] ^= v.G; s.h[7] ^= v.H;
+    }
+
+    // Round J of a next to round J of b, with J a constant so each round's T_j <<< j
+    // comes from the engine's table and its FF/GG form is chosen at compile time.
+    template <size_t... J>
+    static inline __attribute__((always_inline)) void rounds2(sm3_engine::State& a, const uint32_t* Wa,
+                                                              sm3_engine::State& b, const uint32_t* Wb,
+                                                              std::index_sequence<J...>) {
+        ((sm3_engine::round<(J < 16)>(a, sm3_engine::T_ROTATED[J], Wa[J], Wa[J] ^ Wa[J + 4]),
+          sm3_engine::round<(J < 16)>(b, sm3_engine::T_ROTATED[J], Wb[J], Wb[J] ^ Wb[J + 4])),
+         ...);
+    }
+};
+
+inline const uint32_t SM3_X2::IV[8] = {
+    0x7380166f, 0x4914b2b9, 0x172442d7, 0xda8a0600,
+    0xa96f30bc, 0x163138aa, 0xe38dee4d, 0xb0fb0e4e
+};
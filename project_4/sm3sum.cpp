@@ -0,0 +1,334 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "../project_1/crypto_runtime/work_stealing_pool.h"
+#include "opt6_vector_expand.h"
+#include "sm3_file.h"
+#include "sm3_multibuffer.h"
+
+/**
+ * sm3sum: SM3 checksums for large numbers of files.
+ *
+ *     sm3sum [-j N] [-q] [--stats] PATH...      print "digest  path" for each file;
+ *                                               directories are walked recursively
+ *     sm3sum -c MANIFEST [-j N] [-q] [--stats]  check the "digest  path" lines of a
+ *                                               manifest ("-" reads it from stdin)
+ *
+ * Files are hashed on a work-stealing pool. Files up to SMALL_FILE_BYTES are read into
+ * memory and queued on the worker's 8-lane multi-buffer engine, which is flushed every
+ * PENDING_FILES files; larger files are streamed through the single-stream kernel with
+ * the mmap driver. Work is done in batches of BATCH_FILES, and each batch is printed in
+ * input order once it completes, so the output does not depend on the thread count or
+ * on scheduling. Files found by walking a directory are sorted by path.
+ *
+ * Exit status is 1 if any file could not be read or (with -c) did not match.
+ */
+
+namespace {
+
+constexpr size_t SMALL_FILE_BYTES = 64 * 1024;
+constexpr size_t PENDING_FILES = 64;
+constexpr size_t PENDING_BYTES = 1024 * 1024;
+constexpr size_t BATCH_FILES = 64 * 1024;
+
+using StreamHasher = SM3_VectorExpand;
+
+struct Entry {
+    std::string path;
+    std::string expected;  // -c mode only
+    std::string digest;
+    std::string error;
+};
+
+struct Options {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool check = false;
+    bool quiet = false;
+    bool stats = false;
+    std::vector<std::string> paths;
+};
+
+// Per-worker state: the multi-buffer queue of small files and byte counters.
+class FileHasher {
+public:
+    void hash(Entry& entry) {
+        try {
+            if (entry.path == "-") {
+                entry.digest = sm3_file::hash_path<StreamHasher>(entry.path);
+                return;
+            }
+            int fd = open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                sm3_file::throw_errno(entry.path);
+            }
+            struct stat st;
+            bool small = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                         static_cast<size_t>(st.st_size) <= SMALL_FILE_BYTES && SM3_MultiBuffer::is_supported();
+            try {
+                if (small) {
+                    queue_small(entry, fd, static_cast<size_t>(st.st_size));
+                } else {
+                    StreamHasher hasher;
+                    sm3_file::update_from_fd(hasher, fd, entry.path);
+                    entry.digest = hasher.finalize();
+                    bytes += static_cast<uint64_t>(st.st_size);
+                }
+            } catch (...) {
+                close(fd);
+                throw;
+            }
+            close(fd);
+        } catch (const std::system_error& e) {
+            entry.error = e.what();
+        }
+    }
+
+    void flush() {
+        if (pending.empty()) {
+            return;
+        }
+        std::vector<std::array<uint8_t, SM3_MultiBuffer::DIGEST_BYTES>> digests(pending.size());
+        for (size_t k = 0; k < pending.size(); k++) {
+            engine.submit(pending[k].data.data(), pending[k].data.size(), digests[k].data());
+        }
+        engine.flush();
+        for (size_t k = 0; k < pending.size(); k++) {
+            pending[k].entry->digest = SM3_MultiBuffer::to_hex(digests[k].data());
+        }
+        small_files += pending.size();
+        pending.clear();
+        pending_bytes = 0;
+    }
+
+    uint64_t bytes = 0;
+    uint64_t small_files = 0;
+    SM3_MultiBuffer engine;
+
+private:
+    struct Pending {
+        Entry* entry;
+        std::vector<uint8_t> data;
+    };
+
+    void queue_small(Entry& entry, int fd, size_t size) {
+        std::vector<uint8_t> data(size);
+        size_t got = 0;
+        while (true) {
+            if (got == data.size()) {
+                data.resize(data.size() + 4096);  // the file grew since fstat()
+            }
+            ssize_t n = read(fd, data.data() + got, data.size() - got);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                sm3_file::throw_errno(entry.path);
+            }
+            if (n == 0) {
+                break;
+            }
+            got += static_cast<size_t>(n);
+        }
+        data.resize(got);
+        bytes += got;
+        pending_bytes += got;
+        pending.push_back(Pending{&entry, std::move(data)});
+        if (pending.size() >= PENDING_FILES || pending_bytes >= PENDING_BYTES) {
+            flush();
+        }
+    }
+
+    std::vector<Pending> pending;
+    size_t pending_bytes = 0;
+};
+
+void usage(const char* argv0) {
+    std::cerr << "usage: " << argv0 << " [-j N] [-q] [--stats] PATH...\n"
+              << "       " << argv0 << " -c MANIFEST [-j N] [-q] [--stats]" << std::endl;
+}
+
+bool parse_options(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            opts.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-c") {
+            opts.check = true;
+        } else if (arg == "-q") {
+            opts.quiet = true;
+        } else if (arg == "--stats") {
+            opts.stats = true;
+        } else if (arg.size() > 1 && arg[0] == '-' && arg != "-") {
+            return false;
+        } else {
+            opts.paths.push_back(arg);
+        }
+    }
+    return opts.check ? opts.paths.size() == 1 : !opts.paths.empty();
+}
+
+// Expands directories into their regular files, sorted by path within each directory
+// argument; other arguments are kept as given.
+bool collect_files(const std::vector<std::string>& args, std::vector<Entry>& entries, const char* argv0) {
+    namespace fs = std::filesystem;
+    bool ok = true;
+    for (const auto& arg : args) {
+        std::error_code ec;
+        if (arg == "-" || !fs::is_directory(arg, ec)) {
+            entries.push_back(Entry{arg, "", "", ""});
+            continue;
+        }
+        std::vector<std::string> found;
+        fs::recursive_directory_iterator it(arg, fs::directory_options::skip_permission_denied, ec), end;
+        for (; !ec && it != end; it.increment(ec)) {
+            std::error_code type_ec;
+            if (it->is_regular_file(type_ec)) {
+                found.push_back(it->path().string());
+            }
+        }
+        if (ec) {
+            std::cerr << argv0 << ": " << arg << ": " << ec.message() << std::endl;
+            ok = false;
+        }
+        std::sort(found.begin(), found.end());
+        for (auto& path : found) {
+            entries.push_back(Entry{std::move(path), "", "", ""});
+        }
+    }
+    return ok;
+}
+
+// Manifest lines are "<64 hex digits>  <path>" (or " *<path>" for binary mode).
+bool read_manifest(const std::string& manifest, std::vector<Entry>& entries, size_t& malformed) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (manifest != "-") {
+        file.open(manifest);
+        if (!file) {
+            return false;
+        }
+        in = &file;
+    }
+    std::string line;
+    while (std::getline(*in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        bool hex = line.size() > 66 && std::all_of(line.begin(), line.begin() + 64, [](char c) {
+            return std::isxdigit(static_cast<unsigned char>(c));
+        });
+        if (!hex || line[64] != ' ' || (line[65] != ' ' && line[65] != '*')) {
+            malformed++;
+            continue;
+        }
+        std::string digest = line.substr(0, 64);
+        std::transform(digest.begin(), digest.end(), digest.begin(), ::tolower);
+        entries.push_back(Entry{line.substr(66), digest, "", ""});
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Entry> entries;
+    size_t malformed = 0;
+    bool ok = true;
+    if (opts.check) {
+        if (!read_manifest(opts.paths[0], entries, malformed)) {
+            std::cerr << argv[0] << ": " << opts.paths[0] << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    } else {
+        ok = collect_files(opts.paths, entries, argv[0]);
+    }
+
+    crypto_runtime::WorkStealingPool pool(opts.threads);
+    std::vector<FileHasher> hashers(pool.size());
+    size_t unreadable = 0, mismatched = 0;
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (size_t first = 0; first < entries.size(); first += BATCH_FILES) {
+        size_t count = std::min(BATCH_FILES, entries.size() - first);
+        pool.parallel_for(count, [&](size_t i, unsigned worker) { hashers[worker].hash(entries[first + i]); });
+        for (auto& h : hashers) {
+            h.flush();
+        }
+
+        for (size_t i = first; i < first + count; i++) {
+            Entry& e = entries[i];
+            if (!e.error.empty()) {
+                std::cout.flush();
+                std::cerr << argv[0] << ": " << e.error << std::endl;
+                if (opts.check) {
+                    std::cout << e.path << ": FAILED open or read\n";
+                }
+                unreadable++;
+            } else if (!opts.check) {
+                std::cout << e.digest << "  " << e.path << "\n";
+            } else if (e.digest == e.expected) {
+                if (!opts.quiet) {
+                    std::cout << e.path << ": OK\n";
+                }
+            } else {
+                std::cout << e.path << ": FAILED\n";
+                mismatched++;
+            }
+            // Release the strings of printed entries; a nightly run can list millions.
+            std::string().swap(e.path);
+            std::string().swap(e.expected);
+            std::string().swap(e.digest);
+        }
+    }
+    std::cout.flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    if (malformed > 0) {
+        std::cerr << argv[0] << ": WARNING: " << malformed << " line(s) improperly formatted" << std::endl;
+    }
+    if (opts.check && unreadable > 0) {
+        std::cerr << argv[0] << ": WARNING: " << unreadable << " listed file(s) could not be read" << std::endl;
+    }
+    if (mismatched > 0) {
+        std::cerr << argv[0] << ": WARNING: " << mismatched << " computed checksum(s) did NOT match" << std::endl;
+    }
+
+    if (opts.stats) {
+        uint64_t bytes = 0, small_files = 0, kernel_calls = 0, busy = 0;
+        for (auto& h : hashers) {
+            bytes += h.bytes;
+            small_files += h.small_files;
+            kernel_calls += h.engine.get_stats().kernel_calls;
+            busy += h.engine.get_stats().busy_lane_blocks;
+        }
+        double lanes = kernel_calls ? 100.0 * busy / (kernel_calls * SM3_MultiBuffer::LANES) : 0.0;
+        std::cerr << std::fixed << std::setprecision(1) << entries.size() << " files, " << bytes / 1e6 << " MB in "
+                  << std::setprecision(3) << seconds << " s with " << pool.size() << " thread(s): "
+                  << std::setprecision(0) << entries.size() / seconds << " files/s, " << std::setprecision(1)
+                  << bytes / 1e6 / seconds << " MB/s; " << small_files << " small files on multi-buffer lanes ("
+                  << lanes << "% lane utilization), " << pool.get_stats().steals.load() << " steals" << std::endl;
+    }
+
+    return ok && unreadable == 0 && mismatched == 0 ? 0 : 1;
+}